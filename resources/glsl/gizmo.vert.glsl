@@ -0,0 +1,46 @@
+#version 150
+// ^ Change this to version 130 if you have compatibility issues
+
+// Draws the gizmo of joint gl_InstanceID. The mesh is the same for every
+// joint: vertices 0 and 1 are the ends of the bone from the parent's origin
+// to the joint's, and the rest are the joint's three axis circles.
+// Refer to the lambert shader files for other useful comments
+
+uniform mat4 u_Model;
+uniform mat4 u_ViewProj;
+
+// Each joint's world transform, as four columns
+uniform samplerBuffer u_JointWorlds;
+// Each joint's parent id (its own for the root) and whether it is selected
+uniform isamplerBuffer u_JointInfo;
+
+in vec4 vs_Pos;
+in vec4 vs_Col;
+
+out vec4 fs_Col;
+flat out int fs_Joint; // For picking
+
+mat4 worldTransform(int joint)
+{
+    int base = joint * 4;
+    return mat4(texelFetch(u_JointWorlds, base),
+                texelFetch(u_JointWorlds, base + 1),
+                texelFetch(u_JointWorlds, base + 2),
+                texelFetch(u_JointWorlds, base + 3));
+}
+
+void main()
+{
+    ivec2 info = texelFetch(u_JointInfo, gl_InstanceID).xy;
+    fs_Joint = gl_InstanceID;
+
+    // the root is its own parent, so its bone has no length and draws nothing
+    int joint = gl_VertexID == 0 ? info.x : gl_InstanceID;
+    bool circle = gl_VertexID >= 2;
+    fs_Col = circle && info.y != 0 ? vec4(1) : vs_Col;
+
+    vec4 modelposition = u_Model * worldTransform(joint) * vs_Pos;
+
+    //built-in things to pass down the pipeline
+    gl_Position = u_ViewProj * modelposition;
+}
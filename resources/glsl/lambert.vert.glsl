@@ -29,10 +29,14 @@ in vec4 vs_Col;             // The array of vertex colors passed to the shader.
 out vec3 fs_Pos;
 out vec4 fs_Nor;            // The array of normals that has been transformed by u_ModelInvTr. This is implicitly passed to the fragment shader.
 out vec4 fs_Col;            // The color of each vertex. This is implicitly passed to the fragment shader.
+flat out int fs_Slot;       // Index of the vertex in the vertex buffer, for the overlay shader
+
+invariant gl_Position;      // Computed the same in every program that links this shader, so the overlay and mesh agree on depth
 
 void main()
 {
     fs_Col = vs_Col;                         // Pass the vertex colors to the fragment shader for interpolation
+    fs_Slot = gl_VertexID;
 
     mat3 invTranspose = mat3(u_ModelInvTr);
     fs_Nor = vec4(invTranspose * vec3(vs_Nor), 0);          // Pass the vertex normals to the fragment shader for interpolation.
@@ -0,0 +1,77 @@
+#version 150
+
+// Refer to overlay.geom.glsl for what the inputs hold
+
+uniform int u_Wireframe; // 1 draws every polygon edge, 0 only the selection
+uniform int u_Occluded;  // 1 draws only the outline of the selection, faded,
+                         // for the parts of it the mesh hides
+
+noperspective in vec3 gs_EdgeDist;
+flat in ivec3 gs_EdgeKind;
+flat in vec2 gs_Corners[3];
+flat in ivec3 gs_CornerSelected;
+flat in int gs_FaceSelected;
+flat in vec4 gs_FaceCol;
+
+out vec4 out_Col;
+
+// How much of a fragment dist pixels from the middle of a line width pixels
+// wide is covered, for smooth edges
+float coverage(float dist, float width)
+{
+    return clamp(width * 0.5 + 0.5 - dist, 0, 1);
+}
+
+// Paints color over base with the given opacity
+vec4 over(vec4 base, vec3 color, float alpha)
+{
+    float a = alpha + base.a * (1 - alpha);
+    if (a == 0) {
+        return vec4(0);
+    }
+    return vec4((color * alpha + base.rgb * base.a * (1 - alpha)) / a, a);
+}
+
+void main()
+{
+    float wire = 0;
+    float outline = 0;
+    float edge = 0;
+    float vertex = 0;
+    for (int i = 0; i < 3; ++i) {
+        if (gs_EdgeKind[i] != 0) {
+            wire = max(wire, coverage(gs_EdgeDist[i], 1));
+            outline = max(outline, coverage(gs_EdgeDist[i], 3));
+        }
+        if (gs_EdgeKind[i] == 2) {
+            edge = max(edge, coverage(gs_EdgeDist[i], 3));
+        }
+        if (gs_CornerSelected[i] == 1) {
+            vertex = max(vertex,
+                         coverage(distance(gl_FragCoord.xy, gs_Corners[i]), 7));
+        }
+    }
+
+    vec4 col = vec4(0);
+    if (u_Wireframe == 1 && u_Occluded == 0) {
+        col = over(col, vec3(0), 0.6 * wire);
+    }
+    if (gs_FaceSelected == 1) {
+        // the inverse of the face's color stands out against it
+        vec3 highlight = vec3(1) - gs_FaceCol.rgb;
+        if (u_Occluded == 0) {
+            col = over(col, highlight, 0.25);
+        }
+        col = over(col, highlight, outline);
+    }
+    col = over(col, vec3(1, 1, 0), edge);
+    col = over(col, vec3(1), vertex);
+
+    if (u_Occluded == 1) {
+        col.a *= 0.35;
+    }
+    if (col.a == 0) {
+        discard;
+    }
+    out_Col = col;
+}
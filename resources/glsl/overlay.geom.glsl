@@ -0,0 +1,89 @@
+#version 150
+
+// Draws the polygon edges of a mesh and highlights its selection on top of
+// the mesh's own triangles. Linked after the lambert or skeleton vertex
+// shader, so the overlay lands exactly where the mesh was drawn.
+
+layout(triangles) in;
+layout(triangle_strip, max_vertices = 3) out;
+
+uniform isamplerBuffer u_Slots;     // For each vertex in the vertex buffer: the
+                                    // selection texel of its mesh vertex and
+                                    // of its face, its corner in the face and
+                                    // the face's corner count
+
+uniform usamplerBuffer u_Selection; // Flags of every mesh vertex, then every
+                                    // face: 1 for selected, 2 for an end of
+                                    // the selected edge
+
+uniform vec2 u_Viewport;            // Size of the viewport in pixels
+
+in vec4 fs_Col[];
+flat in int fs_Slot[];
+
+// computed exactly as the mesh's own, so the two agree on depth
+invariant gl_Position;
+
+noperspective out vec3 gs_EdgeDist; // Pixels to the edge opposite each corner
+flat out ivec3 gs_EdgeKind;         // Of the edge opposite each corner: 0 for
+                                    // one that splits a polygon, 1 for a
+                                    // polygon edge, 2 for the selected edge
+flat out vec2 gs_Corners[3];        // Window coordinates of the corners
+flat out ivec3 gs_CornerSelected;
+flat out int gs_FaceSelected;
+flat out vec4 gs_FaceCol;
+
+void main()
+{
+    // the edge distances are measured on screen, which means nothing for a
+    // triangle reaching behind the camera
+    for (int i = 0; i < 3; ++i) {
+        if (gl_in[i].gl_Position.w <= 0) {
+            return;
+        }
+    }
+
+    ivec4 slots[3];
+    uint flags[3];
+    vec2 corners[3];
+    for (int i = 0; i < 3; ++i) {
+        slots[i] = texelFetch(u_Slots, fs_Slot[i]);
+        flags[i] = texelFetch(u_Selection, slots[i].x).r;
+        vec4 clip = gl_in[i].gl_Position;
+        corners[i] = (clip.xy / clip.w * 0.5 + 0.5) * u_Viewport;
+    }
+
+    // corners next to each other in the polygon make one of its edges
+    ivec3 edgeKind;
+    ivec3 cornerSelected;
+    for (int i = 0; i < 3; ++i) {
+        ivec4 a = slots[(i + 1) % 3];
+        ivec4 b = slots[(i + 2) % 3];
+        int gap = abs(a.z - b.z);
+        bool polygonEdge = gap == 1 || gap == a.w - 1;
+        bool selected = (flags[(i + 1) % 3] & 2u) != 0u &&
+                        (flags[(i + 2) % 3] & 2u) != 0u;
+        edgeKind[i] = polygonEdge ? (selected ? 2 : 1) : 0;
+        cornerSelected[i] = int(flags[i] & 1u);
+    }
+    int faceSelected = int(texelFetch(u_Selection, slots[0].y).r & 1u);
+
+    // twice the area, divided by the opposite edge, is a corner's height
+    float area = abs(determinant(mat2(corners[1] - corners[0],
+                                      corners[2] - corners[0])));
+    for (int i = 0; i < 3; ++i) {
+        float height = area / max(length(corners[(i + 2) % 3] -
+                                         corners[(i + 1) % 3]), 1e-6);
+        gs_EdgeDist = vec3(0);
+        gs_EdgeDist[i] = height;
+        // outputs are undefined after each EmitVertex, flat ones included
+        gs_EdgeKind = edgeKind;
+        gs_Corners = corners;
+        gs_CornerSelected = cornerSelected;
+        gs_FaceSelected = faceSelected;
+        gs_FaceCol = fs_Col[0];
+        gl_Position = gl_in[i].gl_Position;
+        EmitVertex();
+    }
+    EndPrimitive();
+}
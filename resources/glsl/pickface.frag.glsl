@@ -0,0 +1,19 @@
+#version 150
+// ^ Change this to version 130 if you have compatibility issues
+
+// Writes the face under each fragment into the pick buffer, after either the
+// lambert or the skeleton vertex shader. Each triangle belongs to one face,
+// so the flat slot of its provoking vertex is enough to find it.
+
+// For each vertex of the mesh's vertex buffer: mesh vertex, face (offset by
+// the mesh's vertex count), corner and corner count. See overlay.geom.glsl.
+uniform isamplerBuffer u_Slots;
+
+flat in int fs_Slot;
+
+out ivec2 out_Id; // What was hit: 1 for a face, then its slot table entry
+
+void main()
+{
+    out_Id = ivec2(1, texelFetch(u_Slots, fs_Slot).y);
+}
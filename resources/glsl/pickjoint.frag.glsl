@@ -0,0 +1,13 @@
+#version 150
+// ^ Change this to version 130 if you have compatibility issues
+
+// Writes the joint whose gizmo covers each fragment into the pick buffer
+
+flat in int fs_Joint;
+
+out ivec2 out_Id; // What was hit: 2 for a joint, then its id
+
+void main()
+{
+    out_Id = ivec2(2, fs_Joint);
+}
@@ -13,9 +13,18 @@ uniform mat4 u_ViewProj;    // The matrix that defines the camera's transformati
                             // We've written a static matrix for you to use for HW2,
                             // but in HW3 you'll have to generate one yourself
 
-uniform mat4 u_BindMats[100];
+uniform samplerBuffer u_JointPalette; // Each joint's overall transformation
+                                      // times its bind matrix, stored as four
+                                      // vec4 columns per joint
+
+uniform samplerBuffer u_JointDualQuats; // The same transformations as unit
+                                        // dual quaternions, two texels per
+                                        // joint: rotation, then translation
+
+uniform int u_SkinningMode;  // 0 blends matrices linearly, 1 blends dual
+                             // quaternions, which keeps twisted joints from
+                             // collapsing
 
-uniform mat4 u_JointTfms[100];
 
 in vec4 vs_Pos;             // The array of vertex positions passed to the shader
 
@@ -23,28 +32,106 @@ in vec4 vs_Nor;             // The array of vertex normals passed to the shader
 
 in vec4 vs_Col;             // The array of vertex colors passed to the shader.
 
-in ivec2 vs_JointIdx;
-in vec2 vs_JointWgt;
+in uvec4 vs_JointIdx0;       // Joints of up to eight influences, heaviest
+in vec4 vs_JointWgt0;        // first. Unused slots have zero weight, and
+in uvec4 vs_JointIdx1;       // meshes with at most four influences per vertex
+in vec4 vs_JointWgt1;        // leave the second set disabled.
 
 out vec3 fs_Pos;
 out vec4 fs_Nor;            // The array of normals that has been transformed by u_ModelInvTr. This is implicitly passed to the fragment shader.
 out vec4 fs_Col;            // The color of each vertex. This is implicitly passed to the fragment shader.
+flat out int fs_Slot;       // Index of the vertex in the vertex buffer, for the overlay shader
+
+invariant gl_Position;      // Computed the same in every program that links this shader, so the overlay and mesh agree on depth
+
+mat4 paletteMatrix(int joint)
+{
+    int i = joint * 4;
+    return mat4(texelFetch(u_JointPalette, i),
+                texelFetch(u_JointPalette, i + 1),
+                texelFetch(u_JointPalette, i + 2),
+                texelFetch(u_JointPalette, i + 3));
+}
+
+int jointIdx(int k)
+{
+    return int(k < 4 ? vs_JointIdx0[k] : vs_JointIdx1[k - 4]);
+}
+
+float jointWgt(int k)
+{
+    return k < 4 ? vs_JointWgt0[k] : vs_JointWgt1[k - 4];
+}
+
+// Blends the influences' matrices. Returns the position and transforms nor by
+// the blend's cofactor matrix, which is its inverse transpose times its
+// determinant, so nor stays perpendicular to the surface under non-uniform
+// scale once normalized.
+vec4 skinLinear(vec4 pos, inout vec3 nor)
+{
+    mat4 skin = mat4(0);
+    for (int k = 0; k < 8; ++k) {
+        float w = jointWgt(k);
+        if (w == 0) {
+            break;
+        }
+        skin += w * paletteMatrix(jointIdx(k));
+    }
+    mat3 m = mat3(skin);
+    vec3 c12 = cross(m[1], m[2]);
+    nor = nor.x * c12 + nor.y * cross(m[2], m[0]) + nor.z * cross(m[0], m[1]);
+    nor *= sign(dot(m[0], c12));
+    return skin * pos;
+}
+
+// Blends the influences' dual quaternions, taking the shortest path from the
+// heaviest one, then applies the normalized result to pos and nor
+vec4 skinDualQuat(vec4 pos, inout vec3 nor)
+{
+    vec4 pivot = texelFetch(u_JointDualQuats, jointIdx(0) * 2);
+    vec4 real = vec4(0);
+    vec4 dual = vec4(0);
+    for (int k = 0; k < 8; ++k) {
+        float w = jointWgt(k);
+        if (w == 0) {
+            break;
+        }
+        int i = jointIdx(k) * 2;
+        vec4 r = texelFetch(u_JointDualQuats, i);
+        w = dot(r, pivot) < 0 ? -w : w;
+        real += w * r;
+        dual += w * texelFetch(u_JointDualQuats, i + 1);
+    }
+
+    float len = length(real);
+    real /= len;
+    dual /= len;
+
+    vec3 p = pos.xyz;
+    p += 2 * cross(real.xyz, cross(real.xyz, p) + real.w * p);
+    p += 2 * (real.w * dual.xyz - dual.w * real.xyz + cross(real.xyz, dual.xyz));
+    nor += 2 * cross(real.xyz, cross(real.xyz, nor) + real.w * nor);
+    return vec4(p, 1);
+}
 
 void main()
 {
     fs_Col = vs_Col;                         // Pass the vertex colors to the fragment shader for interpolation
+    fs_Slot = gl_VertexID;
+
+    // The palette already combines each joint's transformation with its bind
+    // matrix, so the influences only need blending
+    vec3 nor = vec3(vs_Nor);
+    vec4 vertPos = u_SkinningMode == 1 ? skinDualQuat(vs_Pos, nor)
+                                       : skinLinear(vs_Pos, nor);
 
     mat3 invTranspose = mat3(u_ModelInvTr);
-    fs_Nor = vec4(invTranspose * vec3(vs_Nor), 0);          // Pass the vertex normals to the fragment shader for interpolation.
+    fs_Nor = vec4(normalize(invTranspose * nor), 0);        // Pass the vertex normals to the fragment shader for interpolation.
                                                             // Transform the geometry's normals by the inverse transpose of the
                                                             // model matrix. This is necessary to ensure the normals remain
                                                             // perpendicular to the surface after the surface is transformed by
                                                             // the model matrix.
 
-    vec4 joint1Pos = u_JointTfms[vs_JointIdx[0]] * u_BindMats[vs_JointIdx[0]] * vs_Pos;
-    vec4 joint2Pos = u_JointTfms[vs_JointIdx[1]] * u_BindMats[vs_JointIdx[1]] * vs_Pos;
-    vec4 vertPos = vs_JointWgt[0] * joint1Pos + vs_JointWgt[1] * joint2Pos;
-
     vec4 modelposition = u_Model * vertPos;   // Temporarily store the transformed vertex positions for use below
 
     fs_Pos = modelposition.xyz;
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "smartpointerhelp.h"
+
+#include <algorithm>
+#include <vector>
+
+/**
+ * An array split into fixed-size chunks that are shared between copies.
+ *
+ * Copying a CowArray only copies the chunk pointers. The first write to a
+ * chunk that is still shared with another copy clones that one chunk, so
+ * copies behave like independent values while costing O(size / ChunkSize) to
+ * take and O(ChunkSize) per first write.
+ *
+ * A copy may be read on another thread while the original keeps being
+ * written: a writer never touches a chunk whose reference count shows that
+ * someone else can see it.
+ */
+template <typename T, size_t ChunkSize = 4096> class CowArray {
+public:
+  CowArray() : chunks(), count(0) {}
+
+  size_t size() const { return count; }
+
+  const T &operator[](size_t i) const {
+    return (*chunks[i / ChunkSize])[i % ChunkSize];
+  }
+
+  // Grows or shrinks the array. New elements are value-initialized.
+  void resize(size_t n) {
+    size_t chunkCount = (n + ChunkSize - 1) / ChunkSize;
+    // the old last chunk may be partially filled with stale values
+    if (n > count && count % ChunkSize != 0) {
+      size_t last = count / ChunkSize;
+      size_t end = std::min(n, (last + 1) * ChunkSize);
+      for (size_t i = count; i < end; ++i) {
+        writable(last)[i % ChunkSize] = T();
+      }
+    }
+    while (chunks.size() < chunkCount) {
+      chunks.push_back(mkS<std::vector<T>>(ChunkSize));
+    }
+    chunks.resize(chunkCount);
+    count = n;
+  }
+
+  void set(size_t i, const T &value) {
+    writable(i / ChunkSize)[i % ChunkSize] = value;
+  }
+
+  // Number of chunks shared with at least one other copy
+  size_t sharedChunkCount() const {
+    size_t shared = 0;
+    for (auto &chunk : chunks) {
+      shared += chunk.use_count() > 1;
+    }
+    return shared;
+  }
+
+private:
+  std::vector<sPtr<std::vector<T>>> chunks;
+  size_t count;
+
+  std::vector<T> &writable(size_t chunk) {
+    sPtr<std::vector<T>> &c = chunks[chunk];
+    if (c.use_count() > 1) {
+      c = mkS<std::vector<T>>(*c);
+    }
+    return *c;
+  }
+};
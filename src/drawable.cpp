@@ -2,21 +2,30 @@
 
 #include <la.h>
 
-Drawable::Drawable(OpenGLContext *context)
-    : count(-1), bufIdx(), bufPos(), bufNor(), bufCol(), bufJointIdx(),
-      bufJointWgt(), idxBound(false), posBound(false), norBound(false),
-      colBound(false), jointIdxBound(false), jointWgtBound(false),
-      mp_context(context) {}
+#include <algorithm>
+#include <cstring>
+
+GpuBuffer::GpuBuffer() : handle(0), capacity(0), shadow() {}
+
+Drawable::Drawable(RenderContext *context)
+    : count(-1), bufIdx(), bufVert(), vao(0), layout(), idxBound(false),
+      vertBound(false), mp_context(context) {}
 
 Drawable::~Drawable() { destroy(); }
 
 void Drawable::destroy() {
-  mp_context->glDeleteBuffers(1, &bufIdx);
-  mp_context->glDeleteBuffers(1, &bufPos);
-  mp_context->glDeleteBuffers(1, &bufNor);
-  mp_context->glDeleteBuffers(1, &bufCol);
-  mp_context->glDeleteBuffers(1, &bufJointIdx);
-  mp_context->glDeleteBuffers(1, &bufJointWgt);
+  for (GpuBuffer *buf : {&bufIdx, &bufVert}) {
+    if (buf->handle) {
+      mp_context->glState().deleteBuffer(buf->handle);
+    }
+    *buf = GpuBuffer();
+  }
+  if (vao) {
+    mp_context->glState().deleteVertexArray(vao);
+    vao = 0;
+  }
+  layout = VertexLayout();
+  idxBound = vertBound = false;
 }
 
 GLenum Drawable::drawMode() {
@@ -31,80 +40,153 @@ GLenum Drawable::drawMode() {
 
 int Drawable::elemCount() { return count; }
 
-void Drawable::generateIdx() {
-  idxBound = true;
-  // Create a VBO on our GPU and store its handle in bufIdx
-  mp_context->glGenBuffers(1, &bufIdx);
-}
+const DrawRanges *Drawable::getDrawRanges() { return nullptr; }
 
-void Drawable::generatePos() {
-  posBound = true;
-  // Create a VBO on our GPU and store its handle in bufPos
-  mp_context->glGenBuffers(1, &bufPos);
-}
+GLsizei Drawable::getInstanceCount() { return 1; }
 
-void Drawable::generateNor() {
-  norBound = true;
-  // Create a VBO on our GPU and store its handle in bufNor
-  mp_context->glGenBuffers(1, &bufNor);
+void Drawable::generate(GpuBuffer &buf) {
+  // Create a VBO on our GPU the first time only; after that the same buffer
+  // name and storage are reused by every upload
+  if (!buf.handle) {
+    mp_context->glGenBuffers(1, &buf.handle);
+  }
 }
 
-void Drawable::generateCol() {
-  colBound = true;
-  // Create a VBO on our GPU and store its handle in bufCol
-  mp_context->glGenBuffers(1, &bufCol);
+void Drawable::generateVao() {
+  if (!vao) {
+    mp_context->glGenVertexArrays(1, &vao);
+  }
 }
 
-void Drawable::generateJointIdx() {
-  jointIdxBound = true;
-  // Create a VBO on our GPU and store its handle in bufJointIdx
-  mp_context->glGenBuffers(1, &bufJointIdx);
+void Drawable::generateIdx() {
+  idxBound = true;
+  generate(bufIdx);
 }
 
-void Drawable::generateJointWgt() {
-  jointWgtBound = true;
-  // Create a VBO on our GPU and store its handle in bufJointWgt
-  mp_context->glGenBuffers(1, &bufJointWgt);
+void Drawable::generateVert() {
+  vertBound = true;
+  generate(bufVert);
 }
 
-bool Drawable::bindIdx() {
-  if (idxBound) {
-    mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bufIdx);
+void Drawable::upload(GLenum target, GpuBuffer &buf, const void *data,
+                      GLsizeiptr bytes) {
+  const unsigned char *src = static_cast<const unsigned char *>(data);
+  mp_context->glState().bindBuffer(target, buf.handle);
+
+  if (bytes > buf.capacity) {
+    // grow geometrically so that a mesh that keeps getting larger does not
+    // reallocate on every edit
+    buf.capacity =
+        std::max<GLsizeiptr>(bytes, buf.capacity + buf.capacity / 2);
+    mp_context->glBufferData(target, buf.capacity, nullptr, GL_DYNAMIC_DRAW);
+    mp_context->glBufferSubData(target, 0, bytes, src);
+    buf.shadow.assign(src, src + bytes);
+    return;
   }
-  return idxBound;
-}
 
-bool Drawable::bindPos() {
-  if (posBound) {
-    mp_context->glBindBuffer(GL_ARRAY_BUFFER, bufPos);
+  // find the runs of bytes that differ from what is already on the GPU.
+  // Identical blocks are skipped with memcmp, runs separated by small gaps
+  // are merged, and each run is then trimmed down to the exact bytes.
+  const GLsizeiptr block = 256;
+  const unsigned char *old = buf.shadow.data();
+  GLsizeiptr oldSize = buf.shadow.size();
+
+  std::vector<std::pair<GLsizeiptr, GLsizeiptr>> runs;
+  GLsizeiptr changed = 0;
+  for (GLsizeiptr start = 0; start < bytes; start += block) {
+    GLsizeiptr end = std::min(start + block, bytes);
+    if (end <= oldSize && !memcmp(old + start, src + start, end - start)) {
+      continue;
+    }
+    if (!runs.empty() && start - runs.back().second <= 2 * block) {
+      changed += end - runs.back().second;
+      runs.back().second = end;
+    } else {
+      changed += end - start;
+      runs.push_back({start, end});
+    }
+  }
+
+  if (runs.empty()) {
+    return;
   }
-  return posBound;
-}
 
-bool Drawable::bindNor() {
-  if (norBound) {
-    mp_context->glBindBuffer(GL_ARRAY_BUFFER, bufNor);
+  if (changed > buf.capacity / 2 || runs.size() > 32) {
+    // most of the buffer is changing anyway, so orphan the old storage
+    // rather than waiting for draws that may still be reading it
+    mp_context->glBufferData(target, buf.capacity, nullptr, GL_DYNAMIC_DRAW);
+    mp_context->glBufferSubData(target, 0, bytes, src);
+  } else {
+    for (auto [first, last] : runs) {
+      while (first < last && first < oldSize && old[first] == src[first]) {
+        ++first;
+      }
+      while (last > first && last <= oldSize &&
+             old[last - 1] == src[last - 1]) {
+        --last;
+      }
+      mp_context->glBufferSubData(target, first, last - first, src + first);
+    }
   }
-  return norBound;
+  buf.shadow.assign(src, src + bytes);
+}
+
+void Drawable::uploadIdx(const void *data, GLsizeiptr bytes) {
+  generateIdx();
+  generateVao();
+  // the element array binding is stored in the VAO, so ours has to be bound
+  // or we would attach this buffer to whichever VAO was bound last
+  mp_context->glState().bindVertexArray(vao);
+  upload(GL_ELEMENT_ARRAY_BUFFER, bufIdx, data, bytes);
 }
 
-bool Drawable::bindCol() {
-  if (colBound) {
-    mp_context->glBindBuffer(GL_ARRAY_BUFFER, bufCol);
+void Drawable::uploadVert(const VertexLayout &vertLayout, const void *data,
+                          GLsizeiptr bytes) {
+  generateVert();
+  generateVao();
+  mp_context->glState().bindVertexArray(vao);
+  upload(GL_ARRAY_BUFFER, bufVert, data, bytes);
+
+  if (vertLayout == layout) {
+    return;
+  }
+
+  // point the VAO at the interleaved attributes; bufVert is still bound to
+  // GL_ARRAY_BUFFER from the upload above
+  for (const VertexAttrib &a : layout.attribs) {
+    mp_context->glDisableVertexAttribArray(a.location);
   }
-  return colBound;
+  for (const VertexAttrib &a : vertLayout.attribs) {
+    const void *offset = reinterpret_cast<const void *>(size_t(a.offset));
+    mp_context->glEnableVertexAttribArray(a.location);
+    if (a.integer) {
+      mp_context->glVertexAttribIPointer(a.location, a.size, a.type,
+                                         vertLayout.stride, offset);
+    } else {
+      mp_context->glVertexAttribPointer(a.location, a.size, a.type,
+                                        a.normalized, vertLayout.stride,
+                                        offset);
+    }
+  }
+  layout = vertLayout;
 }
 
-bool Drawable::bindJointIdx() {
-  if (jointIdxBound) {
-    mp_context->glBindBuffer(GL_ARRAY_BUFFER, bufJointIdx);
+void Drawable::updateVert(GLintptr offset, const void *data,
+                          GLsizeiptr bytes) {
+  unsigned char *old = bufVert.shadow.data() + offset;
+  if (!memcmp(old, data, bytes)) {
+    return;
   }
-  return jointIdxBound;
+  memcpy(old, data, bytes);
+  mp_context->glState().bindBuffer(GL_ARRAY_BUFFER, bufVert.handle);
+  mp_context->glBufferSubData(GL_ARRAY_BUFFER, offset, bytes, data);
 }
 
-bool Drawable::bindJointWgt() {
-  if (jointWgtBound) {
-    mp_context->glBindBuffer(GL_ARRAY_BUFFER, bufJointWgt);
+bool Drawable::bindVert() {
+  if (vertBound) {
+    mp_context->glState().bindVertexArray(vao);
   }
-  return jointWgtBound;
+  return vertBound;
 }
+
+bool Drawable::bindIdx() { return idxBound; }
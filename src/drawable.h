@@ -1,67 +1,101 @@
 #pragma once
 
-#include "openglcontext.h"
+#include "rendercontext.h"
+#include "vertexformat.h"
 #include <la.h>
 
+#include <vector>
+
+// A GL buffer object that is allocated once and then updated in place.
+struct GpuBuffer {
+  GLuint handle;       // 0 until the buffer is first generated
+  GLsizeiptr capacity; // Bytes of storage allocated on the GPU
+  std::vector<unsigned char> shadow; // CPU copy of the last upload, compared
+                                     // against the next one to find the range
+                                     // that actually changed
+
+  GpuBuffer();
+};
+
+// Runs of the index buffer to draw instead of all of it
+struct DrawRanges {
+  std::vector<GLsizei> counts;       // Indices in each run
+  std::vector<const void *> offsets; // Byte offset of each run
+};
+
 // This defines a class which can be rendered by our shader program.
 // Make any geometry a subclass of ShaderProgram::Drawable in order to render it
 // with the ShaderProgram class.
 class Drawable {
 protected:
-  int count;     // The number of indices stored in bufIdx.
-  GLuint bufIdx; // A Vertex Buffer Object that we will use to store triangle
-                 // indices (GLuints)
-  GLuint bufPos; // A Vertex Buffer Object that we will use to store mesh
-                 // vertices (vec4s)
-  GLuint bufNor; // A Vertex Buffer Object that we will use to store mesh
-                 // normals (vec4s)
-  GLuint bufCol; // Can be used to pass per-vertex color information to the
-                 // shader, but is currently unused. Instead, we use a uniform
-                 // vec4 in the shader to set an overall color for the geometry
-  GLuint bufJointIdx; // A Vertex Buffer Object that we will use to store joint
-                      // influence indices (ivec2s)
-  GLuint bufJointWgt; // A Vertex Buffer Object that we will use to store joint
-                      // weights (vec2s)
+  int count;        // The number of indices stored in bufIdx, or of vertices
+                    // in bufVert if there is no index buffer.
+  GpuBuffer bufIdx; // A Vertex Buffer Object that we will use to store
+                    // triangle indices (GLuints)
+  GpuBuffer bufVert; // A Vertex Buffer Object holding every attribute of each
+                     // vertex interleaved, as described by layout
+  GLuint vao;        // Vertex Array Object recording layout and both buffers,
+                     // so drawing only has to bind this one object
+  VertexLayout layout; // Layout vao is currently configured for
 
   bool idxBound; // Set to TRUE by generateIdx(), returned by bindIdx().
-  bool posBound;
-  bool norBound;
-  bool colBound;
-  bool jointIdxBound;
-  bool jointWgtBound;
+  bool vertBound;
 
-  OpenGLContext
+  RenderContext
       *mp_context; // Since Qt's OpenGL support is done through classes like
                    // QOpenGLFunctions_3_2_Core, we need to pass our OpenGL
                    // context to the Drawable in order to call GL functions from
                    // within this class.
 
 public:
-  Drawable(OpenGLContext *context);
+  Drawable(RenderContext *context);
   virtual ~Drawable();
 
   virtual void create() = 0; // To be implemented by subclasses. Populates the
                              // VBOs of the Drawable.
-  void destroy();            // Frees the VBOs of the Drawable.
+  void destroy();            // Frees the VBOs and VAO of the Drawable.
 
   // Getter functions for various GL data
   virtual GLenum drawMode();
   int elemCount();
+  // The parts of the index buffer to draw, or nullptr to draw every index
+  virtual const DrawRanges *getDrawRanges();
+  // How many copies of the index buffer one draw makes; the shader tells them
+  // apart by gl_InstanceID. Only whole index buffers are drawn instanced.
+  virtual GLsizei getInstanceCount();
 
   // Call these functions when you want to call glGenBuffers on the buffers
   // stored in the Drawable These will properly set the values of idxBound etc.
-  // which need to be checked in ShaderProgram::draw()
+  // which need to be checked in ShaderProgram::draw(). Each buffer is only
+  // generated once; later calls reuse it.
   void generateIdx();
-  void generatePos();
-  void generateNor();
-  void generateCol();
-  void generateJointIdx();
-  void generateJointWgt();
+  void generateVert();
+
+  // Call these functions to fill the buffers above, generating them if
+  // needed. Storage is reused between calls and grown geometrically, and only
+  // the bytes that differ from the previous upload are sent to the GPU.
+  void uploadIdx(const void *data, GLsizeiptr bytes);
+  // The VAO is only reconfigured when the layout differs from the last upload
+  void uploadVert(const VertexLayout &vertLayout, const void *data,
+                  GLsizeiptr bytes);
+  template <typename V> void uploadVert(const std::vector<V> &verts);
+  // Overwrites part of the last vertex upload without comparing the rest of
+  // the buffer, for callers that already know what changed
+  void updateVert(GLintptr offset, const void *data, GLsizeiptr bytes);
 
+  // Binds the VAO. Returns false if nothing has been uploaded yet.
+  bool bindVert();
+  // The index buffer is part of the VAO, so this only reports whether there
+  // is one; without it the vertices are drawn in order.
   bool bindIdx();
-  bool bindPos();
-  bool bindNor();
-  bool bindCol();
-  bool bindJointIdx();
-  bool bindJointWgt();
+
+private:
+  void generate(GpuBuffer &buf);
+  void generateVao();
+  void upload(GLenum target, GpuBuffer &buf, const void *data,
+              GLsizeiptr bytes);
 };
+
+template <typename V> void Drawable::uploadVert(const std::vector<V> &verts) {
+  uploadVert(V::layout(), verts.data(), verts.size() * sizeof(V));
+}
@@ -0,0 +1,169 @@
+#include "frameprofile.h"
+
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+namespace {
+// Timings per name the rolling statistics are taken over
+constexpr int WindowSize = 120;
+// Events kept for the trace; older ones are overwritten
+constexpr size_t MaxEvents = 1 << 16;
+
+struct Event {
+  const char *name;
+  bool gpu;
+  int thread; // Index into threads
+  qint64 start;
+  qint64 duration;
+};
+
+struct Series {
+  const char *name;
+  bool gpu;
+  std::array<qint64, WindowSize> durations; // A ring, oldest at next
+  int count;
+  int next;
+};
+
+std::mutex mutex;
+std::vector<Event> events; // A ring once full, oldest at nextEvent
+size_t nextEvent = 0;
+std::vector<Series> series;
+std::vector<std::thread::id> threads; // Each thread that recorded, in order
+
+QElapsedTimer &clock() {
+  static QElapsedTimer timer = [] {
+    QElapsedTimer t;
+    t.start();
+    return t;
+  }();
+  return timer;
+}
+
+// Expects mutex to be held
+int threadIndex(std::thread::id id) {
+  auto it = std::find(threads.begin(), threads.end(), id);
+  if (it == threads.end()) {
+    threads.push_back(id);
+    return threads.size() - 1;
+  }
+  return it - threads.begin();
+}
+
+// Expects mutex to be held. Names are compared by content, since the same
+// literal may have different addresses in different translation units.
+Series &seriesOf(const char *name, bool gpu) {
+  for (Series &s : series) {
+    if (s.gpu == gpu && std::strcmp(s.name, name) == 0) {
+      return s;
+    }
+  }
+  series.push_back({name, gpu, {}, 0, 0});
+  return series.back();
+}
+
+QJsonObject threadName(int tid, const QString &name) {
+  return QJsonObject{{"name", "thread_name"},
+                     {"ph", "M"},
+                     {"pid", 1},
+                     {"tid", tid},
+                     {"args", QJsonObject{{"name", name}}}};
+}
+} // namespace
+
+namespace frameprofile {
+qint64 now() { return clock().nsecsElapsed(); }
+
+Scope::Scope(const char *name) : name(name), start(now()) {}
+
+Scope::~Scope() { record(name, false, start, now() - start); }
+
+void record(const char *name, bool gpu, qint64 start, qint64 duration) {
+  std::lock_guard<std::mutex> lock(mutex);
+  Event event{name, gpu, gpu ? -1 : threadIndex(std::this_thread::get_id()),
+              start, duration};
+  if (events.size() < MaxEvents) {
+    events.push_back(event);
+  } else {
+    events[nextEvent] = event;
+  }
+  nextEvent = (nextEvent + 1) % MaxEvents;
+
+  Series &s = seriesOf(name, gpu);
+  s.durations[s.next] = duration;
+  s.next = (s.next + 1) % WindowSize;
+  s.count = std::min(s.count + 1, WindowSize);
+}
+
+std::vector<Stats> stats() {
+  std::lock_guard<std::mutex> lock(mutex);
+  std::vector<Stats> result;
+  for (bool gpu : {false, true}) {
+    for (const Series &s : series) {
+      if (s.gpu != gpu) {
+        continue;
+      }
+      qint64 total = 0, longest = 0;
+      for (int i = 0; i < s.count; ++i) {
+        total += s.durations[i];
+        longest = std::max(longest, s.durations[i]);
+      }
+      result.push_back({s.name, gpu, total / 1e6 / std::max(s.count, 1),
+                        longest / 1e6, s.count});
+    }
+  }
+  return result;
+}
+
+bool writeTrace(const QString &filePath, QString *error) {
+  std::vector<Event> copy;
+  size_t threadCount;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    // oldest first
+    size_t oldest = events.size() < MaxEvents ? 0 : nextEvent;
+    copy.assign(events.begin() + oldest, events.end());
+    copy.insert(copy.end(), events.begin(), events.begin() + oldest);
+    threadCount = threads.size();
+  }
+
+  // complete ("X") events on one process, with the GPU as thread 0 and CPU
+  // threads after it
+  QJsonArray trace;
+  trace.append(threadName(0, "GPU"));
+  for (size_t t = 0; t < threadCount; ++t) {
+    trace.append(threadName(t + 1, QString("CPU %1").arg(t + 1)));
+  }
+  for (const Event &e : copy) {
+    trace.append(QJsonObject{{"name", e.name},
+                             {"cat", e.gpu ? "gpu" : "cpu"},
+                             {"ph", "X"},
+                             {"ts", e.start / 1e3},
+                             {"dur", e.duration / 1e3},
+                             {"pid", 1},
+                             {"tid", e.thread + 1}});
+  }
+  QJsonObject root{{"traceEvents", trace}, {"displayTimeUnit", "ms"}};
+
+  QSaveFile file(filePath);
+  if (!file.open(QIODevice::WriteOnly)) {
+    *error = file.errorString();
+    return false;
+  }
+  file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+  if (!file.commit()) {
+    *error = file.errorString();
+    return false;
+  }
+  return true;
+}
+} // namespace frameprofile
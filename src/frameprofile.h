@@ -0,0 +1,53 @@
+#pragma once
+
+#include <QString>
+
+#include <string>
+#include <vector>
+
+/**
+ * Timings of the work behind each frame, kept for the performance HUD and
+ * for saving as a Chrome trace (chrome://tracing or ui.perfetto.dev).
+ *
+ * CPU work is timed by Scope objects around paintGL and the create() paths;
+ * GPU work by GpuTimers around each draw, whose results arrive a couple of
+ * frames late and go on a separate GPU track. Each timing is kept twice: in
+ * a rolling window per name for the HUD, and as an event in a ring holding
+ * the most recent ones for the trace.
+ *
+ * Names must be string literals, or otherwise outlive the profile, since
+ * only the pointer is stored. Events may be recorded from any thread.
+ */
+namespace frameprofile {
+// Nanoseconds since the first use of the profile
+qint64 now();
+
+// Times from construction to destruction on the calling thread
+class Scope {
+public:
+  explicit Scope(const char *name);
+  ~Scope();
+  Scope(const Scope &) = delete;
+  Scope &operator=(const Scope &) = delete;
+
+private:
+  const char *name;
+  qint64 start;
+};
+
+// Records a timing that started at start, as given by now()
+void record(const char *name, bool gpu, qint64 start, qint64 duration);
+
+struct Stats {
+  std::string name;
+  bool gpu;
+  double meanMs; // Over the rolling window
+  double maxMs;
+  int samples;
+};
+// Every name recorded so far, CPU ones first, in the order first seen
+std::vector<Stats> stats();
+
+// Writes the events still in the ring as Chrome trace JSON
+bool writeTrace(const QString &filePath, QString *error);
+} // namespace frameprofile
@@ -0,0 +1,27 @@
+#include "frustum.h"
+
+Frustum::Frustum(const glm::mat4 &viewProj) {
+  // a clip space point is visible when -w <= x, y, z <= w, so each plane is
+  // the last row of the matrix plus or minus one of the others
+  glm::vec4 rows[4];
+  for (int i = 0; i < 4; ++i) {
+    rows[i] = glm::vec4(viewProj[0][i], viewProj[1][i], viewProj[2][i],
+                        viewProj[3][i]);
+  }
+  for (int i = 0; i < 3; ++i) {
+    planes[2 * i] = rows[3] + rows[i];
+    planes[2 * i + 1] = rows[3] - rows[i];
+  }
+}
+
+bool Frustum::intersects(const glm::vec3 &lo, const glm::vec3 &hi) const {
+  for (const glm::vec4 &plane : planes) {
+    // the corner furthest along the normal is outside only if all are
+    glm::vec3 corner(plane.x > 0 ? hi.x : lo.x, plane.y > 0 ? hi.y : lo.y,
+                     plane.z > 0 ? hi.z : lo.z);
+    if (glm::dot(glm::vec3(plane), corner) + plane.w < 0) {
+      return false;
+    }
+  }
+  return true;
+}
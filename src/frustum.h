@@ -0,0 +1,17 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+// The six planes bounding what a view-projection matrix can see
+class Frustum {
+public:
+  explicit Frustum(const glm::mat4 &viewProj);
+
+  // Whether any part of the box from lo to hi may be visible. Boxes near a
+  // corner of the frustum can pass without touching it, which only costs a
+  // draw that produces no fragments.
+  bool intersects(const glm::vec3 &lo, const glm::vec3 &hi) const;
+
+private:
+  glm::vec4 planes[6]; // Normals point inwards, w is the offset
+};
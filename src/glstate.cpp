@@ -0,0 +1,183 @@
+#include "glstate.h"
+
+#include "rendercontext.h"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace {
+// activeUnit before any unit has been made active through GLState
+constexpr GLuint NoUnit = ~GLuint(0);
+// Depth and blend state before it has been set through GLState
+constexpr GLenum NoEnum = ~GLenum(0);
+} // namespace
+
+GLState::GLState(RenderContext *context)
+    : context(context), debug(qEnvironmentVariableIsSet("MICROMAYA_GL_DEBUG")),
+      program(0), vao(0), arrayBuffer(0), texBuffer(0), activeUnit(NoUnit),
+      textures(), capabilities(), depthFunc(NoEnum), depthMask(-1),
+      blendFunc(NoEnum, NoEnum), frame{0, 0}, lastFrame{0, 0} {}
+
+void GLState::invalidate() {
+  program = vao = arrayBuffer = texBuffer = 0;
+  activeUnit = NoUnit;
+  textures.fill({0, 0});
+  capabilities.clear();
+  depthFunc = NoEnum;
+  depthMask = -1;
+  blendFunc = {NoEnum, NoEnum};
+}
+
+bool GLState::skip(bool unchanged) {
+  ++(unchanged ? frame.skipped : frame.issued);
+  return unchanged;
+}
+
+void GLState::useProgram(GLuint p) {
+  if (skip(p && p == program)) {
+    return;
+  }
+  context->glUseProgram(p);
+  program = p;
+}
+
+void GLState::bindVertexArray(GLuint v) {
+  if (skip(v && v == vao)) {
+    return;
+  }
+  context->glBindVertexArray(v);
+  vao = v;
+}
+
+GLuint *GLState::bufferBinding(GLenum target) {
+  switch (target) {
+  case GL_ARRAY_BUFFER:
+    return &arrayBuffer;
+  case GL_TEXTURE_BUFFER:
+    return &texBuffer;
+  default:
+    return nullptr;
+  }
+}
+
+void GLState::bindBuffer(GLenum target, GLuint buffer) {
+  GLuint *bound = bufferBinding(target);
+  if (skip(bound && buffer && *bound == buffer)) {
+    return;
+  }
+  context->glBindBuffer(target, buffer);
+  if (bound) {
+    *bound = buffer;
+  }
+}
+
+void GLState::bindTexture(GLuint unit, GLenum target, GLuint texture) {
+  bool tracked = unit < MaxUnits;
+  if (skip(tracked && texture &&
+           textures[unit] == std::make_pair(target, texture))) {
+    return;
+  }
+  if (!skip(unit == activeUnit)) {
+    context->glActiveTexture(GL_TEXTURE0 + unit);
+    activeUnit = unit;
+  }
+  context->glBindTexture(target, texture);
+  if (tracked) {
+    textures[unit] = {target, texture};
+  }
+}
+
+void GLState::setEnabled(GLenum capability, bool enabled) {
+  auto it = std::find_if(capabilities.begin(), capabilities.end(),
+                         [&](auto &c) { return c.first == capability; });
+  if (skip(it != capabilities.end() && it->second == enabled)) {
+    return;
+  }
+  if (enabled) {
+    context->glEnable(capability);
+  } else {
+    context->glDisable(capability);
+  }
+  if (it != capabilities.end()) {
+    it->second = enabled;
+  } else {
+    capabilities.push_back({capability, enabled});
+  }
+}
+
+void GLState::setDepthFunc(GLenum func) {
+  if (skip(func == depthFunc)) {
+    return;
+  }
+  context->glDepthFunc(func);
+  depthFunc = func;
+}
+
+void GLState::setDepthMask(bool write) {
+  if (skip(int(write) == depthMask)) {
+    return;
+  }
+  context->glDepthMask(write ? GL_TRUE : GL_FALSE);
+  depthMask = write;
+}
+
+void GLState::setBlendFunc(GLenum src, GLenum dst) {
+  if (skip(blendFunc == std::make_pair(src, dst))) {
+    return;
+  }
+  context->glBlendFunc(src, dst);
+  blendFunc = {src, dst};
+}
+
+void GLState::deleteBuffer(GLuint buffer) {
+  for (GLuint *bound : {&arrayBuffer, &texBuffer}) {
+    if (*bound == buffer) {
+      *bound = 0;
+    }
+  }
+  context->glDeleteBuffers(1, &buffer);
+  ++frame.issued;
+}
+
+void GLState::deleteVertexArray(GLuint v) {
+  if (vao == v) {
+    vao = 0;
+  }
+  context->glDeleteVertexArrays(1, &v);
+  ++frame.issued;
+}
+
+void GLState::deleteTexture(GLuint texture) {
+  for (auto &bound : textures) {
+    if (bound.second == texture) {
+      bound = {0, 0};
+    }
+  }
+  context->glDeleteTextures(1, &texture);
+  ++frame.issued;
+}
+
+bool GLState::isDebug() const { return debug; }
+
+void GLState::checkErrors() {
+  if (debug) {
+    context->printGLErrorLog();
+  }
+}
+
+void GLState::countIssued(int calls) { frame.issued += calls; }
+
+void GLState::countSkipped(int calls) { frame.skipped += calls; }
+
+void GLState::beginFrame() { frame = {0, 0}; }
+
+void GLState::endFrame() {
+  if (debug && (frame.issued != lastFrame.issued ||
+                frame.skipped != lastFrame.skipped)) {
+    printf("GL calls per frame: %d issued, %d skipped\n", frame.issued,
+           frame.skipped);
+  }
+  lastFrame = frame;
+}
+
+const GLState::FrameStats &GLState::getLastFrame() const { return lastFrame; }
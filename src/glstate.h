@@ -0,0 +1,93 @@
+#pragma once
+
+#include <QOpenGLFunctions_3_2_Core>
+
+#include <array>
+#include <utility>
+#include <vector>
+
+class RenderContext;
+
+/**
+ * The GL bindings and capabilities last set through it, so that setting one
+ * to the value it already has skips the GL call.
+ *
+ * Tracks the current program, vertex array, the buffers bound to targets
+ * outside the vertex array (the element array buffer is part of each VAO),
+ * the texture bound to each unit, enabled capabilities, and the depth and
+ * blend functions and depth mask. Vertex attribute arrays are VAO state too,
+ * and each Drawable only reconfigures its own when the layout changes.
+ * Uniforms belong to programs, so ShaderProgram keeps their values itself and
+ * reports through the same counters.
+ *
+ * Everything that binds or deletes these objects has to go through here, or
+ * the cache no longer matches GL; invalidate() forgets it all for code that
+ * cannot, such as Qt's own painting.
+ *
+ * Setting MICROMAYA_GL_DEBUG checks glGetError after every draw, which
+ * otherwise costs a round trip to the driver each time, and prints how many
+ * calls each frame issued and skipped whenever that changes.
+ */
+class GLState {
+public:
+  explicit GLState(RenderContext *context);
+
+  // Forgets every binding, so the next request for each is issued
+  void invalidate();
+
+  void useProgram(GLuint program);
+  void bindVertexArray(GLuint vao);
+  void bindBuffer(GLenum target, GLuint buffer);
+  // Makes unit active if the texture bound there has to change
+  void bindTexture(GLuint unit, GLenum target, GLuint texture);
+  void setEnabled(GLenum capability, bool enabled);
+  void setDepthFunc(GLenum func);
+  void setDepthMask(bool write);
+  void setBlendFunc(GLenum src, GLenum dst);
+
+  // Delete the object and drop it from any binding, since GL reverts those
+  // to 0 and a new object may get the same name
+  void deleteBuffer(GLuint buffer);
+  void deleteVertexArray(GLuint vao);
+  void deleteTexture(GLuint texture);
+
+  bool isDebug() const;
+  // Reports any GL error when debugging, and does nothing otherwise
+  void checkErrors();
+
+  // Calls made or avoided outside the methods above, such as uniforms
+  void countIssued(int calls = 1);
+  void countSkipped(int calls = 1);
+
+  struct FrameStats {
+    int issued;  // GL calls made
+    int skipped; // Calls that would not have changed anything
+  };
+  void beginFrame();
+  void endFrame();
+  const FrameStats &getLastFrame() const;
+
+private:
+  // Texture units whose bindings are tracked; others are always bound
+  static constexpr GLuint MaxUnits = 8;
+
+  RenderContext *context;
+  bool debug;
+
+  GLuint program;     // 0 doubles as unknown: binding 0 is never skipped
+  GLuint vao;
+  GLuint arrayBuffer; // GL_ARRAY_BUFFER
+  GLuint texBuffer;   // GL_TEXTURE_BUFFER
+  GLuint activeUnit;  // ~0 when unknown
+  std::array<std::pair<GLenum, GLuint>, MaxUnits> textures; // Per unit
+  std::vector<std::pair<GLenum, bool>> capabilities; // Those set so far
+  GLenum depthFunc; // ~0 when unknown, as are the others
+  int depthMask;
+  std::pair<GLenum, GLenum> blendFunc; // Source and destination factors
+
+  FrameStats frame;
+  FrameStats lastFrame;
+
+  GLuint *bufferBinding(GLenum target); // Null for untracked targets
+  bool skip(bool unchanged);            // Counts the call either way
+};
@@ -0,0 +1,88 @@
+#include "gputimers.h"
+
+#include "frameprofile.h"
+#include "rendercontext.h"
+
+#include <QOpenGLContext>
+
+#ifndef GL_TIME_ELAPSED
+#define GL_TIME_ELAPSED 0x88BF
+#endif
+
+GpuTimers::GpuTimers(RenderContext *context)
+    : context(context), getQueryObjectui64v(nullptr), frames(), current(0),
+      depth(0) {}
+
+void GpuTimers::initialize() {
+  QOpenGLContext *ctx = context->glContext();
+  if (ctx->format().version() >= qMakePair(3, 3) ||
+      ctx->hasExtension("GL_ARB_timer_query")) {
+    getQueryObjectui64v = reinterpret_cast<GetQueryObjectui64v>(
+        ctx->getProcAddress("glGetQueryObjectui64v"));
+  }
+}
+
+bool GpuTimers::isSupported() const { return getQueryObjectui64v; }
+
+void GpuTimers::destroy() {
+  for (Frame &frame : frames) {
+    for (Query &query : frame.queries) {
+      context->glDeleteQueries(1, &query.id);
+    }
+    frame = Frame();
+  }
+  depth = 0;
+}
+
+void GpuTimers::beginFrame() {
+  if (!isSupported()) {
+    return;
+  }
+  current = (current + 1) % FrameCount;
+  collect(frames[current]);
+  depth = 0;
+}
+
+void GpuTimers::begin(const char *name) {
+  if (!isSupported() || depth++ > 0) {
+    return;
+  }
+  Frame &frame = frames[current];
+  if (frame.used == frame.queries.size()) {
+    Query query{0, nullptr, 0};
+    context->glGenQueries(1, &query.id);
+    frame.queries.push_back(query);
+  }
+  Query &query = frame.queries[frame.used++];
+  query.name = name;
+  query.issued = frameprofile::now();
+  context->glBeginQuery(GL_TIME_ELAPSED, query.id);
+  context->glState().countIssued();
+}
+
+void GpuTimers::end() {
+  if (!isSupported() || depth == 0 || --depth > 0) {
+    return;
+  }
+  context->glEndQuery(GL_TIME_ELAPSED);
+  context->glState().countIssued();
+}
+
+void GpuTimers::collect(Frame &frame) {
+  if (frame.used == 0) {
+    return;
+  }
+  // queries finish in order, so the last one being ready means all are
+  GLuint available = 0;
+  context->glGetQueryObjectuiv(frame.queries[frame.used - 1].id,
+                               GL_QUERY_RESULT_AVAILABLE, &available);
+  if (available) {
+    for (size_t i = 0; i < frame.used; ++i) {
+      GLuint64 elapsed = 0;
+      getQueryObjectui64v(frame.queries[i].id, GL_QUERY_RESULT, &elapsed);
+      frameprofile::record(frame.queries[i].name, true,
+                           frame.queries[i].issued, elapsed);
+    }
+  }
+  frame.used = 0;
+}
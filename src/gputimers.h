@@ -0,0 +1,60 @@
+#pragma once
+
+#include <QOpenGLFunctions_3_2_Core>
+
+#include <array>
+#include <vector>
+
+class RenderContext;
+
+/**
+ * GL_TIME_ELAPSED queries around draws, recorded in the frame profile.
+ *
+ * Results are only read once the GPU has finished with them, so the queries
+ * are double buffered by frame: each frame reads back the ones issued two
+ * frames before and reuses their objects. If the GPU is still behind even
+ * then, that frame's timings are dropped rather than waited for.
+ *
+ * Needs OpenGL 3.3 or ARB_timer_query; without them nothing is timed.
+ */
+class GpuTimers {
+public:
+  explicit GpuTimers(RenderContext *context);
+
+  // Checks for timer query support. Needs the context to be current.
+  void initialize();
+  bool isSupported() const;
+  void destroy();
+
+  // Records the timings of the frame before last and starts a new one
+  void beginFrame();
+  // Times the GL commands issued until end(). Timings cannot nest, so a
+  // begin() while one is running is ignored along with its end().
+  void begin(const char *name);
+  void end();
+
+private:
+  static constexpr int FrameCount = 2;
+
+  // glGetQueryObjectui64v, which the 3.2 core functions do not include
+  using GetQueryObjectui64v = void(QOPENGLF_APIENTRYP)(GLuint, GLenum,
+                                                       GLuint64 *);
+
+  struct Query {
+    GLuint id;
+    const char *name;
+    qint64 issued; // frameprofile::now() at begin()
+  };
+  struct Frame {
+    std::vector<Query> queries; // Objects are kept for reuse
+    size_t used;                // Those issued this time around
+  };
+
+  RenderContext *context;
+  GetQueryObjectui64v getQueryObjectui64v; // Null if unsupported
+  std::array<Frame, FrameCount> frames;
+  int current;
+  int depth; // begin() calls without their end() yet
+
+  void collect(Frame &frame);
+};
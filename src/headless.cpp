@@ -0,0 +1,230 @@
+#include "headless.h"
+
+#include "offscreenrenderer.h"
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QProcess>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace {
+const char *Usage =
+    "Usage: microMayaUSD --render MESH.obj -o IMAGE.png [options]\n"
+    "       microMayaUSD --render-batch JOBS.txt [options]\n"
+    "\n"
+    "Options:\n"
+    "  -o, --output FILE        Image to write; the suffix picks the format\n"
+    "  --skeleton FILE.json     Bind the mesh to a skeleton\n"
+    "  --pose JOINT=RX,RY,RZ    Rotate a joint from its rest pose, in "
+    "degrees; repeatable\n"
+    "  --dual-quat              Dual quaternion rather than linear skinning\n"
+    "  --size WxH               Image size (default 512x512)\n"
+    "  --orbit RY,RX            Camera orbit angles in degrees "
+    "(default 30,-20)\n"
+    "  --distance D             Camera distance (default: fit the mesh)\n"
+    "  --target X,Y,Z           Orbit center (default: the mesh's center)\n"
+    "  --fov DEGREES            Vertical field of view (default 45)\n"
+    "\n"
+    "Without a display, Qt's offscreen platform is used unless "
+    "QT_QPA_PLATFORM\nsays otherwise. Under Mesa, LIBGL_ALWAYS_SOFTWARE=1 "
+    "renders with llvmpipe.\n";
+
+// Parses count comma separated numbers
+bool parseFloats(const QString &text, int count, float *out) {
+  QStringList parts = text.split(',');
+  if (parts.size() != count) {
+    return false;
+  }
+  for (int i = 0; i < count; ++i) {
+    bool ok;
+    out[i] = parts[i].trimmed().toFloat(&ok);
+    if (!ok) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Applies the arguments to job. Relative paths are taken relative to dir.
+bool parseJob(const QStringList &args, const QDir &dir, RenderJob *job,
+              QString *error) {
+  for (int i = 0; i < args.size(); ++i) {
+    const QString &arg = args[i];
+    if (arg == "--dual-quat") {
+      job->mode = SkinningMode::DUAL_QUATERNION;
+      continue;
+    }
+    if (!arg.startsWith('-')) {
+      job->meshPath = dir.filePath(arg);
+      continue;
+    }
+
+    if (i + 1 == args.size()) {
+      *error = arg + " needs a value";
+      return false;
+    }
+    const QString &value = args[++i];
+    bool ok = true;
+    float v[3];
+    if (arg == "-o" || arg == "--output") {
+      job->outputPath = dir.filePath(value);
+    } else if (arg == "--skeleton") {
+      job->skeletonPath = dir.filePath(value);
+    } else if (arg == "--pose") {
+      int split = value.indexOf('=');
+      ok = split > 0 && parseFloats(value.mid(split + 1), 3, v);
+      if (ok) {
+        job->pose.push_back({value.left(split), glm::vec3(v[0], v[1], v[2])});
+      }
+    } else if (arg == "--size") {
+      QStringList size = value.split('x');
+      ok = size.size() == 2;
+      if (ok) {
+        bool okW, okH;
+        job->width = size[0].toInt(&okW);
+        job->height = size[1].toInt(&okH);
+        ok = okW && okH && job->width > 0 && job->height > 0;
+      }
+    } else if (arg == "--orbit") {
+      ok = parseFloats(value, 2, v);
+      if (ok) {
+        job->rotY = v[0];
+        job->rotX = v[1];
+      }
+    } else if (arg == "--distance") {
+      job->distance = value.toFloat(&ok);
+    } else if (arg == "--target") {
+      ok = parseFloats(value, 3, v);
+      if (ok) {
+        job->target = glm::vec3(v[0], v[1], v[2]);
+      }
+    } else if (arg == "--fov") {
+      job->fovy = value.toFloat(&ok);
+      ok = ok && job->fovy > 0 && job->fovy < 180;
+    } else {
+      *error = "Unknown option " + arg;
+      return false;
+    }
+    if (!ok) {
+      *error = "Invalid value for " + arg + ": " + value;
+      return false;
+    }
+  }
+  return true;
+}
+
+bool checkJob(const RenderJob &job, QString *error) {
+  if (job.meshPath.isEmpty()) {
+    *error = "No mesh given";
+  } else if (job.outputPath.isEmpty()) {
+    *error = "No output image given for " + job.meshPath;
+  } else if (!job.pose.empty() && job.skeletonPath.isEmpty()) {
+    *error = "Posing " + job.meshPath + " needs a skeleton";
+  } else {
+    return true;
+  }
+  return false;
+}
+
+// Reads the renders listed in a batch file on top of defaults
+bool readBatch(const QString &path, const RenderJob &defaults,
+               std::vector<RenderJob> *jobs, QString *error) {
+  QFile file(path);
+  if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+    *error = path + ": " + file.errorString();
+    return false;
+  }
+  QDir dir = QFileInfo(path).dir();
+  int lineNumber = 0;
+  while (!file.atEnd()) {
+    QString line = QString::fromUtf8(file.readLine()).trimmed();
+    ++lineNumber;
+    if (line.isEmpty() || line.startsWith('#')) {
+      continue;
+    }
+    RenderJob job = defaults;
+    if (!parseJob(QProcess::splitCommand(line), dir, &job, error) ||
+        !checkJob(job, error)) {
+      *error = QString("%1:%2: %3").arg(path).arg(lineNumber).arg(*error);
+      return false;
+    }
+    jobs->push_back(job);
+  }
+  return true;
+}
+} // namespace
+
+namespace headless {
+bool isRequested(int argc, char *argv[]) {
+  return argc > 1 && (std::strcmp(argv[1], "--render") == 0 ||
+                      std::strcmp(argv[1], "--render-batch") == 0);
+}
+
+void choosePlatform() {
+  if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM") &&
+      qEnvironmentVariableIsEmpty("DISPLAY") &&
+      qEnvironmentVariableIsEmpty("WAYLAND_DISPLAY")) {
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+  }
+}
+
+int run(const QStringList &arguments) {
+  bool batch = arguments.value(1) == "--render-batch";
+  QStringList options = arguments.mid(batch ? 3 : 2);
+  std::vector<RenderJob> jobs;
+  QString error;
+
+  // options on the command line are the defaults of every batch line
+  RenderJob job = RenderJob::defaults();
+  bool parsed = parseJob(options, QDir::current(), &job, &error);
+  if (parsed && batch) {
+    parsed = arguments.size() > 2 && !arguments[2].startsWith('-');
+    if (!parsed) {
+      error = "No batch file given";
+    } else {
+      parsed = readBatch(arguments[2], job, &jobs, &error);
+    }
+  } else if (parsed) {
+    parsed = checkJob(job, &error);
+    jobs.push_back(job);
+  }
+  if (!parsed) {
+    fprintf(stderr, "%s\n\n%s", error.toLocal8Bit().constData(), Usage);
+    return 2;
+  }
+
+  OffscreenRenderer renderer;
+  if (!renderer.initialize(&error)) {
+    fprintf(stderr, "%s\n", error.toLocal8Bit().constData());
+    return 1;
+  }
+
+  QElapsedTimer total;
+  total.start();
+  int failed = 0;
+  for (const RenderJob &j : jobs) {
+    QElapsedTimer timer;
+    timer.start();
+    if (renderer.render(j, &error)) {
+      printf("%s (%.1f ms)\n", j.outputPath.toLocal8Bit().constData(),
+             timer.nsecsElapsed() / 1e6);
+    } else {
+      fprintf(stderr, "%s: %s\n", j.outputPath.toLocal8Bit().constData(),
+              error.toLocal8Bit().constData());
+      ++failed;
+    }
+  }
+
+  double seconds = total.nsecsElapsed() / 1e9;
+  printf("Rendered %d of %zu images in %.2f s (%.0f per minute)\n",
+         int(jobs.size()) - failed, jobs.size(), seconds,
+         (jobs.size() - failed) * 60 / std::max(seconds, 1e-9));
+  return failed ? 1 : 0;
+}
+} // namespace headless
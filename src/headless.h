@@ -0,0 +1,27 @@
+#pragma once
+
+#include <QStringList>
+
+/**
+ * The command line for rendering images without the UI:
+ *
+ *   microMayaUSD --render MESH.obj -o IMAGE.png [options]
+ *   microMayaUSD --render-batch JOBS.txt [options]
+ *
+ * A batch file holds one render per line, written as the arguments of
+ * --render; blank lines and lines starting with # are skipped. Options given
+ * after --render-batch apply to every line unless the line sets them, and
+ * relative paths in the file are relative to the file. Every render shares
+ * one OpenGL context. See usage() for the options.
+ */
+namespace headless {
+// Whether the arguments ask for a headless render rather than the UI
+bool isRequested(int argc, char *argv[]);
+
+// Picks a platform that needs no display, unless one was chosen already.
+// Must be called before the application is constructed.
+void choosePlatform();
+
+// Renders what the application's arguments ask for. Returns the exit code.
+int run(const QStringList &arguments);
+} // namespace headless
@@ -1,9 +1,14 @@
+#include <headless.h>
 #include <mainwindow.h>
+#include <skeletondata/skinning.h>
+#include <startupprofile.h>
 
 #include <QApplication>
 #include <QDebug>
 #include <QSurfaceFormat>
 
+#include <cstring>
+
 void debugFormatVersion() {
   QSurfaceFormat form = QSurfaceFormat::defaultFormat();
   QSurfaceFormat::OpenGLContextProfile prof = form.profile();
@@ -18,9 +23,45 @@ void debugFormatVersion() {
   printf("  Profile: %s\n", profile);
 }
 
+// Prints the vertex throughput of every skinning path, for comparing
+// machines and builds without starting the UI
+void benchmarkSkinning() {
+  const size_t vertexCount = 1 << 20;
+  const int jointCount = 64;
+
+  printf("Skinning benchmark (%s, %zu vertices, %d joints)\n",
+         skinning::simdPath(), vertexCount, jointCount);
+  for (int influences : {2, 4, 8}) {
+    for (auto &result :
+         skinning::benchmark(vertexCount, influences, jointCount)) {
+      printf("  %d influences, %-15s %-8s %8.2f M vertices/s\n", influences,
+             result.mode == SkinningMode::LINEAR ? "linear," : "dual quat,",
+             result.parallel ? "parallel" : "serial",
+             result.verticesPerSecond / 1e6);
+    }
+  }
+}
+
 int main(int argc, char *argv[]) {
+  bool profileStartup = false;
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--benchmark-skinning") == 0) {
+      benchmarkSkinning();
+      return 0;
+    }
+    if (std::strcmp(argv[i], "--profile-startup") == 0) {
+      profileStartup = true;
+    }
+  }
+  startupprofile::start(profileStartup);
+  bool render = headless::isRequested(argc, argv);
+  if (render) {
+    headless::choosePlatform();
+  }
+
   QApplication::setAttribute(Qt::AA_EnableHighDpiScaling);
   QApplication a(argc, argv);
+  startupprofile::mark("Qt application");
 
   // Set OpenGL 3.2 and, optionally, 4-sample multisampling
   QSurfaceFormat format;
@@ -36,9 +77,13 @@ int main(int argc, char *argv[]) {
     format.setSamples(0);
 
   QSurfaceFormat::setDefaultFormat(format);
+  if (render) {
+    return headless::run(QApplication::arguments());
+  }
   debugFormatVersion();
 
   MainWindow w;
+  startupprofile::mark("Main window");
   w.show();
 
   return a.exec();
@@ -1,46 +1,82 @@
 #include "mainwindow.h"
 
 #include "cameracontrolshelp.h"
+#include "frameprofile.h"
 #include "ui_mainwindow.h"
 #include "utils.h"
 
 #include <QFileDialog>
-#include <QJsonDocument>
+#include <QFileInfo>
+#include <QInputDialog>
 #include <QMessageBox>
+#include <algorithm>
+#include <cmath>
 #include <filesystem>
 
 MainWindow::MainWindow(QWidget *parent)
-    : QMainWindow(parent), ui(new Ui::MainWindow) {
+    : QMainWindow(parent), ui(new Ui::MainWindow),
+      vertsModel(new MeshListModel(MeshListModel::VERTICES, this)),
+      halfEdgesModel(new MeshListModel(MeshListModel::HALF_EDGES, this)),
+      facesModel(new MeshListModel(MeshListModel::FACES, this)) {
   ui->setupUi(this);
   ui->mygl->setFocus();
 
   // load OBJ button
   connect(ui->actionImportOBJ, &QAction::triggered, this,
           &MainWindow::slot_loadObj);
+  connect(ui->actionImportBlendShape, &QAction::triggered, this,
+          &MainWindow::slot_loadBlendShape);
   // load skeleton button
   connect(ui->actionImportJSONSkeleton, &QAction::triggered, this,
           &MainWindow::slot_loadSkeleton);
   // export USD button
   connect(ui->actionExportUSD, &QAction::triggered, this,
           &MainWindow::slot_exportUSD);
+  connect(ui->actionExportBakedUSD, &QAction::triggered, this,
+          &MainWindow::slot_exportBakedUSD);
   connect(ui->actionVerifyUSDAsset, &QAction::triggered, this,
           &MainWindow::slot_verifyUSDAsset);
+  // undo/redo
+  connect(ui->actionUndo, &QAction::triggered, ui->mygl, &MyGL::slot_undo);
+  connect(ui->actionRedo, &QAction::triggered, ui->mygl, &MyGL::slot_redo);
+  // performance
+  connect(ui->actionPerformanceHUD, &QAction::toggled, ui->mygl,
+          &MyGL::slot_setHudVisible);
+  connect(ui->actionWireframe, &QAction::toggled, ui->mygl,
+          &MyGL::slot_setWireframeVisible);
+  connect(ui->actionSavePerformanceTrace, &QAction::triggered, this,
+          &MainWindow::slot_savePerformanceTrace);
+  connect(ui->mygl, &MyGL::signal_historyChanged, this,
+          &MainWindow::slot_showHistory);
+  connect(ui->mygl, &MyGL::signal_exportFinished, this,
+          &MainWindow::slot_exportFinished);
+  connect(ui->mygl, &MyGL::signal_bakeProgress, this,
+          &MainWindow::slot_showBakeProgress);
+  connect(ui->mygl, &MyGL::signal_bindProgress, this,
+          &MainWindow::slot_showBindProgress);
+  connect(ui->mygl, &MyGL::signal_bindFinished, this,
+          &MainWindow::slot_bindFinished);
 
   // ui initialization
   connect(ui->mygl, &MyGL::signal_clearUI, this, &MainWindow::slot_clearUI);
 
-  connect(ui->mygl, &MyGL::signal_addVertex, this, &MainWindow::slot_addVertex);
-  connect(ui->mygl, &MyGL::signal_addFace, this, &MainWindow::slot_addFace);
-  connect(ui->mygl, &MyGL::signal_addEdge, this, &MainWindow::slot_addEdge);
+  connect(ui->mygl, &MyGL::signal_meshChanged, this,
+          &MainWindow::slot_showMesh);
   connect(ui->mygl, &MyGL::signal_setJoint, this, &MainWindow::slot_setJoint);
 
   // selecting vert, face, edge, or joint
-  connect(ui->vertsListWidget, &QListWidget::itemClicked, this,
-          &MainWindow::slot_setSelectedVertex);
-  connect(ui->facesListWidget, &QListWidget::itemClicked, this,
-          &MainWindow::slot_setSelectedFace);
-  connect(ui->halfEdgesListWidget, &QListWidget::itemClicked, this,
-          &MainWindow::slot_setSelectedEdge);
+  setUpElementList(ui->vertsListView, ui->vertsSearchEdit, vertsModel,
+                   [this](int row) {
+                     slot_setSelectedVertex(vertsModel->getVertex(row));
+                   });
+  setUpElementList(ui->halfEdgesListView, ui->halfEdgesSearchEdit,
+                   halfEdgesModel, [this](int row) {
+                     slot_setSelectedEdge(halfEdgesModel->getEdge(row));
+                   });
+  setUpElementList(ui->facesListView, ui->facesSearchEdit, facesModel,
+                   [this](int row) {
+                     slot_setSelectedFace(facesModel->getFace(row));
+                   });
   connect(ui->jointsTreeWidget, &QTreeWidget::itemClicked, this,
           &MainWindow::slot_setSelectedJoint);
   // from mygl to here back to mygl
@@ -50,6 +86,8 @@ MainWindow::MainWindow(QWidget *parent)
           &MainWindow::slot_setSelectedFace);
   connect(ui->mygl, &MyGL::signal_setSelectedEdge, this,
           &MainWindow::slot_setSelectedEdge);
+  connect(ui->mygl, &MyGL::signal_setSelectedJoint, this,
+          &MainWindow::slot_setSelectedJoint);
 
   // set vertex position, face color
   connect(ui->vertPosXSpinBox, &QDoubleSpinBox::valueChanged, ui->mygl,
@@ -92,6 +130,46 @@ MainWindow::MainWindow(QWidget *parent)
   // skeleton operations
   connect(ui->bindMeshButton, &QPushButton::released, ui->mygl,
           &MyGL::bindMesh);
+  connect(ui->skinModeComboBox, &QComboBox::currentIndexChanged, ui->mygl,
+          &MyGL::slot_setSkinningMode);
+  connect(ui->influenceSpinBox, &QSpinBox::valueChanged, ui->mygl,
+          &MyGL::slot_setInfluenceCount);
+  connect(ui->heatWeightsCheckBox, &QCheckBox::toggled, ui->mygl,
+          &MyGL::slot_setHeatWeights);
+  connect(ui->ikGroupBox, &QGroupBox::toggled, ui->mygl,
+          &MyGL::slot_setIkEnabled);
+  connect(ui->ikMethodComboBox, &QComboBox::currentIndexChanged, ui->mygl,
+          &MyGL::slot_setIkMethod);
+  connect(ui->ikChainSpinBox, &QSpinBox::valueChanged, ui->mygl,
+          &MyGL::slot_setIkChainLength);
+
+  // animation timeline
+  const Animation &animation = ui->mygl->getAnimation();
+  ui->timelineSlider->setRange(animation.getFirstFrame(),
+                               animation.getLastFrame());
+  ui->frameSpinBox->setRange(animation.getFirstFrame(),
+                             animation.getLastFrame());
+  connect(ui->timelineSlider, &QSlider::valueChanged, ui->mygl,
+          &MyGL::slot_setFrame);
+  connect(ui->frameSpinBox, &QSpinBox::valueChanged, ui->mygl,
+          &MyGL::slot_setFrame);
+  connect(ui->mygl, &MyGL::signal_frameChanged, this,
+          &MainWindow::slot_showFrame);
+  connect(ui->playButton, &QPushButton::toggled, ui->mygl,
+          &MyGL::slot_setPlaying);
+  connect(ui->keyJointButton, &QPushButton::released, ui->mygl,
+          &MyGL::slot_keySelectedJoint);
+
+  // blend shapes
+  connect(ui->mygl, &MyGL::signal_addBlendShape, this,
+          &MainWindow::slot_addBlendShape);
+  connect(ui->blendShapeComboBox, &QComboBox::currentIndexChanged, this,
+          &MainWindow::slot_showBlendShapeWeight);
+  connect(ui->blendShapeWeightSlider, &QSlider::valueChanged, ui->mygl,
+          [=](int percent) {
+            ui->mygl->slot_setBlendShapeWeight(
+                ui->blendShapeComboBox->currentIndex(), percent / 100.0);
+          });
 }
 
 MainWindow::~MainWindow() { delete ui; }
@@ -126,6 +204,36 @@ void MainWindow::slot_loadObj() {
   file.close();
 }
 
+void MainWindow::slot_loadBlendShape() {
+  if (!ui->mygl->isMeshLoaded()) {
+    QMessageBox::information(
+        0, "No mesh to add a blend shape to",
+        "A mesh must be loaded before importing its blend shapes.");
+    return;
+  }
+
+  QString filePath = QFileDialog::getOpenFileName(
+      this, "Select an OBJ file with the same topology as the mesh",
+      "./resources/obj_files", "OBJ Files (*.obj)");
+
+  if (filePath.isEmpty() || filePath.isNull())
+    return;
+
+  QFile file = QFile(filePath, this);
+
+  // make sure file is readable
+  if (!file.open(QIODevice::ReadOnly)) {
+    QMessageBox::information(0, "File cannot be read", file.errorString());
+    return;
+  }
+
+  QString error;
+  QString name = QFileInfo(filePath).completeBaseName();
+  if (!ui->mygl->loadBlendShape(file, name, &error)) {
+    QMessageBox::warning(this, "Blend shape cannot be loaded", error);
+  }
+}
+
 void MainWindow::slot_loadSkeleton() {
   QString filePath =
       QFileDialog::getOpenFileName(this, "Select a JSON skeleton file to load",
@@ -142,8 +250,10 @@ void MainWindow::slot_loadSkeleton() {
     return;
   }
 
-  auto jsonDoc = QJsonDocument().fromJson(file.readAll());
-  ui->mygl->loadSkeleton(jsonDoc);
+  QString error;
+  if (!ui->mygl->loadSkeleton(file.readAll(), &error)) {
+    QMessageBox::warning(this, "Skeleton cannot be loaded", error);
+  }
 }
 
 void MainWindow::slot_exportUSD() {
@@ -160,6 +270,102 @@ void MainWindow::slot_exportUSD() {
     return;
 
   ui->mygl->exportUSD(filePath);
+  ui->statusBar->showMessage("Exporting " + filePath + "...");
+}
+
+void MainWindow::slot_exportBakedUSD() {
+  if (!ui->mygl->isMeshBound()) {
+    QMessageBox::information(
+        0, "No animated mesh to bake",
+        "A mesh must be bound to a skeleton before baking a point cache.");
+    return;
+  }
+
+  QString filePath = QFileDialog::getSaveFileName(
+      this, "Save a baked USD point cache", "./", "USD Crate Files (*.usdc)");
+
+  if (filePath.isEmpty() || filePath.isNull())
+    return;
+
+  // the timeline's range is the default, but frames outside it just hold
+  // the first or last key
+  const Animation &animation = ui->mygl->getAnimation();
+  bool ok;
+  int first = QInputDialog::getInt(this, "Bake point cache", "First frame:",
+                                   animation.getFirstFrame(), -100000, 100000,
+                                   1, &ok);
+  if (!ok)
+    return;
+  int last = QInputDialog::getInt(this, "Bake point cache", "Last frame:",
+                                  std::max(first, animation.getLastFrame()),
+                                  first, 100000, 1, &ok);
+  if (!ok)
+    return;
+
+  ui->mygl->exportBakedUSD(filePath, first, last,
+                           ui->actionBakeNormals->isChecked());
+  ui->statusBar->showMessage("Baking " + filePath + "...");
+}
+
+void MainWindow::slot_savePerformanceTrace() {
+  QString filePath = QFileDialog::getSaveFileName(
+      this, "Save a performance trace", "./", "Chrome Trace Files (*.json)");
+
+  if (filePath.isEmpty() || filePath.isNull())
+    return;
+
+  QString error;
+  if (!frameprofile::writeTrace(filePath, &error)) {
+    QMessageBox::warning(this, "Could not save trace", error);
+    return;
+  }
+  ui->statusBar->showMessage("Saved performance trace to " + filePath);
+}
+
+void MainWindow::slot_showBakeProgress(int writtenFrames, int totalFrames) {
+  ui->statusBar->showMessage(
+      QString("Baking: %1/%2 frames").arg(writtenFrames).arg(totalFrames));
+}
+
+void MainWindow::slot_exportFinished(const QString &filePath, bool success) {
+  if (!success) {
+    QMessageBox::warning(this, "Export failed",
+                         "Could not create a USD stage at " + filePath);
+    return;
+  }
+  ui->statusBar->showMessage("Exported " + filePath);
+}
+
+void MainWindow::slot_showBindProgress(int solvedJoints, int totalJoints) {
+  ui->statusBar->showMessage(QString("Computing heat weights: %1/%2 joints")
+                                 .arg(solvedJoints)
+                                 .arg(totalJoints));
+}
+
+void MainWindow::slot_bindFinished(bool applied) {
+  ui->statusBar->showMessage(applied ? "Bound with heat weights"
+                                     : "Discarded outdated heat weights");
+}
+
+void MainWindow::slot_showFrame(int frame) {
+  ui->timelineSlider->blockSignals(true);
+  ui->frameSpinBox->blockSignals(true);
+  ui->timelineSlider->setValue(frame);
+  ui->frameSpinBox->setValue(frame);
+  ui->timelineSlider->blockSignals(false);
+  ui->frameSpinBox->blockSignals(false);
+}
+
+void MainWindow::slot_addBlendShape(const QString &name) {
+  ui->blendShapeComboBox->addItem(name);
+  ui->blendShapeComboBox->setCurrentIndex(ui->blendShapeComboBox->count() - 1);
+}
+
+void MainWindow::slot_showBlendShapeWeight(int target) {
+  float weight = target < 0 ? 0 : ui->mygl->getBlendShapeWeight(target);
+  ui->blendShapeWeightSlider->blockSignals(true);
+  ui->blendShapeWeightSlider->setValue(std::lround(weight * 100));
+  ui->blendShapeWeightSlider->blockSignals(false);
 }
 
 void MainWindow::slot_verifyUSDAsset() {
@@ -173,24 +379,23 @@ void MainWindow::slot_verifyUSDAsset() {
 }
 
 void MainWindow::slot_clearUI() {
-  ui->vertsListWidget->clear();
-  ui->facesListWidget->clear();
-  ui->halfEdgesListWidget->clear();
+  for (MeshListModel *model : {vertsModel, halfEdgesModel, facesModel}) {
+    model->setMesh(nullptr);
+  }
+  ui->blendShapeComboBox->clear(); // A new mesh has no targets
 
   updateVertPosSpinBoxes(glm::vec3(0));
   updateFaceColorSpinBoxes(glm::vec3(0));
 }
 
-void MainWindow::slot_addVertex(Vertex *vert) {
-  ui->vertsListWidget->addItem(vert);
-}
-
-void MainWindow::slot_addFace(Face *face) {
-  ui->facesListWidget->addItem(face);
+void MainWindow::slot_showMesh(Mesh *mesh) {
+  for (MeshListModel *model : {vertsModel, halfEdgesModel, facesModel}) {
+    model->setMesh(mesh);
+  }
 }
 
-void MainWindow::slot_addEdge(HalfEdge *edge) {
-  ui->halfEdgesListWidget->addItem(edge);
+void MainWindow::slot_showHistory(const QString &summary) {
+  ui->statusBar->showMessage(summary);
 }
 
 void MainWindow::slot_setJoint(Joint *joint) {
@@ -199,7 +404,7 @@ void MainWindow::slot_setJoint(Joint *joint) {
   ui->jointsTreeWidget->addTopLevelItem(joint);
 }
 
-void MainWindow::slot_setSelectedVertex(QListWidgetItem *vert) {
+void MainWindow::slot_setSelectedVertex(Vertex *vert) {
   if (!vert) {
     ui->mygl->clearSelectionMode();
     return;
@@ -208,24 +413,22 @@ void MainWindow::slot_setSelectedVertex(QListWidgetItem *vert) {
   // in case it's called from MyGL shortcuts
   updateSelectedVertex(vert);
 
-  Vertex *vertex = static_cast<Vertex *>(vert);
-  ui->mygl->setSelectedVertex(vertex);
+  ui->mygl->setSelectedVertex(vert);
   ui->mygl->update();
 
-  auto pos = vertex->getPos();
+  auto pos = vert->getPos();
   updateVertPosSpinBoxes(pos);
 }
 
-void MainWindow::slot_setSelectedFace(QListWidgetItem *fc) {
-  if (!fc) {
+void MainWindow::slot_setSelectedFace(Face *face) {
+  if (!face) {
     ui->mygl->clearSelectionMode();
     return;
   }
 
   // in case it's called from MyGL shortcuts
-  updateSelectedFace(fc);
+  updateSelectedFace(face);
 
-  Face *face = static_cast<Face *>(fc);
   ui->mygl->setSelectedFace(face);
   ui->mygl->update();
 
@@ -233,16 +436,15 @@ void MainWindow::slot_setSelectedFace(QListWidgetItem *fc) {
   updateFaceColorSpinBoxes(color);
 }
 
-void MainWindow::slot_setSelectedEdge(QListWidgetItem *e) {
-  if (!e) {
+void MainWindow::slot_setSelectedEdge(HalfEdge *edge) {
+  if (!edge) {
     ui->mygl->clearSelectionMode();
     return;
   }
 
   // in case it's called from MyGL shortcuts
-  updateSelectedEdge(e);
+  updateSelectedEdge(edge);
 
-  HalfEdge *edge = static_cast<HalfEdge *>(e);
   ui->mygl->setSelectedEdge(edge);
   ui->mygl->update();
 }
@@ -253,6 +455,9 @@ void MainWindow::slot_setSelectedJoint(QTreeWidgetItem *j) {
     return;
   }
 
+  // in case it was picked in the viewport
+  ui->jointsTreeWidget->setCurrentItem(j);
+
   Joint *joint = static_cast<Joint *>(j);
   ui->mygl->setSelectedJoint(joint);
   ui->mygl->update();
@@ -282,20 +487,39 @@ void MainWindow::updateFaceColorSpinBoxes(glm::vec3 color) {
   ui->faceBlueSpinBox->blockSignals(false);
 }
 
-void MainWindow::updateSelectedVertex(QListWidgetItem *vert) {
-  ui->vertsListWidget->blockSignals(true);
-  ui->vertsListWidget->setCurrentItem(vert);
-  ui->vertsListWidget->blockSignals(false);
+// Makes row current in view and scrolls to it. Only clicks select elements,
+// so this does not select it again.
+static void showRow(QListView *view, int row) {
+  QModelIndex index = view->model()->index(row, 0);
+  view->setCurrentIndex(index);
+  view->scrollTo(index);
+}
+
+void MainWindow::updateSelectedVertex(Vertex *vert) {
+  showRow(ui->vertsListView, vert->getIndex());
+}
+
+void MainWindow::updateSelectedFace(Face *face) {
+  showRow(ui->facesListView, face->getIndex());
 }
 
-void MainWindow::updateSelectedFace(QListWidgetItem *face) {
-  ui->facesListWidget->blockSignals(true);
-  ui->facesListWidget->setCurrentItem(face);
-  ui->facesListWidget->blockSignals(false);
+void MainWindow::updateSelectedEdge(HalfEdge *edge) {
+  showRow(ui->halfEdgesListView, edge->getIndex());
 }
 
-void MainWindow::updateSelectedEdge(QListWidgetItem *edge) {
-  ui->halfEdgesListWidget->blockSignals(true);
-  ui->halfEdgesListWidget->setCurrentItem(edge);
-  ui->halfEdgesListWidget->blockSignals(false);
+void MainWindow::setUpElementList(QListView *view, QLineEdit *search,
+                                  MeshListModel *model,
+                                  const std::function<void(int row)> &select) {
+  view->setModel(model);
+  connect(view, &QListView::clicked, this,
+          [select](const QModelIndex &index) { select(index.row()); });
+  connect(search, &QLineEdit::textEdited, this,
+          [model, select](const QString &text) {
+            bool ok;
+            int id = text.toInt(&ok);
+            int row = ok ? model->findId(id) : -1;
+            if (row >= 0) {
+              select(row);
+            }
+          });
 }
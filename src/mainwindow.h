@@ -3,10 +3,15 @@
 #include "meshdata/face.h"
 #include "meshdata/halfedge.h"
 #include "meshdata/vertex.h"
+#include "meshlistmodel.h"
 #include "skeletondata/joint.h"
 
+#include <QLineEdit>
+#include <QListView>
 #include <QMainWindow>
 
+#include <functional>
+
 namespace Ui {
 class MainWindow;
 }
@@ -24,29 +29,48 @@ private slots:
   void on_actionCamera_Controls_triggered();
 
   void slot_loadObj();
+  void slot_loadBlendShape();
   void slot_loadSkeleton();
   void slot_exportUSD();
+  void slot_exportBakedUSD();
   void slot_verifyUSDAsset();
+  void slot_savePerformanceTrace();
 
   // UI management called from MyGL
   void slot_clearUI();
-  void slot_addVertex(Vertex *vert);
-  void slot_addFace(Face *face);
-  void slot_addEdge(HalfEdge *edge);
+  void slot_showMesh(Mesh *mesh);
   void slot_setJoint(Joint *joint);
+  void slot_showHistory(const QString &summary);
+  void slot_exportFinished(const QString &filePath, bool success);
+  void slot_showBakeProgress(int writtenFrames, int totalFrames);
+  void slot_showBindProgress(int solvedJoints, int totalJoints);
+  void slot_bindFinished(bool applied);
+  void slot_showFrame(int frame);
+  void slot_addBlendShape(const QString &name);
+  void slot_showBlendShapeWeight(int target);
 
-  void slot_setSelectedVertex(QListWidgetItem *vert);
-  void slot_setSelectedFace(QListWidgetItem *face);
-  void slot_setSelectedEdge(QListWidgetItem *edge);
+  void slot_setSelectedVertex(Vertex *vert);
+  void slot_setSelectedFace(Face *face);
+  void slot_setSelectedEdge(HalfEdge *edge);
   void slot_setSelectedJoint(QTreeWidgetItem *joint);
 
 private:
   Ui::MainWindow *ui;
+  // Back the element lists, reading the mesh as rows are shown
+  MeshListModel *vertsModel;
+  MeshListModel *halfEdgesModel;
+  MeshListModel *facesModel;
+
+  // Shows model in view, and calls select with the row clicked there or the
+  // row of the id typed into search
+  void setUpElementList(QListView *view, QLineEdit *search,
+                        MeshListModel *model,
+                        const std::function<void(int row)> &select);
 
   void updateVertPosSpinBoxes(glm::vec3 pos);
   void updateFaceColorSpinBoxes(glm::vec3 color);
 
-  void updateSelectedVertex(QListWidgetItem *vert);
-  void updateSelectedFace(QListWidgetItem *face);
-  void updateSelectedEdge(QListWidgetItem *edge);
+  void updateSelectedVertex(Vertex *vert);
+  void updateSelectedFace(Face *face);
+  void updateSelectedEdge(HalfEdge *edge);
 };
@@ -4,13 +4,11 @@
 
 int Face::nextId = 0;
 
-Face::Face() : color(utils::getRandomColor()), id(nextId++) {
-  setText(QString::number(id));
-}
+Face::Face()
+    : edge(nullptr), color(utils::getRandomColor()), id(nextId++), index(-1) {}
 
-Face::Face(glm::vec3 &color) : color(color), id(nextId++) {
-  setText(QString::number(id));
-}
+Face::Face(glm::vec3 &color)
+    : edge(nullptr), color(color), id(nextId++), index(-1) {}
 
 Face::~Face() {}
 
@@ -18,6 +16,10 @@ glm::vec3 Face::getColor() const { return color; }
 
 HalfEdge *Face::getEdge() const { return edge; }
 
+int Face::getId() const { return id; }
+
+int Face::getIndex() const { return index; }
+
 int Face::getEdgeCount() const {
   HalfEdge *e = edge;
   int count = 0;
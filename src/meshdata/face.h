@@ -2,12 +2,11 @@
 
 #include "halfedge.h"
 
-#include <QListWidget>
 #include <glm/glm.hpp>
 
 class HalfEdge;
 
-class Face : public QListWidgetItem {
+class Face {
 public:
   Face();                 // Constructs a face with a random color.
   Face(glm::vec3 &color); // Constructs a face with the specified color.
@@ -16,6 +15,8 @@ public:
   glm::vec3 getColor() const;
   HalfEdge *getEdge() const;
   int getEdgeCount() const;
+  int getId() const;    // Shown in the face list
+  int getIndex() const; // Position in its Mesh's faces vector
 
   void setColor(glm::vec3 col);
 
@@ -23,6 +24,7 @@ private:
   HalfEdge *edge;  // One half-edge associated with this face
   glm::vec3 color; // This face's RGB color
   const int id;    // Unique face id
+  int index;       // Position of this face in its Mesh's faces vector
 
   static int nextId; // The next id to use
 
@@ -2,7 +2,9 @@
 
 int HalfEdge::nextId = 0;
 
-HalfEdge::HalfEdge() : id(nextId++) { setText(QString::number(id)); }
+HalfEdge::HalfEdge()
+    : nextEdge(nullptr), sym(nullptr), face(nullptr), nextVert(nullptr),
+      id(nextId++), index(-1) {}
 
 HalfEdge::~HalfEdge() {}
 
@@ -17,3 +19,7 @@ HalfEdge *HalfEdge::getSymEdge() const { return sym; }
 Face *HalfEdge::getFace() const { return face; }
 
 Vertex *HalfEdge::getNextVert() const { return nextVert; }
+
+int HalfEdge::getId() const { return id; }
+
+int HalfEdge::getIndex() const { return index; }
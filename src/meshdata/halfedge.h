@@ -3,12 +3,10 @@
 #include "face.h"
 #include "vertex.h"
 
-#include <QListWidget>
-
 class Vertex;
 class Face;
 
-class HalfEdge : public QListWidgetItem {
+class HalfEdge {
 public:
   HalfEdge();
   virtual ~HalfEdge();
@@ -19,6 +17,8 @@ public:
   HalfEdge *getSymEdge() const;
   Face *getFace() const;
   Vertex *getNextVert() const;
+  int getId() const;    // Shown in the half-edge list
+  int getIndex() const; // Position in its Mesh's edges vector
 
 private:
   HalfEdge *nextEdge; // The next half-edge in this loop
@@ -26,6 +26,7 @@ private:
   Face *face;         // The face this half-edge belongs to
   Vertex *nextVert;   // The vertex this points to
   const int id;       // Unique HalfEdge id
+  int index;          // Position of this half-edge in its Mesh's edges vector
 
   static int nextId; // The next id to use
 
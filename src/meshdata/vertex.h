@@ -2,39 +2,39 @@
 
 #include "halfedge.h"
 #include "skeletondata/joint.h"
+#include "skeletondata/skinning.h"
 
-#include <QListWidget>
 #include <glm/glm.hpp>
 
 class HalfEdge;
 
-class Vertex : public QListWidgetItem {
+class Vertex {
 public:
   Vertex(glm::vec3 pos);
   virtual ~Vertex();
 
   glm::vec3 getPos() const;
   HalfEdge *getEdge() const;
+  int getId() const;    // Shown in the vertex list
+  int getIndex() const; // Position in its Mesh's verts vector
 
   void setPos(glm::vec3 p);
 
-  // automatically assign weights by distance
-  void assignWeights(std::vector<Joint *> &joints);
+  void setWeights(const SkinInfluence &weights);
   void clearWeights();
+  const SkinInfluence &getInfluence() const;
 
 private:
   // half-edge mesh data
   glm::vec3 pos;  // This vertex's position
   HalfEdge *edge; // Pointer to a half-edge which points to this vertex
   const int id;   // Unique vertex id
+  int index;      // Position of this vertex in its Mesh's verts vector
 
   // joint weight
-  int joint1Idx, joint2Idx;
-  float joint1Weight, joint2Weight;
+  SkinInfluence influence;
 
   static int nextId; // The next id to use
 
-  void setWeights(int j1i, int j2i, float j1w, float j2w);
-
   friend class Mesh;
 };
@@ -0,0 +1,92 @@
+#include "meshlistmodel.h"
+
+MeshListModel::MeshListModel(Kind kind, QObject *parent)
+    : QAbstractListModel(parent), kind(kind), mesh(nullptr), rows(0) {}
+
+void MeshListModel::setMesh(Mesh *m) {
+  if (m != mesh) {
+    beginResetModel();
+    mesh = m;
+    rows = elementCount();
+    endResetModel();
+    return;
+  }
+
+  int count = elementCount();
+  if (count > rows) {
+    beginInsertRows(QModelIndex(), rows, count - 1);
+    rows = count;
+    endInsertRows();
+  } else if (count < rows) {
+    beginRemoveRows(QModelIndex(), count, rows - 1);
+    rows = count;
+    endRemoveRows();
+  }
+}
+
+int MeshListModel::rowCount(const QModelIndex &parent) const {
+  return parent.isValid() ? 0 : rows;
+}
+
+QVariant MeshListModel::data(const QModelIndex &index, int role) const {
+  if (role != Qt::DisplayRole || !index.isValid()) {
+    return QVariant();
+  }
+  int id = idAt(index.row());
+  return id < 0 ? QVariant() : QVariant(QString::number(id));
+}
+
+int MeshListModel::findId(int id) const {
+  for (int row = 0; row < rows; ++row) {
+    if (idAt(row) == id) {
+      return row;
+    }
+  }
+  return -1;
+}
+
+Vertex *MeshListModel::getVertex(int row) const {
+  bool valid = kind == VERTICES && row >= 0 && row < elementCount();
+  return valid ? mesh->verts[row].get() : nullptr;
+}
+
+HalfEdge *MeshListModel::getEdge(int row) const {
+  bool valid = kind == HALF_EDGES && row >= 0 && row < elementCount();
+  return valid ? mesh->edges[row].get() : nullptr;
+}
+
+Face *MeshListModel::getFace(int row) const {
+  bool valid = kind == FACES && row >= 0 && row < elementCount();
+  return valid ? mesh->faces[row].get() : nullptr;
+}
+
+int MeshListModel::elementCount() const {
+  if (!mesh) {
+    return 0;
+  }
+  switch (kind) {
+  case VERTICES:
+    return mesh->verts.size();
+  case HALF_EDGES:
+    return mesh->edges.size();
+  case FACES:
+    return mesh->faces.size();
+  }
+  return 0;
+}
+
+int MeshListModel::idAt(int row) const {
+  // the mesh may have shrunk before the views were told
+  if (row < 0 || row >= elementCount()) {
+    return -1;
+  }
+  switch (kind) {
+  case VERTICES:
+    return mesh->verts[row]->getId();
+  case HALF_EDGES:
+    return mesh->edges[row]->getId();
+  case FACES:
+    return mesh->faces[row]->getId();
+  }
+  return -1;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "scene/mesh.h"
+
+#include <QAbstractListModel>
+
+/**
+ * The vertices, half-edges or faces of a Mesh, listed by id.
+ *
+ * Rows are read from the mesh's vectors only when a view asks for them, so a
+ * list view with uniform item sizes touches just the rows on screen however
+ * big the mesh is. Edits only ever append elements to those vectors or, when
+ * undone, take them off the back, so setMesh() turns any edit into a single
+ * range insert or removal; only a different mesh resets the model.
+ */
+class MeshListModel : public QAbstractListModel {
+  Q_OBJECT
+
+public:
+  enum Kind { VERTICES, HALF_EDGES, FACES };
+
+  explicit MeshListModel(Kind kind, QObject *parent = nullptr);
+
+  // Lists the elements of mesh, which may be null, catching up with the
+  // elements added or removed since the last call if it is the same mesh
+  void setMesh(Mesh *mesh);
+
+  int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+  QVariant data(const QModelIndex &index,
+                int role = Qt::DisplayRole) const override;
+
+  // The row of the element with the given id, or -1. Scans every row.
+  int findId(int id) const;
+
+  // The element in a row, or null if the row is out of range or the model
+  // lists another kind
+  Vertex *getVertex(int row) const;
+  HalfEdge *getEdge(int row) const;
+  Face *getFace(int row) const;
+
+private:
+  Kind kind;
+  Mesh *mesh;
+  int rows; // Elements the views were told about
+
+  int elementCount() const; // In the mesh, which may be more or fewer
+  int idAt(int row) const;
+};
@@ -1,33 +1,60 @@
 #include "mygl.h"
 #include "glm/fwd.hpp"
 
+#include "frameprofile.h"
+#include "startupprofile.h"
+
 #include <la.h>
 
 #include <QApplication>
 #include <QKeyEvent>
+#include <QPainter>
+#include <QThreadPool>
 #include <pxr/usd/usd/stage.h>
 
+#include <algorithm>
+#include <cmath>
 #include <filesystem>
 #include <string>
 
 MyGL::MyGL(QWidget *parent)
     : OpenGLContext(parent), m_mesh(nullptr), m_rootJoint(nullptr),
-      m_wireVert(this), m_wireFace(this), m_wireEdge(this), m_progLambert(this),
-      m_progFlat(this), m_progSkeleton(this), m_glCamera(),
-      m_lastMousePos(0, 0), selectMode(SelectionMode::NONE) {
+      m_jointPalette(this), m_jointGizmo(this), m_overlay(this),
+      m_progLambert(this), m_progGizmo(this), m_progSkeleton(this),
+      m_progOverlay(this), m_progOverlaySkinned(this), m_progPickFace(this),
+      m_progPickFaceSkinned(this), m_progPickJoint(this), m_shaderCache(this),
+      m_cpuSkinning(false), m_skinningMode(SkinningMode::LINEAR),
+      m_influenceCount(4), m_heatWeights(false), m_bindGeneration(0),
+      m_animation(), m_frame(0), m_playbackTimer(), m_playbackClock(),
+      m_playbackStartFrame(0), m_poseDirty(false), m_meshDirty(false),
+      m_pendingEdits(0), m_lastFrameEdits(0), m_lastFrameRebuilds(0),
+      m_ikHandles(), m_ikEnabled(false), m_ikMethod(IkMethod::CCD),
+      m_ikChainLength(3), m_showHud(false), m_showWireframe(false),
+      m_glCamera(), m_lastMousePos(0, 0), m_pressPos(0, 0),
+      m_pickBuffer(this), m_pickPixel(), m_pickLayout(-1), m_pickVertCount(0),
+      selectMode(SelectionMode::NONE) {
   setFocusPolicy(Qt::StrongFocus);
   setMouseTracking(true);
+
+  m_playbackTimer.setTimerType(Qt::PreciseTimer);
+  m_playbackTimer.setSingleShot(true);
+  connect(&m_playbackTimer, &QTimer::timeout, this, &MyGL::advancePlayback);
 }
 
 MyGL::~MyGL() {
+  // background exports report back to us, so let them finish first
+  QThreadPool::globalInstance()->waitForDone();
+
   makeCurrent();
-  glDeleteVertexArrays(1, &vao);
   if (m_mesh) {
     m_mesh->destroy();
   }
-  m_wireVert.destroy();
-  m_wireFace.destroy();
-  m_wireEdge.destroy();
+  m_overlay.destroy();
+  m_jointPalette.destroy();
+  m_jointGizmo.destroy();
+  m_pickBuffer.destroy();
+  gpuTimers().destroy();
+  doneCurrent();
 }
 
 void MyGL::initializeGL() {
@@ -35,11 +62,16 @@ void MyGL::initializeGL() {
   // If you were programming in a non-Qt context you might use GLEW (GL
   // Extension Wrangler)instead
   initializeOpenGLFunctions();
+  // a new context starts with nothing bound
+  glState().invalidate();
   // Print out some information about the current OpenGL context
   debugContextVersion();
+  m_shaderCache.initialize();
+  gpuTimers().initialize();
+  startupprofile::mark("OpenGL context");
 
   // Set a few settings/modes in OpenGL rendering
-  glEnable(GL_DEPTH_TEST);
+  glState().setEnabled(GL_DEPTH_TEST, true);
   glEnable(GL_LINE_SMOOTH);
   glEnable(GL_POLYGON_SMOOTH);
   glHint(GL_LINE_SMOOTH_HINT, GL_NICEST);
@@ -52,20 +84,60 @@ void MyGL::initializeGL() {
 
   printGLErrorLog();
 
-  // Create a Vertex Attribute Object
-  glGenVertexArrays(1, &vao);
-
   // Create and set up the diffuse shader
-  m_progLambert.create(":/glsl/lambert.vert.glsl", ":/glsl/lambert.frag.glsl");
-  // Create and set up the flat lighting shader
-  m_progFlat.create(":/glsl/flat.vert.glsl", ":/glsl/flat.frag.glsl");
+  m_progLambert.create(":/glsl/lambert.vert.glsl", ":/glsl/lambert.frag.glsl",
+                       &m_shaderCache);
+  // Create the joint gizmo shader, which reads each joint's transform and
+  // parent from the texture buffers on units 4 and 5
+  m_progGizmo.create(":/glsl/gizmo.vert.glsl", ":/glsl/flat.frag.glsl",
+                     &m_shaderCache);
+  m_progGizmo.setGizmoUnits(4, 5);
   // Create and set up the skeleton shader
   m_progSkeleton.create(":/glsl/skeleton.vert.glsl",
-                        ":/glsl/skeleton.frag.glsl");
+                        ":/glsl/skeleton.frag.glsl", &m_shaderCache);
+  // The joint palette is always bound to texture units 0 and 1
+  m_progSkeleton.setJointPalette(0, 1);
+  m_progSkeleton.setSkinningMode(m_skinningMode);
+  // Create the overlay shaders, which run after either vertex shader above.
+  // The slot table and selection flags are bound to units 2 and 3.
+  m_progOverlay.create(":/glsl/lambert.vert.glsl", ":/glsl/overlay.geom.glsl",
+                       ":/glsl/overlay.frag.glsl", &m_shaderCache);
+  m_progOverlaySkinned.create(":/glsl/skeleton.vert.glsl",
+                              ":/glsl/overlay.geom.glsl",
+                              ":/glsl/overlay.frag.glsl", &m_shaderCache);
+  m_progOverlaySkinned.setJointPalette(0, 1);
+  m_progOverlaySkinned.setSkinningMode(m_skinningMode);
+  for (ShaderProgram *prog : {&m_progOverlay, &m_progOverlaySkinned}) {
+    prog->setOverlayUnits(2, 3);
+  }
+  // The pick pass reads the same slot table to find faces, and the same
+  // joint buffers to draw gizmos
+  m_progPickFace.create(":/glsl/lambert.vert.glsl",
+                        ":/glsl/pickface.frag.glsl", &m_shaderCache);
+  m_progPickFaceSkinned.create(":/glsl/skeleton.vert.glsl",
+                               ":/glsl/pickface.frag.glsl", &m_shaderCache);
+  m_progPickFaceSkinned.setJointPalette(0, 1);
+  m_progPickFaceSkinned.setSkinningMode(m_skinningMode);
+  for (ShaderProgram *prog : {&m_progPickFace, &m_progPickFaceSkinned}) {
+    prog->setOverlayUnits(2, 3);
+  }
+  m_progPickJoint.create(":/glsl/gizmo.vert.glsl",
+                         ":/glsl/pickjoint.frag.glsl", &m_shaderCache);
+  m_progPickJoint.setGizmoUnits(4, 5);
+  // Meshes with at most four influences per vertex leave the second joint
+  // set disabled, so it must read as zero weights rather than the default
+  // (0, 0, 0, 1)
+  glVertexAttrib4f(ATTR_JOINT_WGT1, 0, 0, 0, 0);
+
+  // Fall back to skinning on the CPU if the skeleton shader is unusable, or
+  // if asked to (handy for comparing the two paths)
+  m_cpuSkinning = !m_progSkeleton.isLinked() ||
+                  qEnvironmentVariableIsSet("MICROMAYA_CPU_SKINNING");
+  if (m_cpuSkinning) {
+    printf("Skinning on the CPU (%s)\n", skinning::simdPath());
+  }
 
-  // We have to have a VAO bound in OpenGL 3.2 Core. But if we're not
-  // using multiple VAOs, we can just bind one once.
-  glBindVertexArray(vao);
+  // Each Drawable creates and binds its own VAO, so none is bound here
 }
 
 void MyGL::resizeGL(int w, int h) {
@@ -78,8 +150,10 @@ void MyGL::resizeGL(int w, int h) {
   // card)
 
   m_progLambert.setViewProjMatrix(viewproj);
-  m_progFlat.setViewProjMatrix(viewproj);
+  m_progGizmo.setViewProjMatrix(viewproj);
   m_progSkeleton.setViewProjMatrix(viewproj);
+  m_progOverlay.setViewProjMatrix(viewproj);
+  m_progOverlaySkinned.setViewProjMatrix(viewproj);
 
   printGLErrorLog();
 }
@@ -88,89 +162,199 @@ void MyGL::resizeGL(int w, int h) {
 // For example, when the function update() is called, paintGL is called
 // implicitly.
 void MyGL::paintGL() {
+  frameprofile::Scope profile("MyGL::paintGL");
+  glState().beginFrame();
+  gpuTimers().beginFrame();
+
   // Clear the screen so that we only see newly drawn images
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-  m_progFlat.setViewProjMatrix(m_glCamera.getViewProj());
-  m_progLambert.setViewProjMatrix(m_glCamera.getViewProj());
+  glState().countIssued();
+  // the HUD's painting may have turned it off
+  glState().setEnabled(GL_DEPTH_TEST, true);
+
+  syncPose();
+  syncMesh();
+  takePick();
+
+  // uniforms only reach the GPU when the camera has actually moved
+  glm::mat4 viewProj = m_glCamera.getViewProj();
+  m_progGizmo.setViewProjMatrix(viewProj);
+  m_progLambert.setViewProjMatrix(viewProj);
   m_progLambert.setCamPos(m_glCamera.eye);
-  m_progSkeleton.setViewProjMatrix(m_glCamera.getViewProj());
+  m_progSkeleton.setViewProjMatrix(viewProj);
   m_progSkeleton.setCamPos(m_glCamera.eye);
-  m_progFlat.setModelMatrix(glm::mat4(1.f));
+  m_progOverlay.setViewProjMatrix(viewProj);
+  m_progOverlaySkinned.setViewProjMatrix(viewProj);
+  m_progGizmo.setModelMatrix(glm::mat4(1.f));
   m_progLambert.setModelMatrix(glm::mat4(1.f));
   m_progSkeleton.setModelMatrix(glm::mat4(1.f));
+  m_progOverlay.setModelMatrix(glm::mat4(1.f));
+  m_progOverlaySkinned.setModelMatrix(glm::mat4(1.f));
 
   if (m_mesh) {
-    if (m_mesh->isBound()) {
-      m_progSkeleton.draw(*m_mesh);
+    // chunks outside the view are skipped; the palette bounds the chunks of
+    // a mesh skinned linearly on the GPU
+    m_mesh->cull(viewProj, &m_jointPalette.getMatrices(), m_skinningMode);
+    if (m_mesh->isBound() && !m_cpuSkinning) {
+      m_jointPalette.bind(0, 1);
+      m_progSkeleton.draw(*m_mesh, "Skinned mesh");
     } else {
-      m_progLambert.draw(*m_mesh);
+      m_progLambert.draw(*m_mesh, "Mesh");
+    }
+
+    bool meshSelection = selectMode == SelectionMode::VERTEX ||
+                         selectMode == SelectionMode::FACE ||
+                         selectMode == SelectionMode::EDGE;
+    if (m_showWireframe || meshSelection) {
+      drawOverlay();
     }
   }
 
   // selection visualization
-  glDisable(GL_DEPTH_TEST);
+  glState().setEnabled(GL_DEPTH_TEST, false);
 
   if (m_rootJoint) {
-    m_progFlat.draw(*m_rootJoint);
+    m_jointGizmo.bind(4, 5);
+    m_progGizmo.draw(m_jointGizmo, "Skeleton");
   }
 
-  m_progFlat.setModelMatrix(glm::mat4(1));
-  switch (selectMode) {
-  case SelectionMode::VERTEX:
-    m_progFlat.draw(m_wireVert);
-    break;
-  case SelectionMode::FACE:
-    m_progFlat.draw(m_wireFace);
-    break;
-  case SelectionMode::EDGE:
-    m_progFlat.draw(m_wireEdge);
-    break;
-  default:
-    // selection mode NONE or JOINT
-    break;
+  glState().setEnabled(GL_DEPTH_TEST, true);
+  if (m_pickPixel) {
+    drawPick();
   }
+  glState().endFrame();
 
-  glEnable(GL_DEPTH_TEST);
+  if (m_showHud) {
+    drawHud();
+  }
+
+  if (startupprofile::isEnabled()) {
+    // wait for the driver, which may defer work until the first draw
+    glFinish();
+    startupprofile::mark("First frame");
+    startupprofile::report();
+  }
 }
 
 void MyGL::loadObj(QFile &file) {
   clearSelectionMode();
+  ++m_bindGeneration; // drops any heat weights still being computed
 
   if (m_mesh) {
     m_mesh->destroy();
   }
 
   m_mesh = mkU<Mesh>(this, file);
-  m_mesh->create();
+  markMeshDirty();
 
   // clear and initialize ui
   emit signal_clearUI();
-  populateUI();
+  emit signal_meshChanged(m_mesh.get());
+  emitHistoryChanged();
 
   update();
 }
 
-void MyGL::loadSkeleton(const QJsonDocument &doc) {
+bool MyGL::loadBlendShape(QFile &file, const QString &name, QString *error) {
+  if (!m_mesh) {
+    *error = "A mesh must be loaded first.";
+    return false;
+  }
+  if (!m_mesh->addBlendShape(file, name.toStdString(), error)) {
+    return false;
+  }
+
+  emit signal_addBlendShape(name);
+  return true;
+}
+
+bool MyGL::loadSkeleton(const QByteArray &json, QString *error) {
+  skeletonjson::Result result = skeletonjson::parse(json.data(), json.size());
+  if (!result.skeleton) {
+    *error = QString::fromStdString(result.error);
+    return false;
+  }
+
+  ++m_bindGeneration;
   if (m_mesh) {
     m_mesh->unbindSkeleton();
+    markMeshDirty();
+  }
+  m_jointPalette.destroy();
+  // keys refer to joint ids of the old skeleton
+  m_animation.clear();
+  m_ikHandles.clear();
+  m_poseDirty = false;
+  if (selectMode == SelectionMode::JOINT) {
+    clearSelectionMode();
   }
 
-  m_rootJoint = mkU<Joint>(this, doc.object()["root"].toObject());
-  m_rootJoint->create();
+  m_rootJoint = mkU<Joint>(std::move(result.skeleton), result.names);
+  m_jointGizmo.setSkeleton(m_rootJoint->getSkeleton());
 
   emit signal_setJoint(m_rootJoint.get());
+  return true;
 }
 
-void MyGL::exportUSD(const QString &filePath) const {
-  auto path = std::filesystem::path(filePath.toStdString());
-  auto stage = pxr::UsdStage::CreateNew(path.c_str());
+void MyGL::exportUSD(const QString &filePath) {
+  // take a consistent copy of the mesh here; the export itself runs on the
+  // thread pool so the user can keep editing in the meantime
+  MeshSnapshot snapshot = m_mesh->snapshot();
+  // a bound mesh is exported in its current pose, which may not have been
+  // drawn yet
+  std::vector<glm::mat4> palette;
+  if (snapshot.isBound()) {
+    makeCurrent();
+    syncPose();
+    doneCurrent();
+    palette = m_jointPalette.getMatrices();
+  }
+  SkinningMode mode = m_skinningMode;
+
+  QThreadPool::globalInstance()->start([this, snapshot, palette, mode,
+                                        filePath] {
+    auto path = std::filesystem::path(filePath.toStdString());
+    auto stage = pxr::UsdStage::CreateNew(path.string());
+
+    if (stage) {
+      auto meshPath = "/" + path.replace_extension("").filename().string();
+      auto mesh =
+          snapshot.posed(palette, mode).createUsdMesh(stage, meshPath.c_str());
 
-  auto meshPath = "/" + path.replace_extension("").filename().string();
-  auto mesh = m_mesh->createUsdMesh(stage, meshPath.c_str());
+      stage->SetDefaultPrim(mesh.GetPrim());
+      stage->Save();
+    }
 
-  stage->SetDefaultPrim(mesh.GetPrim());
-  stage->Save();
+    bool success = !!stage;
+    QMetaObject::invokeMethod(
+        this, [=] { emit signal_exportFinished(filePath, success); },
+        Qt::QueuedConnection);
+  });
+}
+
+void MyGL::exportBakedUSD(const QString &filePath, int firstFrame,
+                          int lastFrame, bool normals) {
+  // the bake poses its own copies of the skeleton and animation
+  MeshSnapshot snapshot = m_mesh->snapshot();
+  Skeleton skeleton = m_rootJoint->getSkeleton();
+  Animation animation = m_animation;
+  pointcache::Settings settings = {firstFrame, lastFrame,
+                                   m_animation.getFramesPerSecond(),
+                                   m_skinningMode, normals};
+
+  QThreadPool::globalInstance()->start([=] {
+    bool success = pointcache::write(
+        filePath.toStdString(), snapshot, skeleton, animation, settings,
+        [this](int written, int total) {
+          QMetaObject::invokeMethod(
+              this, [=] { emit signal_bakeProgress(written, total); },
+              Qt::QueuedConnection);
+        });
+
+    QMetaObject::invokeMethod(
+        this, [=] { emit signal_exportFinished(filePath, success); },
+        Qt::QueuedConnection);
+  });
 }
 
 void MyGL::bindMesh() {
@@ -179,18 +363,77 @@ void MyGL::bindMesh() {
   }
 
   // generate bind matrices
-  m_rootJoint->generateBindMatrices(glm::mat4(1));
-
-  // get get bind matrices and give to shaders
-  std::array<glm::mat4, 100> bindMats, jointTransforms;
-  m_rootJoint->getBindMatrices(bindMats);
-  m_rootJoint->getJointTransforms(jointTransforms);
+  m_rootJoint->getSkeleton().generateBindMatrices();
 
-  m_progSkeleton.setBindMats(bindMats);
-  m_progSkeleton.setJointTfms(jointTransforms);
+  // combine joint transforms with bind matrices for the skeleton shader
+  m_jointPalette.create(m_rootJoint->getSkeleton());
 
   // assign vertex weights
-  m_mesh->bindSkeleton(m_rootJoint.get());
+  m_mesh->setCpuPose(m_cpuSkinning ? &m_jointPalette.getMatrices() : nullptr,
+                     m_skinningMode);
+  ++m_bindGeneration;
+  if (m_heatWeights) {
+    bindMeshHeat();
+  } else {
+    m_mesh->bindSkeleton(m_rootJoint.get(), m_influenceCount);
+    markMeshDirty();
+    update();
+  }
+}
+
+void MyGL::bindMeshHeat() {
+  // the solve runs on the thread pool from copies of the rest mesh and the
+  // skeleton, and its result is dropped if either is replaced or rebound in
+  // the meantime
+  MeshSnapshot snapshot = m_mesh->snapshot();
+  Skeleton skeleton = m_rootJoint->getSkeleton();
+  int influenceCount = m_influenceCount;
+  uint64_t generation = m_bindGeneration;
+
+  QThreadPool::globalInstance()->start([=]() mutable {
+    std::vector<glm::vec3> positions(snapshot.getVertexCount());
+    for (size_t i = 0; i < positions.size(); ++i) {
+      positions[i] = snapshot.getPoint(i);
+    }
+    // the solves start from the current binding, if any; loading another
+    // skeleton unbinds the mesh, so it is always to this one
+    std::vector<SkinInfluence> guess;
+    if (snapshot.isBound()) {
+      guess.resize(positions.size());
+      for (size_t i = 0; i < guess.size(); ++i) {
+        guess[i] = snapshot.getInfluence(i);
+      }
+    }
+    std::vector<glm::ivec3> triangles;
+    snapshot.forEachFace([&](int, const int *indices, int count) {
+      for (int i = 1; i + 1 < count; ++i) {
+        triangles.push_back(
+            glm::ivec3(indices[0], indices[i], indices[i + 1]));
+      }
+    });
+
+    auto weights = heatweights::compute(
+        skeleton, positions, triangles, influenceCount, guess,
+        [this](int solved, int total) {
+          QMetaObject::invokeMethod(
+              this, [=] { emit signal_bindProgress(solved, total); },
+              Qt::QueuedConnection);
+        });
+
+    QMetaObject::invokeMethod(
+        this,
+        [this, weights, generation] {
+          bool current = generation == m_bindGeneration && m_mesh &&
+                         m_rootJoint && weights.size() == m_mesh->verts.size();
+          if (current) {
+            m_mesh->bindSkeleton(m_rootJoint.get(), weights);
+            markMeshDirty();
+            update();
+          }
+          emit signal_bindFinished(current);
+        },
+        Qt::QueuedConnection);
+  });
 }
 
 void MyGL::clearSelectionMode() {
@@ -198,9 +441,9 @@ void MyGL::clearSelectionMode() {
   selectedVert = nullptr;
   selectedEdge = nullptr;
   selectedFace = nullptr;
-  m_wireVert.setVertex(nullptr);
-  m_wireFace.setFace(nullptr);
-  m_wireEdge.setEdge(nullptr);
+  selectedJoint = nullptr;
+  m_overlay.setSelection(nullptr, nullptr, nullptr);
+  m_jointGizmo.setSelected(-1);
 }
 
 void MyGL::setSelectedVertex(Vertex *vert) {
@@ -208,8 +451,7 @@ void MyGL::setSelectedVertex(Vertex *vert) {
   selectMode = SelectionMode::VERTEX;
 
   selectedVert = vert;
-  m_wireVert.setVertex(vert);
-  m_wireVert.create();
+  m_overlay.setSelection(vert, nullptr, nullptr);
 }
 
 void MyGL::setSelectedFace(Face *face) {
@@ -217,8 +459,7 @@ void MyGL::setSelectedFace(Face *face) {
   selectMode = SelectionMode::FACE;
 
   selectedFace = face;
-  m_wireFace.setFace(face);
-  m_wireFace.create();
+  m_overlay.setSelection(nullptr, nullptr, face);
 }
 
 void MyGL::setSelectedEdge(HalfEdge *edge) {
@@ -226,8 +467,7 @@ void MyGL::setSelectedEdge(HalfEdge *edge) {
   selectMode = SelectionMode::EDGE;
 
   selectedEdge = edge;
-  m_wireEdge.setEdge(edge);
-  m_wireEdge.create();
+  m_overlay.setSelection(nullptr, edge, nullptr);
 }
 
 void MyGL::setSelectedJoint(Joint *joint) {
@@ -235,7 +475,7 @@ void MyGL::setSelectedJoint(Joint *joint) {
   selectMode = SelectionMode::JOINT;
 
   selectedJoint = joint;
-  m_rootJoint->createWithSelected(selectedJoint);
+  m_jointGizmo.setSelected(joint ? joint->getId() : -1);
 }
 
 void MyGL::rotateJoint(float x, float y, float z) {
@@ -243,20 +483,24 @@ void MyGL::rotateJoint(float x, float y, float z) {
     return;
   }
 
-  // rotate joint and generate skeleton VBOs
+  // the joint gizmos and palette catch up when the frame is drawn
   selectedJoint->rotateLocal(x, y, z);
-  m_rootJoint->createWithSelected(selectedJoint);
-
-  // update skeleton shader's joint transforms array
-  std::array<glm::mat4, 100> jointTransforms;
-  m_rootJoint->getJointTransforms(jointTransforms, glm::mat4(1));
-  m_progSkeleton.setJointTfms(jointTransforms);
-
+  m_poseDirty = true;
   update();
 }
 
 bool MyGL::isMeshLoaded() const { return m_mesh != nullptr; }
 
+bool MyGL::isMeshBound() const {
+  return m_mesh && m_rootJoint && m_mesh->isBound();
+}
+
+const Animation &MyGL::getAnimation() const { return m_animation; }
+
+float MyGL::getBlendShapeWeight(int target) const {
+  return m_mesh ? m_mesh->getBlendShapes().getWeight(target) : 0;
+}
+
 void MyGL::keyPressEvent(QKeyEvent *e) {
   float amount = 2.0f;
   if (e->modifiers() & Qt::ShiftModifier) {
@@ -316,12 +560,33 @@ void MyGL::keyPressEvent(QKeyEvent *e) {
   update(); // Calls paintGL, among other things
 }
 
+void MyGL::mousePressEvent(QMouseEvent *e) {
+  m_pressPos = glm::ivec2(e->pos().x(), e->pos().y());
+}
+
+void MyGL::mouseReleaseEvent(QMouseEvent *e) {
+  glm::ivec2 pos(e->pos().x(), e->pos().y());
+  glm::ivec2 moved = glm::abs(pos - m_pressPos);
+  if (e->button() != Qt::LeftButton || std::max(moved.x, moved.y) > 2) {
+    return; // A drag, which moved the camera or an IK target
+  }
+
+  // picked when the next frame is drawn, in framebuffer pixels from the
+  // bottom left
+  float ratio = devicePixelRatio();
+  m_pickPixel = glm::ivec2(pos.x * ratio, (height() - 1 - pos.y) * ratio);
+  update();
+}
+
 void MyGL::mouseMoveEvent(QMouseEvent *e) {
   auto newPos = glm::ivec2(e->pos().x(), e->pos().y());
   glm::vec2 delta = newPos - m_lastMousePos;
   delta /= devicePixelRatio();
 
-  if (e->buttons().testFlag(Qt::LeftButton)) {
+  if (e->buttons().testFlag(Qt::LeftButton) &&
+      e->modifiers().testFlag(Qt::ControlModifier) && dragIkTarget(delta)) {
+    // the selected joint follows the cursor
+  } else if (e->buttons().testFlag(Qt::LeftButton)) {
     m_glCamera.RotateAboutUp(-delta.x * 0.5);
     m_glCamera.RotateAboutRight(-delta.y * 0.5);
     m_glCamera.RecomputeAttributes();
@@ -351,9 +616,10 @@ void MyGL::slot_setVertPosX(double x) {
   }
   glm::vec3 newPos = selectedVert->getPos();
   newPos.x = x;
-  selectedVert->setPos(newPos);
+  m_mesh->setVertexPos(selectedVert, newPos);
 
-  createMeshVBOs();
+  markMeshDirty();
+  emitHistoryChanged();
   update();
 }
 
@@ -363,9 +629,10 @@ void MyGL::slot_setVertPosY(double y) {
   }
   glm::vec3 newPos = selectedVert->getPos();
   newPos.y = y;
-  selectedVert->setPos(newPos);
+  m_mesh->setVertexPos(selectedVert, newPos);
 
-  createMeshVBOs();
+  markMeshDirty();
+  emitHistoryChanged();
   update();
 }
 
@@ -375,9 +642,10 @@ void MyGL::slot_setVertPosZ(double z) {
   }
   glm::vec3 newPos = selectedVert->getPos();
   newPos.z = z;
-  selectedVert->setPos(newPos);
+  m_mesh->setVertexPos(selectedVert, newPos);
 
-  createMeshVBOs();
+  markMeshDirty();
+  emitHistoryChanged();
   update();
 }
 
@@ -387,9 +655,10 @@ void MyGL::slot_setFaceRed(double r) {
   }
   glm::vec3 newCol = selectedFace->getColor();
   newCol.r = r;
-  selectedFace->setColor(newCol);
+  m_mesh->setFaceColor(selectedFace, newCol);
 
-  createMeshVBOs();
+  markMeshDirty();
+  emitHistoryChanged();
   update();
 }
 
@@ -399,9 +668,10 @@ void MyGL::slot_setFaceGreen(double g) {
   }
   glm::vec3 newCol = selectedFace->getColor();
   newCol.g = g;
-  selectedFace->setColor(newCol);
+  m_mesh->setFaceColor(selectedFace, newCol);
 
-  createMeshVBOs();
+  markMeshDirty();
+  emitHistoryChanged();
   update();
 }
 
@@ -411,9 +681,10 @@ void MyGL::slot_setFaceBlue(double b) {
   }
   glm::vec3 newCol = selectedFace->getColor();
   newCol.b = b;
-  selectedFace->setColor(newCol);
+  m_mesh->setFaceColor(selectedFace, newCol);
 
-  createMeshVBOs();
+  markMeshDirty();
+  emitHistoryChanged();
   update();
 }
 
@@ -424,8 +695,11 @@ void MyGL::slot_splitEdge() {
 
   Vertex *newVert = m_mesh->splitEdge(selectedEdge);
 
-  populateUI();
+  emit signal_meshChanged(m_mesh.get());
+  markMeshDirty();
+  emitHistoryChanged();
   emit signal_setSelectedVertex(newVert);
+  update();
 }
 
 void MyGL::slot_triangulateFace() {
@@ -435,10 +709,11 @@ void MyGL::slot_triangulateFace() {
 
   m_mesh->triangulateFace(selectedFace);
 
-  populateUI();
+  emit signal_meshChanged(m_mesh.get());
   clearSelectionMode();
 
-  createMeshVBOs();
+  markMeshDirty();
+  emitHistoryChanged();
   update();
 }
 
@@ -448,33 +723,418 @@ void MyGL::slot_subdivideMesh() {
   }
   m_mesh->catmullClarkSubdivide();
 
-  populateUI();
+  emit signal_meshChanged(m_mesh.get());
   clearSelectionMode();
 
-  createMeshVBOs();
+  markMeshDirty();
+  emitHistoryChanged();
   update();
 }
 
-void MyGL::createMeshVBOs() {
-  m_mesh->create();
-  m_wireVert.create();
-  m_wireFace.create();
-  m_wireEdge.create();
+void MyGL::slot_undo() {
+  if (!m_mesh || !m_mesh->undo()) {
+    return;
+  }
+
+  emit signal_meshChanged(m_mesh.get());
+  reselectAfterStep();
+
+  markMeshDirty();
+  emitHistoryChanged();
+  update();
+}
+
+void MyGL::slot_redo() {
+  if (!m_mesh || !m_mesh->redo()) {
+    return;
+  }
+
+  emit signal_meshChanged(m_mesh.get());
+  reselectAfterStep();
+
+  markMeshDirty();
+  emitHistoryChanged();
+  update();
+}
+
+void MyGL::reselectAfterStep() {
+  // undo only ever takes elements off the back of the mesh, so the selection
+  // survives unless it was one of them
+  if (selectedVert && m_mesh->containsVertex(selectedVert)) {
+    emit signal_setSelectedVertex(selectedVert);
+  } else if (selectedFace && m_mesh->containsFace(selectedFace)) {
+    emit signal_setSelectedFace(selectedFace);
+  } else if (selectedEdge && m_mesh->containsEdge(selectedEdge)) {
+    emit signal_setSelectedEdge(selectedEdge);
+  } else if (selectMode != SelectionMode::JOINT) {
+    clearSelectionMode();
+  }
+}
+
+void MyGL::slot_setSkinningMode(int mode) {
+  m_skinningMode = static_cast<SkinningMode>(mode);
+  m_progSkeleton.setSkinningMode(m_skinningMode);
+  m_progOverlaySkinned.setSkinningMode(m_skinningMode);
+  m_progPickFaceSkinned.setSkinningMode(m_skinningMode);
+
+  // the CPU path bakes the blend into the mesh's vertices
+  if (m_cpuSkinning && m_mesh && m_mesh->isBound()) {
+    m_mesh->setCpuPose(&m_jointPalette.getMatrices(), m_skinningMode);
+    markMeshDirty();
+  }
+
+  update();
+}
+
+void MyGL::slot_setHeatWeights(bool heat) {
+  m_heatWeights = heat;
+
+  if (m_mesh && m_mesh->isBound()) {
+    bindMesh();
+    update();
+  }
 }
 
-void MyGL::populateUI() {
-  for (auto &vert : m_mesh->verts) {
-    emit signal_addVertex(vert.get());
+void MyGL::slot_setInfluenceCount(int count) {
+  m_influenceCount = count;
+
+  if (m_mesh && m_mesh->isBound()) {
+    bindMesh();
+    update();
   }
-  for (auto &face : m_mesh->faces) {
-    emit signal_addFace(face.get());
+}
+
+void MyGL::slot_setFrame(int frame) {
+  frame = std::clamp(frame, m_animation.getFirstFrame(),
+                     m_animation.getLastFrame());
+  if (frame == m_frame) {
+    return;
   }
-  for (auto &edge : m_mesh->edges) {
-    // don't show loose half-edges
-    // TODO: maybe dont worry about this kind of thing
-    if (!edge->getNextEdge()) {
-      continue;
+  m_frame = frame;
+  emit signal_frameChanged(m_frame);
+
+  if (m_rootJoint && !m_animation.isEmpty()) {
+    m_animation.apply(m_frame, m_rootJoint->getSkeleton());
+    m_poseDirty = true;
+    update();
+  }
+}
+
+void MyGL::slot_setPlaying(bool playing) {
+  if (!playing) {
+    m_playbackTimer.stop();
+    return;
+  }
+
+  m_playbackStartFrame = m_frame;
+  m_playbackClock.start();
+  advancePlayback();
+}
+
+void MyGL::slot_keySelectedJoint() {
+  if (selectMode != SelectionMode::JOINT || !selectedJoint) {
+    return;
+  }
+
+  const Skeleton &skeleton = m_rootJoint->getSkeleton();
+  int id = selectedJoint->getId();
+  m_animation.setRotationKey(id, m_frame, skeleton.getRotation(id));
+  m_animation.setTranslationKey(id, m_frame, skeleton.getTranslation(id));
+}
+
+void MyGL::slot_setIkEnabled(bool enabled) {
+  m_ikEnabled = enabled;
+  if (!enabled) {
+    // joints stay where the chains left them
+    m_ikHandles.clear();
+  }
+}
+
+void MyGL::slot_setIkMethod(int method) {
+  m_ikMethod = static_cast<IkMethod>(method);
+}
+
+void MyGL::slot_setIkChainLength(int joints) { m_ikChainLength = joints; }
+
+bool MyGL::dragIkTarget(glm::vec2 delta) {
+  if (!m_ikEnabled || selectMode != SelectionMode::JOINT || !selectedJoint) {
+    return false;
+  }
+
+  Skeleton &skeleton = m_rootJoint->getSkeleton();
+  int effector = selectedJoint->getId();
+  auto handle = std::find_if(
+      m_ikHandles.begin(), m_ikHandles.end(),
+      [&](const IkHandle &h) { return h.chain.getEffector() == effector; });
+  if (handle == m_ikHandles.end()) {
+    int root = effector;
+    for (int i = 1; i < m_ikChainLength && skeleton.getParent(root) >= 0;
+         ++i) {
+      root = skeleton.getParent(root);
+    }
+    IkChain chain(skeleton, root, effector);
+    if (chain.isEmpty()) {
+      return false; // The root joint has nothing above it to turn
+    }
+    // earlier chains stay pinned to their targets, so several can be posed
+    // against each other
+    m_ikHandles.push_back({chain, skeleton.getWorldPosition(effector)});
+    handle = m_ikHandles.end() - 1;
+  }
+
+  // move the target across the view by as far as the cursor moved, at the
+  // target's depth
+  float depth = std::max(glm::dot(handle->target - m_glCamera.eye,
+                                  m_glCamera.look),
+                         m_glCamera.near_clip);
+  float perPixel =
+      2 * depth * std::tan(glm::radians(m_glCamera.fovy / 2)) / height();
+  handle->target +=
+      (m_glCamera.right * delta.x - m_glCamera.up * delta.y) * perPixel;
+
+  m_poseDirty = true;
+  update();
+  return true;
+}
+
+void MyGL::slot_setBlendShapeWeight(int target, double weight) {
+  if (!m_mesh || target < 0 ||
+      target >= m_mesh->getBlendShapes().getTargetCount()) {
+    return;
+  }
+
+  // only this target is summed again, then the mesh is skinned as usual
+  m_mesh->setBlendShapeWeight(target, weight);
+  markMeshDirty();
+  update();
+}
+
+void MyGL::slot_setHudVisible(bool visible) {
+  m_showHud = visible;
+  update();
+}
+
+void MyGL::slot_setWireframeVisible(bool visible) {
+  m_showWireframe = visible;
+  update();
+}
+
+void MyGL::advancePlayback() {
+  // the frame follows the clock, so a frame that takes too long to draw is
+  // skipped instead of slowing playback down
+  int first = m_animation.getFirstFrame();
+  int length = m_animation.getLastFrame() - first + 1;
+  float fps = m_animation.getFramesPerSecond();
+  qint64 now = m_playbackClock.elapsed();
+  int elapsed = now * fps / 1000;
+  slot_setFrame(first + (m_playbackStartFrame - first + elapsed) % length);
+
+  // wake up when the clock reaches the next frame, rather than after a whole
+  // number of milliseconds per frame, which would drift (41 ms at 24 fps)
+  qint64 next = std::ceil((elapsed + 1) * 1000 / fps);
+  m_playbackTimer.start(int(std::max<qint64>(1, next - now)));
+}
+
+void MyGL::syncPose() {
+  frameprofile::Scope profile("MyGL::syncPose");
+  if (!m_rootJoint) {
+    return;
+  }
+
+  // however many joints moved since the last frame, their world transforms
+  // are evaluated in one pass and the palette and gizmos are uploaded once,
+  // covering just the range that changed
+  Skeleton &skeleton = m_rootJoint->getSkeleton();
+  if (m_poseDirty) {
+    m_poseDirty = false;
+    // chains are solved on top of whatever else moved them; each carries on
+    // from its last pose, so a few iterations per frame keep up with a drag
+    for (IkHandle &handle : m_ikHandles) {
+      handle.chain.solve(skeleton, handle.target, m_ikMethod);
     }
-    emit signal_addEdge(edge.get());
   }
+  int first = 0, end = 0;
+  bool moved = skeleton.takeChangedRange(&first, &end);
+  if (moved) {
+    m_jointPalette.update(skeleton, first, end);
+  }
+  // a new selection reaches the gizmos even if nothing moved
+  m_jointGizmo.update(skeleton, first, end);
+  if (moved && m_cpuSkinning && m_mesh && m_mesh->isBound()) {
+    markMeshDirty(); // Posed by syncMesh(), which runs next
+  }
+}
+
+void MyGL::drawHud() {
+  QStringList lines;
+  lines << "Rolling mean / max over recent frames";
+  for (const frameprofile::Stats &s : frameprofile::stats()) {
+    lines << QString("%1 %2 %3 ms / %4 ms")
+                 .arg(s.gpu ? "GPU" : "CPU")
+                 .arg(QString::fromStdString(s.name), -22)
+                 .arg(s.meanMs, 7, 'f', 3)
+                 .arg(s.maxMs, 7, 'f', 3);
+  }
+  const GLState::FrameStats &calls = glState().getLastFrame();
+  lines << QString("GL calls: %1 issued, %2 skipped")
+               .arg(calls.issued)
+               .arg(calls.skipped);
+  lines << QString("Mesh rebuilds: %1 for %2 edits")
+               .arg(m_lastFrameRebuilds)
+               .arg(m_lastFrameEdits);
+  if (!gpuTimers().isSupported()) {
+    lines << "GPU timer queries are not supported";
+  }
+
+  QPainter painter(this);
+  painter.setFont(QFont("monospace", 8));
+  QFontMetrics metrics = painter.fontMetrics();
+  int width = 0;
+  for (const QString &line : lines) {
+    width = std::max(width, metrics.horizontalAdvance(line));
+  }
+  painter.fillRect(4, 4, width + 8, metrics.height() * lines.size() + 8,
+                   QColor(0, 0, 0, 160));
+  painter.setPen(Qt::white);
+  for (int i = 0; i < lines.size(); ++i) {
+    painter.drawText(8, 8 + metrics.ascent() + i * metrics.height(),
+                     lines[i]);
+  }
+  painter.end();
+
+  // QPainter binds its own programs, buffers and textures
+  glState().invalidate();
+}
+
+void MyGL::drawOverlay() {
+  ShaderProgram &prog = m_mesh->isBound() && !m_cpuSkinning
+                            ? m_progOverlaySkinned
+                            : m_progOverlay;
+  if (!prog.isLinked()) {
+    return;
+  }
+  m_overlay.update(*m_mesh);
+  m_overlay.bind(2, 3);
+  prog.setViewport(glm::vec2(width(), height()) * float(devicePixelRatio()));
+  prog.setWireframe(m_showWireframe);
+
+  // the overlay's triangles are the mesh's own, at the same depth, and only
+  // blend over it
+  glState().setDepthFunc(GL_LEQUAL);
+  glState().setDepthMask(false);
+  glState().setEnabled(GL_BLEND, true);
+  glState().setBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  prog.setOccluded(false);
+  prog.draw(*m_mesh, "Overlay");
+  if (selectMode == SelectionMode::VERTEX ||
+      selectMode == SelectionMode::FACE || selectMode == SelectionMode::EDGE) {
+    // then whatever of the selection is behind the nearest surface, faded,
+    // so selected elements on the far side stay visible
+    glState().setDepthFunc(GL_GREATER);
+    prog.setOccluded(true);
+    prog.draw(*m_mesh, "Occluded selection");
+  }
+  glState().setEnabled(GL_BLEND, false);
+  glState().setDepthMask(true);
+  glState().setDepthFunc(GL_LESS);
+}
+
+void MyGL::drawPick() {
+  frameprofile::Scope profile("MyGL::drawPick");
+  float ratio = devicePixelRatio();
+  glm::ivec2 viewport(width() * ratio, height() * ratio);
+  glm::mat4 viewProj = PickBuffer::pickMatrix(*m_pickPixel, viewport) *
+                       m_glCamera.getViewProj();
+  m_pickPixel.reset();
+
+  m_pickBuffer.begin();
+  if (m_mesh) {
+    bool skinned = m_mesh->isBound() && !m_cpuSkinning;
+    ShaderProgram &prog = skinned ? m_progPickFaceSkinned : m_progPickFace;
+    m_overlay.update(*m_mesh);
+    m_overlay.bind(2, 3);
+    if (skinned) {
+      m_jointPalette.bind(0, 1);
+    }
+    prog.setViewProjMatrix(viewProj);
+    prog.setModelMatrix(glm::mat4(1.f));
+    // only the chunks under the cursor are left to draw; the next frame
+    // culls against the whole view again
+    m_mesh->cull(viewProj, &m_jointPalette.getMatrices(), m_skinningMode);
+    prog.draw(*m_mesh, "Pick faces");
+    m_pickLayout = m_mesh->getLayoutVersion();
+    m_pickVertCount = m_mesh->getVertexCount();
+  }
+  if (m_rootJoint) {
+    // joints are drawn over the mesh, as in the viewport
+    glState().setEnabled(GL_DEPTH_TEST, false);
+    m_jointGizmo.bind(4, 5);
+    m_progPickJoint.setViewProjMatrix(viewProj);
+    m_progPickJoint.setModelMatrix(glm::mat4(1.f));
+    m_progPickJoint.draw(m_jointGizmo, "Pick joints");
+    glState().setEnabled(GL_DEPTH_TEST, true);
+  }
+  m_pickBuffer.end(defaultFramebufferObject());
+  glViewport(0, 0, viewport.x, viewport.y);
+
+  // the result is collected by a later frame
+  update();
+}
+
+void MyGL::takePick() {
+  glm::ivec2 id;
+  if (!m_pickBuffer.takeResult(&id)) {
+    if (m_pickBuffer.isPending()) {
+      update(); // Try again next frame
+    }
+    return;
+  }
+
+  // the first component says what was hit; see the pick shaders
+  if (id.x == 1 && m_mesh && m_mesh->getLayoutVersion() == m_pickLayout) {
+    int face = id.y - m_pickVertCount;
+    if (face >= 0 && face < (int)m_mesh->faces.size()) {
+      emit signal_setSelectedFace(m_mesh->faces[face].get());
+    }
+  } else if (id.x == 2 && m_rootJoint) {
+    std::vector<Joint *> joints;
+    m_rootJoint->getAllJoints(joints);
+    auto joint = std::find_if(joints.begin(), joints.end(),
+                              [&](Joint *j) { return j->getId() == id.y; });
+    if (joint != joints.end()) {
+      emit signal_setSelectedJoint(*joint);
+    }
+  }
+}
+
+void MyGL::markMeshDirty() {
+  m_meshDirty = true;
+  ++m_pendingEdits;
+}
+
+void MyGL::syncMesh() {
+  frameprofile::Scope profile("MyGL::syncMesh");
+  m_lastFrameEdits = m_pendingEdits;
+  m_lastFrameRebuilds = 0;
+  m_pendingEdits = 0;
+  if (!m_meshDirty || !m_mesh) {
+    return;
+  }
+  m_meshDirty = false;
+
+  // however many edits arrived since the last frame, the buffers are rebuilt
+  // once; normals are recomputed with them, and the overlay reads the mesh's
+  // buffers, so the selection follows along
+  m_mesh->create();
+  ++m_lastFrameRebuilds;
+}
+
+void MyGL::emitHistoryChanged() {
+  const MeshHistory &history = m_mesh->getHistory();
+  emit signal_historyChanged(
+      QString("History: %1 undo / %2 redo steps, %3 of %4 KiB")
+          .arg(history.getUndoCount())
+          .arg(history.getRedoCount())
+          .arg((history.getByteSize() + 1023) / 1024)
+          .arg(history.getByteBudget() / 1024));
 }
@@ -2,19 +2,29 @@
 
 #include "camera.h"
 #include "openglcontext.h"
+#include "pickbuffer.h"
 #include "scene/mesh.h"
-#include "scene/wire/wireedge.h"
-#include "scene/wire/wireface.h"
-#include "scene/wire/wirevertex.h"
+#include "scene/meshoverlay.h"
+#include "scene/pointcache.h"
+#include "shadercache.h"
 #include "shaderprogram.h"
+#include "skeletondata/animation.h"
+#include "skeletondata/heatweights.h"
+#include "skeletondata/ik.h"
+#include "skeletondata/jointgizmo.h"
+#include "skeletondata/jointpalette.h"
+#include "skeletondata/skeletonjson.h"
 #include "smartpointerhelp.h"
 
+#include <QElapsedTimer>
 #include <QFile>
-#include <QJsonDocument>
 #include <QOpenGLShaderProgram>
 #include <QOpenGLVertexArrayObject>
+#include <QTimer>
 #include <glm/fwd.hpp>
 
+#include <optional>
+
 enum SelectionMode { NONE, VERTEX, FACE, EDGE, JOINT };
 
 class MyGL : public OpenGLContext {
@@ -28,8 +38,17 @@ public:
   void paintGL() override;
 
   void loadObj(QFile &file);
-  void loadSkeleton(const QJsonDocument &doc);
-  void exportUSD(const QString &filePath) const;
+  // Adds a morph target from an OBJ file sharing the mesh's topology. On
+  // failure, describes the problem in error.
+  bool loadBlendShape(QFile &file, const QString &name, QString *error);
+  // Replaces the skeleton with one read from JSON text. On failure, keeps
+  // the current one and describes the problem in error.
+  bool loadSkeleton(const QByteArray &json, QString *error);
+  void exportUSD(const QString &filePath); // Exports in the background
+  // Bakes the animated, skinned mesh over [firstFrame, lastFrame] to a point
+  // cache, in the background
+  void exportBakedUSD(const QString &filePath, int firstFrame, int lastFrame,
+                      bool normals);
   void bindMesh();
 
   void clearSelectionMode();
@@ -41,22 +60,35 @@ public:
   void rotateJoint(float x, float y, float z);
 
   bool isMeshLoaded() const;
+  bool isMeshBound() const;
+  const Animation &getAnimation() const;
+  float getBlendShapeWeight(int target) const;
 
 protected:
   void keyPressEvent(QKeyEvent *e) override;
+  void mousePressEvent(QMouseEvent *e) override;
+  void mouseReleaseEvent(QMouseEvent *e) override; // Picks on a click
   void mouseMoveEvent(QMouseEvent *e) override;
   void wheelEvent(QWheelEvent *e) override;
 
 signals:
   void signal_clearUI();
-  void signal_addVertex(Vertex *vert);
-  void signal_addFace(Face *face);
-  void signal_addEdge(HalfEdge *edge);
+  // The mesh was replaced, or elements were added to or removed from it
+  void signal_meshChanged(Mesh *mesh);
   void signal_setJoint(Joint *joint);
+  void signal_addBlendShape(const QString &name);
+
+  void signal_setSelectedVertex(Vertex *vert);
+  void signal_setSelectedFace(Face *face);
+  void signal_setSelectedEdge(HalfEdge *edge);
+  void signal_setSelectedJoint(QTreeWidgetItem *joint);
 
-  void signal_setSelectedVertex(QListWidgetItem *vert);
-  void signal_setSelectedFace(QListWidgetItem *face);
-  void signal_setSelectedEdge(QListWidgetItem *edge);
+  void signal_historyChanged(const QString &summary);
+  void signal_exportFinished(const QString &filePath, bool success);
+  void signal_bakeProgress(int writtenFrames, int totalFrames);
+  void signal_bindProgress(int solvedJoints, int totalJoints);
+  void signal_bindFinished(bool applied); // False if the result was stale
+  void signal_frameChanged(int frame);
 
 public slots:
   void slot_setVertPosX(double x);
@@ -70,25 +102,91 @@ public slots:
   void slot_triangulateFace();
   void slot_subdivideMesh();
 
+  void slot_undo();
+  void slot_redo();
+
+  void slot_setSkinningMode(int mode);    // Index of a SkinningMode
+  void slot_setInfluenceCount(int count); // Rebinds a bound mesh
+  void slot_setHeatWeights(bool heat);    // Bone heat or bone distance
+
+  void slot_setFrame(int frame); // Poses the skeleton at frame
+  void slot_setPlaying(bool playing);
+  void slot_keySelectedJoint(); // Keys its current transform at this frame
+
+  void slot_setIkEnabled(bool enabled);   // Disabling releases every chain
+  void slot_setIkMethod(int method);      // Index of an IkMethod
+  void slot_setIkChainLength(int joints); // For chains dragged from now on
+
+  void slot_setBlendShapeWeight(int target, double weight);
+
+  void slot_setHudVisible(bool visible); // Frame timings over the viewport
+  void slot_setWireframeVisible(bool visible); // Polygon edges over the mesh
+
 private:
-  uPtr<Mesh> m_mesh;       // Our custom mesh instance
-  uPtr<Joint> m_rootJoint; // Our JSON-loaded skeleton
-  WireVertex m_wireVert;   // Wire vert display instance
-  WireFace m_wireFace;     // Wire face display instance
-  WireEdge m_wireEdge;     // Wire edge display instance
+  // A chain posed by IK, pulling its effector towards a target
+  struct IkHandle {
+    IkChain chain;
+    glm::vec3 target; // World space
+  };
+
+  uPtr<Mesh> m_mesh;           // Our custom mesh instance
+  uPtr<Joint> m_rootJoint;     // Our JSON-loaded skeleton
+  JointPalette m_jointPalette; // Skinning matrices of the bound skeleton
+  JointGizmo m_jointGizmo;     // Circles and bones of m_rootJoint's skeleton
+  MeshOverlay m_overlay;       // Selection flags for the overlay shaders
   ShaderProgram
-      m_progLambert;        // A shader program that uses lambertian reflection
-  ShaderProgram m_progFlat; // A shader program that uses "flat" reflection (no
-                            // shadowing at all)
+      m_progLambert;         // A shader program that uses lambertian reflection
+  ShaderProgram m_progGizmo; // Draws m_jointGizmo, one instance per joint
   ShaderProgram m_progSkeleton; // Skeleton shader program
-
-  GLuint vao; // A handle for our vertex array object. This will store the VBOs
-              // created in our geometry classes. Don't worry too much about
-              // this. Just know it is necessary in order to render geometry.
+  // Polygon edges and the selection drawn over the mesh, after the lambert
+  // or the skeleton vertex shader
+  ShaderProgram m_progOverlay;
+  ShaderProgram m_progOverlaySkinned;
+  // Write the face or joint under the cursor into m_pickBuffer
+  ShaderProgram m_progPickFace;
+  ShaderProgram m_progPickFaceSkinned;
+  ShaderProgram m_progPickJoint;
+  ShaderCache m_shaderCache; // Linked programs from earlier runs
+  bool m_cpuSkinning;          // Pose bound meshes on the CPU and draw them
+                               // with m_progLambert instead of m_progSkeleton
+  SkinningMode m_skinningMode; // Linear or dual quaternion blending
+  int m_influenceCount;        // Joints bound to each vertex, at most 8
+  bool m_heatWeights;          // Bind with heat diffusion weights
+  uint64_t m_bindGeneration;   // Bumped whenever a pending bind goes stale
+
+  Animation m_animation;         // Keyframes of the loaded skeleton
+  int m_frame;                   // Current frame of m_animation
+  QTimer m_playbackTimer;        // Fires when the next frame is due
+  QElapsedTimer m_playbackClock; // Time since playback (re)started
+  int m_playbackStartFrame;      // Frame playback (re)started from
+  bool m_poseDirty;              // Joints moved since the last frame was drawn
+  bool m_meshDirty;              // The mesh changed since it was last uploaded
+
+  // Mesh edits waiting for the next frame, and those the last frame drawn
+  // folded into how many rebuilds (at most one), for the HUD
+  int m_pendingEdits;
+  int m_lastFrameEdits;
+  int m_lastFrameRebuilds;
+
+  std::vector<IkHandle> m_ikHandles; // Dragged chains, solved every frame
+  bool m_ikEnabled;                  // Ctrl+drag pulls the selected joint
+  IkMethod m_ikMethod;
+  int m_ikChainLength; // Joints in a new chain, counting its effector
+
+  bool m_showHud;       // Draw the frame profile's statistics over the scene
+  bool m_showWireframe; // Draw every polygon edge over the mesh
 
   Camera m_glCamera;
 
   glm::ivec2 m_lastMousePos;
+  glm::ivec2 m_pressPos; // Where the last button went down
+
+  PickBuffer m_pickBuffer;
+  std::optional<glm::ivec2> m_pickPixel; // Clicked, waiting for drawPick()
+  // The mesh's layout and vertex count when it was last drawn into
+  // m_pickBuffer, which the slot table entries read back depend on
+  int m_pickLayout;
+  int m_pickVertCount;
 
   Vertex *selectedVert;
   Face *selectedFace;
@@ -97,8 +195,24 @@ private:
 
   SelectionMode selectMode;
 
-  void populateUI(); // Emits signals to populate MainWindow QListWidgets with
-                     // mesh items.
-  void createMeshVBOs(); // Runs create methods of mesh object and mesh display
-                         // objects.
+  // Schedules a rebuild of the mesh's buffers, which the selection display
+  // also draws from. However many edits mark it, syncMesh() rebuilds once.
+  void markMeshDirty();
+  void emitHistoryChanged(); // Reports undo/redo depth and memory use.
+  // Keeps the selection after an undo or redo if it is still in the mesh,
+  // refreshing the panels showing it, and clears it otherwise
+  void reselectAfterStep();
+  void bindMeshHeat(); // Computes heat weights in the background, then binds
+  void advancePlayback(); // Moves to the frame matching the playback clock
+  void syncPose(); // Uploads joint changes made since the last frame, once
+  void syncMesh(); // Rebuilds the mesh's buffers if marked, once per frame
+  // Moves the selected joint's IK target with the cursor. False if IK does
+  // not apply, so the drag should move the camera instead.
+  bool dragIkTarget(glm::vec2 delta);
+  void drawHud(); // Paints the frame profile's statistics with QPainter
+  void drawOverlay(); // Draws polygon edges and the selection over the mesh
+  // Draws the ids under m_pickPixel into m_pickBuffer, to be read back by a
+  // later frame
+  void drawPick();
+  void takePick(); // Selects whatever the last finished pick pass hit
 };
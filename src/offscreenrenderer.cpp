@@ -0,0 +1,217 @@
+#include "offscreenrenderer.h"
+
+#include "camera.h"
+#include "scene/mesh.h"
+#include "skeletondata/joint.h"
+#include "skeletondata/skeletonjson.h"
+
+#include <QFile>
+#include <QImage>
+
+#include <glm/gtc/quaternion.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+
+RenderJob RenderJob::defaults() {
+  RenderJob job;
+  job.mode = SkinningMode::LINEAR;
+  job.width = job.height = 512;
+  job.rotY = 30;
+  job.rotX = -20;
+  job.distance = 0;
+  job.fovy = 45;
+  return job;
+}
+
+namespace {
+// The camera job asks for, looking at mesh
+Camera frameCamera(const RenderJob &job, const Mesh &mesh) {
+  glm::vec3 lo(std::numeric_limits<float>::max()), hi(-lo);
+  for (auto &vert : mesh.verts) {
+    lo = glm::min(lo, vert->getPos());
+    hi = glm::max(hi, vert->getPos());
+  }
+  if (mesh.verts.empty()) {
+    lo = hi = glm::vec3(0);
+  }
+
+  Camera camera(job.width, job.height, job.rotY, job.rotX, job.distance,
+                glm::vec3(0, 1, 0));
+  camera.fovy = job.fovy;
+  camera.ref = job.target ? *job.target : (lo + hi) * 0.5f;
+  if (job.distance <= 0) {
+    // back off until the bounding sphere fits the narrower field of view
+    float radius = std::max(glm::length(hi - lo) * 0.5f, 1e-3f);
+    float halfY = glm::radians(job.fovy) / 2;
+    float halfX = std::atan(std::tan(halfY) * job.width / job.height);
+    camera.zoom = radius / std::sin(std::min(halfX, halfY));
+    camera.far_clip = std::max(camera.far_clip, camera.zoom + 2 * radius);
+  }
+  camera.RecomputeAttributes();
+  return camera;
+}
+} // namespace
+
+OffscreenRenderer::OffscreenRenderer()
+    : m_context(), m_surface(), m_framebuffer(nullptr), m_shaderCache(this),
+      m_progLambert(this), m_progSkeleton(this), m_jointPalette(this),
+      m_cpuSkinning(false) {}
+
+OffscreenRenderer::~OffscreenRenderer() {
+  if (m_context.makeCurrent(&m_surface)) {
+    m_jointPalette.destroy();
+    m_framebuffer.reset();
+    m_context.doneCurrent();
+  }
+}
+
+bool OffscreenRenderer::initialize(QString *error) {
+  m_context.setFormat(QSurfaceFormat::defaultFormat());
+  if (!m_context.create()) {
+    *error = "Could not create an OpenGL context";
+    return false;
+  }
+  m_surface.setFormat(m_context.format());
+  m_surface.create();
+  if (!m_surface.isValid() || !m_context.makeCurrent(&m_surface)) {
+    *error = "Could not make an offscreen OpenGL context current";
+    return false;
+  }
+  if (!initializeOpenGLFunctions()) {
+    *error = "OpenGL 3.2 core functions are unavailable";
+    return false;
+  }
+  // nothing is timed here, so the GPU timers are left uninitialized
+  glState().invalidate();
+  m_shaderCache.initialize();
+
+  glState().setEnabled(GL_DEPTH_TEST, true);
+  glClearColor(0.5, 0.5, 0.5, 1);
+
+  m_progLambert.create(":/glsl/lambert.vert.glsl", ":/glsl/lambert.frag.glsl",
+                       &m_shaderCache);
+  m_progSkeleton.create(":/glsl/skeleton.vert.glsl",
+                        ":/glsl/skeleton.frag.glsl", &m_shaderCache);
+  m_progSkeleton.setJointPalette(0, 1);
+  // as in the viewport, an unused second joint set must weigh nothing
+  glVertexAttrib4f(ATTR_JOINT_WGT1, 0, 0, 0, 0);
+  // software drivers may reject the skeleton shader, which leaves skinning
+  // to the CPU; the lambert shader has no such fallback
+  m_cpuSkinning = !m_progSkeleton.isLinked();
+  if (m_cpuSkinning) {
+    fprintf(stderr, "Skinning on the CPU (%s)\n", skinning::simdPath());
+  }
+  if (!m_progLambert.isLinked()) {
+    *error = "Could not link the lambert shader";
+    return false;
+  }
+  return true;
+}
+
+QOpenGLContext *OffscreenRenderer::glContext() const {
+  return const_cast<QOpenGLContext *>(&m_context);
+}
+
+bool OffscreenRenderer::bindFramebuffer(int width, int height) {
+  if (!m_framebuffer || m_framebuffer->size() != QSize(width, height)) {
+    m_framebuffer = mkU<QOpenGLFramebufferObject>(
+        width, height, QOpenGLFramebufferObject::Depth);
+    // setting up its attachments binds textures behind GLState's back
+    glState().invalidate();
+  }
+  return m_framebuffer->isValid() && m_framebuffer->bind();
+}
+
+bool OffscreenRenderer::render(const RenderJob &job, QString *error) {
+  if (!m_context.makeCurrent(&m_surface)) {
+    *error = "Lost the OpenGL context";
+    return false;
+  }
+
+  QFile objFile(job.meshPath);
+  if (!objFile.open(QIODevice::ReadOnly)) {
+    *error = job.meshPath + ": " + objFile.errorString();
+    return false;
+  }
+  uPtr<Mesh> mesh = mkU<Mesh>(this, objFile);
+
+  uPtr<Joint> root;
+  if (!job.skeletonPath.isEmpty()) {
+    QFile jsonFile(job.skeletonPath);
+    if (!jsonFile.open(QIODevice::ReadOnly)) {
+      *error = job.skeletonPath + ": " + jsonFile.errorString();
+      return false;
+    }
+    QByteArray json = jsonFile.readAll();
+    skeletonjson::Result result = skeletonjson::parse(json.data(), json.size());
+    if (!result.skeleton) {
+      *error = job.skeletonPath + ": " + QString::fromStdString(result.error);
+      return false;
+    }
+    root = mkU<Joint>(std::move(result.skeleton), result.names);
+
+    // bind in the rest pose, the same way the viewport does
+    Skeleton &skeleton = root->getSkeleton();
+    skeleton.generateBindMatrices();
+    m_jointPalette.create(skeleton);
+    mesh->setCpuPose(m_cpuSkinning ? &m_jointPalette.getMatrices() : nullptr,
+                     job.mode);
+    mesh->bindSkeleton(root.get());
+
+    for (auto &[name, degrees] : job.pose) {
+      auto it = std::find(result.names.begin(), result.names.end(),
+                          name.toStdString());
+      if (it == result.names.end()) {
+        *error = job.skeletonPath + ": no joint named " + name;
+        return false;
+      }
+      // about the joint's own axes, on top of its rest rotation
+      skeleton.rotateLocal(it - result.names.begin(),
+                           glm::quat(glm::radians(degrees)));
+    }
+    int first, end;
+    if (skeleton.takeChangedRange(&first, &end)) {
+      m_jointPalette.update(skeleton, first, end);
+    }
+  }
+  // uploads the weights binding set, or the vertices posed on the CPU
+  mesh->create();
+
+  if (!bindFramebuffer(job.width, job.height)) {
+    *error = QString("Could not create a %1x%2 framebuffer")
+                 .arg(job.width)
+                 .arg(job.height);
+    return false;
+  }
+  glViewport(0, 0, job.width, job.height);
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+  Camera camera = frameCamera(job, *mesh);
+  glm::mat4 viewProj = camera.getViewProj();
+  for (ShaderProgram *prog : {&m_progLambert, &m_progSkeleton}) {
+    prog->setViewProjMatrix(viewProj);
+    prog->setCamPos(camera.eye);
+    prog->setModelMatrix(glm::mat4(1));
+  }
+  mesh->cull(viewProj, &m_jointPalette.getMatrices(), job.mode);
+  if (mesh->isBound() && !m_cpuSkinning) {
+    m_progSkeleton.setSkinningMode(job.mode);
+    m_jointPalette.bind(0, 1);
+    m_progSkeleton.draw(*mesh, "Skinned mesh");
+  } else {
+    m_progLambert.draw(*mesh, "Mesh");
+  }
+
+  // reading the pixels back waits for the draw to finish
+  QImage image = m_framebuffer->toImage();
+  m_framebuffer->release();
+  mesh->destroy();
+  if (!image.save(job.outputPath)) {
+    *error = "Could not write " + job.outputPath;
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "rendercontext.h"
+#include "shadercache.h"
+#include "shaderprogram.h"
+#include "skeletondata/jointpalette.h"
+#include "skeletondata/skinning.h"
+#include "smartpointerhelp.h"
+
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+#include <QString>
+
+#include <glm/glm.hpp>
+
+#include <optional>
+#include <utility>
+#include <vector>
+
+// One image for OffscreenRenderer to produce
+struct RenderJob {
+  QString meshPath;     // OBJ file
+  QString skeletonPath; // JSON skeleton to bind with, or empty
+  // Joints to rotate away from their rest pose after binding, by name, with
+  // XYZ Euler angles in degrees about each joint's own axes
+  std::vector<std::pair<QString, glm::vec3>> pose;
+  SkinningMode mode;
+  QString outputPath; // Any format QImage writes, chosen by the suffix
+  int width, height;
+  float rotY, rotX; // Orbit angles of the camera, in degrees
+  float distance;   // From the target; 0 fits the whole mesh in view
+  std::optional<glm::vec3> target; // Orbit center; the mesh's bounding box
+                                   // center if empty
+  float fovy;                      // Vertical field of view, in degrees
+
+  // A 512x512 view from the front right and a little above
+  static RenderJob defaults();
+};
+
+/**
+ * Renders meshes to images without a window, for golden image tests and
+ * thumbnails on machines with no display or GPU.
+ *
+ * Draws into a framebuffer object of a context made current on a
+ * QOffscreenSurface, with the same shaders and drawables as the viewport.
+ * The context, the compiled programs and the framebuffer are kept between
+ * renders, so a batch only pays for them once; each render loads its files
+ * fresh. Under Mesa, LIBGL_ALWAYS_SOFTWARE=1 selects llvmpipe.
+ */
+class OffscreenRenderer : public RenderContext {
+public:
+  OffscreenRenderer();
+  ~OffscreenRenderer();
+
+  // Creates the context and compiles the shaders. False with error set if
+  // no OpenGL 3.2 core context is available.
+  bool initialize(QString *error);
+  QOpenGLContext *glContext() const override;
+
+  bool render(const RenderJob &job, QString *error);
+
+private:
+  QOpenGLContext m_context;
+  QOffscreenSurface m_surface;
+  uPtr<QOpenGLFramebufferObject> m_framebuffer; // Resized to each job
+  ShaderCache m_shaderCache;
+  ShaderProgram m_progLambert;
+  ShaderProgram m_progSkeleton;
+  JointPalette m_jointPalette;
+  bool m_cpuSkinning; // The skeleton shader did not link
+
+  // Binds a framebuffer of the given size, reusing the last one if it fits
+  bool bindFramebuffer(int width, int height);
+};
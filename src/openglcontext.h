@@ -1,9 +1,10 @@
 #pragma once
 
-#include <QOpenGLFunctions_3_2_Core>
+#include "rendercontext.h"
+
 #include <QOpenGLWidget>
 
-class OpenGLContext : public QOpenGLWidget, public QOpenGLFunctions_3_2_Core {
+class OpenGLContext : public QOpenGLWidget, public RenderContext {
   Q_OBJECT
 
 protected:
@@ -16,9 +17,8 @@ public:
   ~OpenGLContext();
 
   void debugContextVersion();
-  void printGLErrorLog();
-  void printLinkInfoLog(int prog);
-  void printShaderInfoLog(int shader);
+
+  QOpenGLContext *glContext() const override;
 
 private slots:
   /*** AUTOMATIC TESTING: DO NOT MODIFY ***/
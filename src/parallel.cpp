@@ -0,0 +1,64 @@
+#include "parallel.h"
+
+#include <QThread>
+#include <QThreadPool>
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
+namespace {
+// One forEachBlock() call. Helpers the pool starts late may outlive the call,
+// so they share ownership, but they only ever find every block taken.
+struct Job {
+  std::function<void(size_t)> block;
+  size_t blocks;
+  std::atomic<size_t> next;
+  std::atomic<size_t> done;
+  std::mutex mutex;
+  std::condition_variable finished;
+
+  Job(const std::function<void(size_t)> &block, size_t blocks)
+      : block(block), blocks(blocks), next(0), done(0) {}
+
+  void work() {
+    for (size_t b = next++; b < blocks; b = next++) {
+      block(b);
+      if (++done == blocks) {
+        std::lock_guard<std::mutex> lock(mutex);
+        finished.notify_all();
+      }
+    }
+  }
+};
+
+// Kept apart from the global pool, which runs long tasks such as USD export,
+// and never torn down, so worker threads are created once per program
+QThreadPool &pool() {
+  static QThreadPool *instance = [] {
+    QThreadPool *p = new QThreadPool();
+    p->setMaxThreadCount(std::max(1, QThread::idealThreadCount() - 1));
+    p->setExpiryTimeout(-1);
+    return p;
+  }();
+  return *instance;
+}
+} // namespace
+
+namespace parallel {
+void forEachBlock(size_t blocks, const std::function<void(size_t)> &block) {
+  if (blocks == 0) {
+    return;
+  }
+  auto job = std::make_shared<Job>(block, blocks);
+  size_t helpers = std::min<size_t>(blocks - 1, pool().maxThreadCount());
+  for (size_t i = 0; i < helpers; ++i) {
+    pool().start([job] { job->work(); });
+  }
+  job->work();
+
+  std::unique_lock<std::mutex> lock(job->mutex);
+  job->finished.wait(lock, [&] { return job->done == blocks; });
+}
+} // namespace parallel
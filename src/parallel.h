@@ -0,0 +1,30 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+
+namespace parallel {
+/// Calls block(b) for every b in [0, blocks), on the calling thread and on a
+/// pool of worker threads that lives as long as the program, returning once
+/// every call is done. Blocks are handed out dynamically, so uneven work
+/// balances itself, and the calling thread always takes part, so a call made
+/// from a worker (or while the pool is busy) still finishes.
+void forEachBlock(size_t blocks, const std::function<void(size_t)> &block);
+
+/// Splits [0, count) into blocks of blockSize elements and calls
+/// fn(begin, end) for each block with forEachBlock(). Work that fits in one
+/// block runs on the calling thread without involving the pool.
+template <typename F> void forBlocks(size_t count, size_t blockSize, F fn) {
+  size_t blocks = (count + blockSize - 1) / blockSize;
+  if (blocks <= 1) {
+    if (count > 0) {
+      fn(size_t(0), count);
+    }
+    return;
+  }
+  forEachBlock(blocks, [&](size_t b) {
+    fn(b * blockSize, std::min(count, (b + 1) * blockSize));
+  });
+}
+} // namespace parallel
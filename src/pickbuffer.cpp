@@ -0,0 +1,112 @@
+#include "pickbuffer.h"
+
+#include "frameprofile.h"
+
+PickBuffer::PickBuffer(RenderContext *context)
+    : context(context), framebuffer(0), idBuffer(0), depthBuffer(0),
+      pixelBuffer(0), fence(nullptr) {}
+
+PickBuffer::~PickBuffer() { destroy(); }
+
+glm::mat4 PickBuffer::pickMatrix(glm::ivec2 pixel, glm::ivec2 viewport) {
+  // scale normalized device coordinates by the viewport's size in pixels,
+  // centered on the pixel, so that it spans [-1, 1]
+  glm::vec2 size(viewport);
+  glm::vec2 center = (glm::vec2(pixel) + 0.5f) / size * 2.f - 1.f;
+  glm::mat4 pick(1);
+  pick[0][0] = size.x;
+  pick[1][1] = size.y;
+  pick[3][0] = -center.x * size.x;
+  pick[3][1] = -center.y * size.y;
+  return pick;
+}
+
+void PickBuffer::begin() {
+  if (!framebuffer) {
+    context->glGenFramebuffers(1, &framebuffer);
+    context->glGenRenderbuffers(1, &idBuffer);
+    context->glGenRenderbuffers(1, &depthBuffer);
+    context->glGenBuffers(1, &pixelBuffer);
+
+    context->glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    context->glBindRenderbuffer(GL_RENDERBUFFER, idBuffer);
+    context->glRenderbufferStorage(GL_RENDERBUFFER, GL_RG32I, 1, 1);
+    context->glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                                       GL_RENDERBUFFER, idBuffer);
+    context->glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+    context->glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, 1,
+                                   1);
+    context->glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                                       GL_RENDERBUFFER, depthBuffer);
+
+    context->glState().bindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffer);
+    context->glBufferData(GL_PIXEL_PACK_BUFFER, sizeof(glm::ivec2), nullptr,
+                          GL_STREAM_READ);
+    context->glState().bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  } else {
+    context->glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  }
+
+  const GLint none[4] = {0, 0, 0, 0};
+  const GLfloat farthest = 1;
+  context->glViewport(0, 0, 1, 1);
+  context->glClearBufferiv(GL_COLOR, 0, none);
+  context->glClearBufferfv(GL_DEPTH, 0, &farthest);
+  context->glState().countIssued(3);
+}
+
+void PickBuffer::end(GLuint target) {
+  if (fence) {
+    context->glDeleteSync(fence);
+  }
+
+  // the copy lands in the pixel buffer whenever the GPU gets to it, rather
+  // than making glReadPixels wait for the pass to finish
+  context->glState().bindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffer);
+  context->glReadPixels(0, 0, 1, 1, GL_RG_INTEGER, GL_INT, nullptr);
+  context->glState().bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  fence = context->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  context->glBindFramebuffer(GL_FRAMEBUFFER, target);
+  context->glState().countIssued(3);
+}
+
+bool PickBuffer::isPending() const { return fence; }
+
+bool PickBuffer::takeResult(glm::ivec2 *id) {
+  if (!fence) {
+    return false;
+  }
+  GLenum status = context->glClientWaitSync(fence, 0, 0);
+  if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+    return false;
+  }
+  frameprofile::Scope profile("PickBuffer::takeResult");
+  context->glDeleteSync(fence);
+  fence = nullptr;
+
+  context->glState().bindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffer);
+  void *pixel = context->glMapBufferRange(
+      GL_PIXEL_PACK_BUFFER, 0, sizeof(glm::ivec2), GL_MAP_READ_BIT);
+  bool mapped = pixel;
+  if (mapped) {
+    *id = *static_cast<const glm::ivec2 *>(pixel);
+    context->glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  }
+  context->glState().bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  context->glState().countIssued(3);
+  return mapped;
+}
+
+void PickBuffer::destroy() {
+  if (fence) {
+    context->glDeleteSync(fence);
+    fence = nullptr;
+  }
+  if (framebuffer) {
+    context->glDeleteFramebuffers(1, &framebuffer);
+    context->glDeleteRenderbuffers(1, &idBuffer);
+    context->glDeleteRenderbuffers(1, &depthBuffer);
+    context->glState().deleteBuffer(pixelBuffer);
+  }
+  framebuffer = idBuffer = depthBuffer = pixelBuffer = 0;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "rendercontext.h"
+
+#include <glm/glm.hpp>
+
+/**
+ * A one pixel integer framebuffer for picking what lies under the cursor.
+ *
+ * The pick pass draws ids instead of colors through pickMatrix(), which
+ * stretches the pixel under the cursor over the whole framebuffer, so only
+ * geometry under the cursor survives clipping and the pass costs about the
+ * same however big the mesh is. The pixel is copied into a pixel buffer
+ * object and read back once a fence says the GPU is done, a frame or so
+ * later, so asking never stalls the pipeline.
+ */
+class PickBuffer {
+public:
+  PickBuffer(RenderContext *context);
+  ~PickBuffer();
+
+  // The view projection matrix that maps pixel, counted from the bottom left
+  // of a viewport of the given size, onto the pick buffer
+  static glm::mat4 pickMatrix(glm::ivec2 pixel, glm::ivec2 viewport);
+
+  // Binds the framebuffer and viewport the pick pass draws into, cleared to
+  // (0, 0), which means nothing was hit
+  void begin();
+  // Starts reading the ids back, then binds framebuffer again. A pass still
+  // being read is dropped.
+  void end(GLuint framebuffer);
+
+  bool isPending() const; // A pass has ended but its ids were not taken yet
+  // Takes the ids the last pass wrote, if the GPU has finished it. Never
+  // waits for the GPU.
+  bool takeResult(glm::ivec2 *id);
+  void destroy();
+
+private:
+  RenderContext *context;
+  GLuint framebuffer;
+  GLuint idBuffer;    // GL_RG32I renderbuffer
+  GLuint depthBuffer; // GL_DEPTH_COMPONENT24 renderbuffer
+  GLuint pixelBuffer; // GL_PIXEL_PACK_BUFFER the pixel is copied into
+  GLsync fence;       // Signaled once the copy is done, null if none pending
+};
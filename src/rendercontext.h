@@ -0,0 +1,37 @@
+#pragma once
+
+#include "glstate.h"
+#include "gputimers.h"
+
+#include <QOpenGLContext>
+#include <QOpenGLFunctions_3_2_Core>
+
+/**
+ * The OpenGL functions and per-context bookkeeping that drawables, shader
+ * programs and the joint palette draw through.
+ *
+ * Nothing here depends on a window: OpenGLContext provides one for the
+ * viewport widget and OffscreenRenderer another for rendering headless, and
+ * both draw the same scene classes.
+ */
+class RenderContext : public QOpenGLFunctions_3_2_Core {
+public:
+  RenderContext();
+  virtual ~RenderContext();
+
+  // The Qt context the functions were resolved from
+  virtual QOpenGLContext *glContext() const = 0;
+
+  void printGLErrorLog();
+  void printLinkInfoLog(int prog);
+  void printShaderInfoLog(int shader);
+
+  // Bindings set through here skip GL calls that would change nothing
+  GLState &glState();
+  // Times draws on the GPU for the frame profile
+  GpuTimers &gpuTimers();
+
+private:
+  GLState m_glState;
+  GpuTimers m_gpuTimers;
+};
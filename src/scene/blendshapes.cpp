@@ -0,0 +1,139 @@
+#include "blendshapes.h"
+
+#include "parallel.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace {
+// Vertices per parallel block
+constexpr size_t BlockSize = 16384;
+
+// The cached sum is rebuilt after this many incremental updates
+constexpr int RebuildInterval = 256;
+
+// Adds weight times the offsets shape has for vertices in [begin, end)
+void accumulate(const BlendShape &shape, float weight, size_t begin,
+                size_t end, glm::vec3 *out) {
+  auto first = std::lower_bound(shape.indices.begin(), shape.indices.end(),
+                                int(begin));
+  auto last = std::lower_bound(first, shape.indices.end(), int(end));
+  const glm::vec3 *offset =
+      shape.offsets.data() + (first - shape.indices.begin());
+  for (auto it = first; it != last; ++it, ++offset) {
+    out[*it] += weight * *offset;
+  }
+}
+} // namespace
+
+BlendShape BlendShape::fromPoints(const std::string &name,
+                                  const glm::vec3 *rest,
+                                  const glm::vec3 *target, size_t count,
+                                  float tolerance) {
+  BlendShape shape;
+  shape.name = name;
+  for (size_t i = 0; i < count; ++i) {
+    glm::vec3 offset = target[i] - rest[i];
+    if (glm::length(offset) > tolerance) {
+      shape.indices.push_back(i);
+      shape.offsets.push_back(offset);
+    }
+  }
+  return shape;
+}
+
+BlendShapeSet::BlendShapeSet()
+    : targets(), weights(), summedWeights(), sum(), incrementalUpdates(0) {}
+
+int BlendShapeSet::addTarget(BlendShape shape) {
+  targets.push_back(mkS<const BlendShape>(std::move(shape)));
+  weights.push_back(0);
+  summedWeights.push_back(0);
+  return targets.size() - 1;
+}
+
+int BlendShapeSet::getTargetCount() const { return targets.size(); }
+
+const BlendShape &BlendShapeSet::getTarget(int target) const {
+  return *targets[target];
+}
+
+const std::vector<sPtr<const BlendShape>> &BlendShapeSet::getTargets() const {
+  return targets;
+}
+
+float BlendShapeSet::getWeight(int target) const { return weights[target]; }
+
+const std::vector<float> &BlendShapeSet::getWeights() const {
+  return weights;
+}
+
+void BlendShapeSet::setWeight(int target, float weight) {
+  weights[target] = weight;
+}
+
+bool BlendShapeSet::isActive() const {
+  for (size_t t = 0; t < targets.size(); ++t) {
+    if (weights[t] != 0 || summedWeights[t] != 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void BlendShapeSet::update(size_t count, std::vector<int> *moved) {
+  // starting over sums every weighted target again; the vertices only the
+  // old sum offset are reported here
+  if (sum.size() != count || incrementalUpdates >= RebuildInterval) {
+    for (size_t t = 0; t < targets.size(); ++t) {
+      const std::vector<int> &indices = targets[t]->indices;
+      if (summedWeights[t] != 0 && weights[t] == 0) {
+        moved->insert(moved->end(), indices.begin(), indices.end());
+      }
+    }
+    sum.assign(count, glm::vec3(0));
+    std::fill(summedWeights.begin(), summedWeights.end(), 0.f);
+    incrementalUpdates = 0;
+  }
+
+  // only targets whose weight moved since the last call are summed again
+  std::vector<std::pair<const BlendShape *, float>> changes;
+  for (size_t t = 0; t < targets.size(); ++t) {
+    if (weights[t] != summedWeights[t]) {
+      changes.push_back({targets[t].get(), weights[t] - summedWeights[t]});
+      summedWeights[t] = weights[t];
+    }
+  }
+  if (changes.empty()) {
+    return;
+  }
+  ++incrementalUpdates;
+
+  parallel::forBlocks(count, BlockSize, [&](size_t begin, size_t end) {
+    for (auto &change : changes) {
+      accumulate(*change.first, change.second, begin, end, sum.data());
+    }
+  });
+  for (auto &change : changes) {
+    moved->insert(moved->end(), change.first->indices.begin(),
+                  change.first->indices.end());
+  }
+}
+
+const glm::vec3 &BlendShapeSet::getOffset(int vert) const {
+  return sum[vert];
+}
+
+void BlendShapeSet::evaluate(const std::vector<sPtr<const BlendShape>> &targets,
+                             const std::vector<float> &weights,
+                             const glm::vec3 *rest, size_t count,
+                             glm::vec3 *out) {
+  parallel::forBlocks(count, BlockSize, [&](size_t begin, size_t end) {
+    std::copy(rest + begin, rest + end, out + begin);
+    for (size_t t = 0; t < targets.size(); ++t) {
+      if (weights[t] != 0) {
+        accumulate(*targets[t], weights[t], begin, end, out);
+      }
+    }
+  });
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "smartpointerhelp.h"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// A morph target, stored sparsely as offsets for just the vertices it moves
+struct BlendShape {
+  std::string name;
+  std::vector<int> indices;       // Vertices it moves, ascending
+  std::vector<glm::vec3> offsets; // Added to those vertices at full weight
+
+  // The target moving each rest position to the matching target position.
+  // Vertices that move by no more than tolerance are left out.
+  static BlendShape fromPoints(const std::string &name, const glm::vec3 *rest,
+                               const glm::vec3 *target, size_t count,
+                               float tolerance = 1e-6f);
+};
+
+/**
+ * The morph targets of a mesh and their weights, applied to the rest
+ * positions ahead of skinning.
+ *
+ * The weighted sum of every target's offsets is cached per vertex. When
+ * weights change, only the targets whose weight changed are summed again,
+ * by the difference from the weight already in the sum, and only the
+ * vertices they move are reported, so dragging one weight costs as much as
+ * that target moves rather than the whole mesh. The sum is rebuilt from
+ * scratch now and then so rounding cannot pile up.
+ *
+ * Vertices are split into blocks summed in parallel. Each target's entries
+ * for a block are found by binary search in its sorted indices, so no two
+ * threads write the same vertex.
+ */
+class BlendShapeSet {
+public:
+  BlendShapeSet();
+
+  int addTarget(BlendShape shape); // Returns its index; its weight starts at 0
+  int getTargetCount() const;
+  const BlendShape &getTarget(int target) const;
+  // Targets are immutable once added, so snapshots can share them
+  const std::vector<sPtr<const BlendShape>> &getTargets() const;
+
+  float getWeight(int target) const;
+  const std::vector<float> &getWeights() const; // Indexed by target
+  void setWeight(int target, float weight);
+
+  // Whether any vertex may be offset: some weight, or some weight still in
+  // the cached sum, is not 0
+  bool isActive() const;
+  // Brings the cached sum for count vertices up to date with the weights,
+  // appending every vertex whose offset changed to moved
+  void update(size_t count, std::vector<int> *moved);
+  // The weighted offset of a vertex as of the last update()
+  const glm::vec3 &getOffset(int vert) const;
+
+  // The same without the cache, for callers on other threads
+  static void evaluate(const std::vector<sPtr<const BlendShape>> &targets,
+                       const std::vector<float> &weights,
+                       const glm::vec3 *rest, size_t count, glm::vec3 *out);
+
+private:
+  std::vector<sPtr<const BlendShape>> targets;
+  std::vector<float> weights;
+  std::vector<float> summedWeights; // Weight each target has in sum
+  std::vector<glm::vec3> sum;       // Weighted offsets, per vertex
+  int incrementalUpdates;           // Changes summed since the last rebuild
+};
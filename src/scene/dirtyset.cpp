@@ -0,0 +1,36 @@
+#include "dirtyset.h"
+
+DirtySet::DirtySet() : all(true), indices(), marked() {}
+
+void DirtySet::mark(int index) {
+  if (all) {
+    return;
+  }
+  if (index >= (int)marked.size()) {
+    marked.resize(index + 1, 0);
+  }
+  if (!marked[index]) {
+    marked[index] = 1;
+    indices.push_back(index);
+  }
+}
+
+void DirtySet::markAll() {
+  all = true;
+  indices.clear();
+  marked.clear();
+}
+
+bool DirtySet::isAll() const { return all; }
+
+const std::vector<int> &DirtySet::getIndices() const { return indices; }
+
+void DirtySet::clear() {
+  // only the marked bytes need resetting, which keeps this proportional to
+  // the number of changes rather than to the size of the mesh
+  for (int i : indices) {
+    marked[i] = 0;
+  }
+  indices.clear();
+  all = false;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * The indices of the elements that changed since some consumer last caught
+ * up, each listed once.
+ *
+ * A set starts out (and can be put back) in the "everything" state, in which
+ * marking is free and nothing is stored, for consumers that have no copy to
+ * patch yet. Otherwise it holds at most one entry per element, however often
+ * an element is marked.
+ */
+class DirtySet {
+public:
+  DirtySet();
+
+  void mark(int index);
+  void markAll();
+  bool isAll() const;
+  // The marked indices in the order they were first marked; empty if isAll()
+  const std::vector<int> &getIndices() const;
+  void clear(); // Forgets every mark, leaving nothing dirty
+
+private:
+  bool all;
+  std::vector<int> indices;
+  std::vector<uint8_t> marked; // Whether each index is in indices
+};
@@ -1,10 +1,12 @@
 #include "mesh.h"
 
+#include "frameprofile.h"
 #include "meshdata/vertex.h"
+#include "skeletondata/boneweights.h"
 #include "utils.h"
 
-#include <pxr/usd/usd/common.h>
-
+#include <algorithm>
+#include <limits>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -15,7 +17,15 @@ uint64_t PairHash::operator()(const std::pair<Vertex *, Vertex *> p) const {
   return addr1 ^ addr2;
 }
 
-Mesh::Mesh(OpenGLContext *mp_context, QFile &file) : Drawable(mp_context) {
+int Mesh::nextLayoutVersion = 1;
+
+Mesh::Mesh(RenderContext *mp_context, QFile &file)
+    : Drawable(mp_context), skeletonRoot(nullptr), cpuPose(nullptr),
+      cpuMode(SkinningMode::LINEAR), history(), delta(nullptr),
+      deltaDepth(0), published(), dirtyVerts(), dirtyFaces(),
+      topologyDirty(true), chunks(), staleVerts(), staleFaces(),
+      layoutStale(true), visible(), culled(false), layoutVersion(0),
+      litVerts(), skinnedVerts(), skinnedVerts8() {
 
   // parse the file, fill these vectors
   std::vector<glm::vec3> fileVerts;
@@ -29,103 +39,214 @@ Mesh::Mesh(OpenGLContext *mp_context, QFile &file) : Drawable(mp_context) {
 Mesh::~Mesh() {}
 
 void Mesh::create() {
-  // create new vectors
-  std::vector<glm::vec4> pos, nor, col;
-  std::vector<GLuint> idx;
+  frameprofile::Scope profile("Mesh::create");
+
+  // skeleton stuff, with the wide vertex only when some vertex needs more
+  // than four influences
+  bool gpuSkinned = isBound() && !cpuPose;
+  bool wide = false;
+  if (gpuSkinned) {
+    for (auto &vert : verts) {
+      wide |= vert->getInfluence().count > 4;
+    }
+  }
+  VertexLayout vertLayout = !gpuSkinned ? LitVertex::layout()
+                            : wide      ? SkinnedVertex8::layout()
+                                        : SkinnedVertex::layout();
+
+  // when skinning on the CPU, pose every vertex up front; otherwise just
+  // apply the blend shapes, which come before skinning, to the vertices
+  // they move. With every weight at 0, the rest positions are drawn as is.
+  static const std::vector<glm::vec3> unposed;
+  std::vector<glm::vec3> cpuPosed;
+  bool cpuSkinned = isBound() && cpuPose;
+  bool shaped = !cpuSkinned && blendShapes.isActive();
+  if (cpuSkinned) {
+    cpuPosed = posedPositions(*cpuPose, cpuMode);
+  } else if (shaped) {
+    updateShaped();
+  } else {
+    shapedVerts.clear();
+  }
+  const std::vector<glm::vec3> &posed = cpuSkinned ? cpuPosed
+                                        : shaped   ? shapedVerts
+                                                   : unposed;
+
+  // new topology or a new vertex format means writing everything, and so
+  // does a pose, which moves every vertex; otherwise only the chunks using
+  // what changed are written
+  bool full = layoutStale || vertLayout != layout;
+  if (layoutStale) {
+    layoutChunks(posed);
+    layoutStale = false;
+    culled = false;
+  }
+  bool rewriteAll = full || cpuSkinned;
+  if (rewriteAll) {
+    chunks.markAll();
+  } else {
+    for (int i : staleVerts) {
+      chunks.markVertex(i);
+    }
+    for (int i : staleFaces) {
+      chunks.markFace(i);
+    }
+  }
+  staleVerts.clear();
+  staleFaces.clear();
+
+  if (full) {
+    int vertCount = chunks.getVertCount();
+    litVerts.clear();
+    skinnedVerts.clear();
+    skinnedVerts8.clear();
+    if (gpuSkinned && wide) {
+      skinnedVerts8.resize(vertCount);
+    } else if (gpuSkinned) {
+      skinnedVerts.resize(vertCount);
+    } else {
+      litVerts.resize(vertCount);
+    }
+  }
 
-  // skeleton stuff
-  std::vector<glm::ivec2> ids;
-  std::vector<glm::vec2> weights;
+  const void *base = litVerts.data();
+  if (gpuSkinned && wide) {
+    base = skinnedVerts8.data();
+  } else if (gpuSkinned) {
+    base = skinnedVerts.data();
+  }
+  const unsigned char *data = static_cast<const unsigned char *>(base);
+  GLsizei stride = vertLayout.stride;
 
-  int totalVerts = 0;
+  for (int c = 0; c < chunks.getChunkCount(); ++c) {
+    MeshChunks::Chunk &chunk = chunks.getChunk(c);
+    if (!chunk.dirty) {
+      continue;
+    }
+    writeChunk(chunk, posed, gpuSkinned, wide);
+    if (!rewriteAll) {
+      updateVert(chunk.firstVert * stride, data + chunk.firstVert * stride,
+                 chunk.vertCount * stride);
+    }
+  }
+
+  // VBO time! Writing every chunk still only uploads the bytes that differ
+  if (full) {
+    const std::vector<GLuint> &idx = chunks.getIndices();
+    count = idx.size();
+    uploadIdx(idx.data(), idx.size() * sizeof(GLuint));
+  }
+  if (rewriteAll) {
+    uploadVert(vertLayout, data, GLsizeiptr(chunks.getVertCount()) * stride);
+  }
+}
+
+void Mesh::layoutChunks(const std::vector<glm::vec3> &posed) {
+  std::vector<glm::vec3> centroids(faces.size());
+  std::vector<int> faceStarts(1, 0), faceVerts;
   for (auto &face : faces) {
+    glm::vec3 sum(0);
+    HalfEdge *edge = face->edge;
+    do {
+      sum += drawnPos(edge->nextVert, posed);
+      faceVerts.push_back(edge->nextVert->index);
+      edge = edge->nextEdge;
+    } while (edge != face->edge);
+    centroids[face->index] = sum / float(faceVerts.size() - faceStarts.back());
+    faceStarts.push_back(faceVerts.size());
+  }
+  chunks.build(centroids, faceStarts, faceVerts, verts.size());
+  layoutVersion = nextLayoutVersion++;
+}
+
+void Mesh::writeChunk(MeshChunks::Chunk &chunk,
+                      const std::vector<glm::vec3> &posed, bool gpuSkinned,
+                      bool wide) {
+  glm::vec3 lo(std::numeric_limits<float>::max()), hi(-lo);
+  chunk.joints.clear();
+
+  int out = chunk.firstVert;
+  const std::vector<int> &order = chunks.getOrder();
+  for (int i = chunk.firstFace; i < chunk.firstFace + chunk.faceCount; ++i) {
+    Face *face = faces[order[i]].get();
+
     // grab our face's associated half-edge
     HalfEdge *prevEdge = face->edge;
     HalfEdge *currEdge = prevEdge->nextEdge;
-    int faceVerts = 0;
+
+    glm::u8vec4 col = packColor(glm::vec4(face->color, 0));
 
     // loop through half-edges
     do {
-      // add position
-      pos.push_back(glm::vec4(currEdge->nextVert->pos, 1));
+      Vertex *vert = currEdge->nextVert;
 
       // add normal
-      glm::vec3 &prevVert = prevEdge->nextVert->pos;
-      glm::vec3 &currVert = currEdge->nextVert->pos;
-      glm::vec3 &nextVert = currEdge->nextEdge->nextVert->pos;
+      const glm::vec3 &prevVert = drawnPos(prevEdge->nextVert, posed);
+      const glm::vec3 &currVert = drawnPos(vert, posed);
+      const glm::vec3 &nextVert = drawnPos(currEdge->nextEdge->nextVert, posed);
 
       // TODO: this may be the wrong calculation
-      nor.push_back(glm::vec4(
-          glm::normalize(glm::cross(currVert - prevVert, nextVert - currVert)),
-          0));
-
-      // add color
-      col.push_back(glm::vec4(face->color, 0));
-
-      // joint stuff
-      if (isBound()) {
-        ids.push_back(glm::ivec2(currEdge->nextVert->joint1Idx,
-                                 currEdge->nextVert->joint2Idx));
-        weights.push_back(glm::vec2(currEdge->nextVert->joint1Weight,
-                                    currEdge->nextVert->joint2Weight));
+      glm::i8vec4 nor = packNormal(
+          glm::normalize(glm::cross(currVert - prevVert, nextVert - currVert)));
+
+      lo = glm::min(lo, currVert);
+      hi = glm::max(hi, currVert);
+
+      // add position and color, plus joint stuff if bound
+      if (gpuSkinned) {
+        const SkinInfluence &infl = vert->getInfluence();
+        const uint16_t *j = infl.joints, *w = infl.weights;
+        if (wide) {
+          skinnedVerts8[out] = {currVert,
+                                nor,
+                                col,
+                                {glm::u16vec4(j[0], j[1], j[2], j[3]),
+                                 glm::u16vec4(j[4], j[5], j[6], j[7])},
+                                {glm::u16vec4(w[0], w[1], w[2], w[3]),
+                                 glm::u16vec4(w[4], w[5], w[6], w[7])}};
+        } else {
+          skinnedVerts[out] = {currVert, nor, col,
+                               glm::u16vec4(j[0], j[1], j[2], j[3]),
+                               glm::u16vec4(w[0], w[1], w[2], w[3])};
+        }
+        chunk.joints.insert(chunk.joints.end(), j, j + infl.count);
+      } else {
+        litVerts[out] = {currVert, nor, col};
       }
 
-      // increment edge and num of face verts
+      // increment edge and output vertex
       prevEdge = currEdge;
       currEdge = currEdge->nextEdge;
-      ++faceVerts;
+      ++out;
 
     } while (prevEdge != face->edge);
-
-    // add indices
-    for (int i = 0; i < faceVerts - 2; ++i) {
-      idx.push_back(totalVerts);
-      idx.push_back(totalVerts + i + 1);
-      idx.push_back(totalVerts + i + 2);
-    }
-
-    totalVerts += faceVerts;
   }
 
-  // VBO time!
-  count = idx.size();
-
-  generateIdx();
-  mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bufIdx);
-  mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, idx.size() * sizeof(GLuint),
-                           idx.data(), GL_STATIC_DRAW);
-
-  generatePos();
-  mp_context->glBindBuffer(GL_ARRAY_BUFFER, bufPos);
-  mp_context->glBufferData(GL_ARRAY_BUFFER, pos.size() * sizeof(glm::vec4),
-                           pos.data(), GL_STATIC_DRAW);
-
-  generateNor();
-  mp_context->glBindBuffer(GL_ARRAY_BUFFER, bufNor);
-  mp_context->glBufferData(GL_ARRAY_BUFFER, nor.size() * sizeof(glm::vec4),
-                           nor.data(), GL_STATIC_DRAW);
-
-  generateCol();
-  mp_context->glBindBuffer(GL_ARRAY_BUFFER, bufCol);
-  mp_context->glBufferData(GL_ARRAY_BUFFER, col.size() * sizeof(glm::vec4),
-                           col.data(), GL_STATIC_DRAW);
+  std::sort(chunk.joints.begin(), chunk.joints.end());
+  chunk.joints.erase(std::unique(chunk.joints.begin(), chunk.joints.end()),
+                     chunk.joints.end());
+  chunk.lo = lo;
+  chunk.hi = hi;
+  chunk.dirty = false;
+}
 
-  if (isBound()) {
-    generateJointIdx();
-    mp_context->glBindBuffer(GL_ARRAY_BUFFER, bufJointIdx);
-    mp_context->glBufferData(GL_ARRAY_BUFFER, ids.size() * sizeof(glm::ivec2),
-                             &ids[0], GL_STATIC_DRAW);
+GLenum Mesh::drawMode() { return GL_TRIANGLES; }
 
-    generateJointWgt();
-    mp_context->glBindBuffer(GL_ARRAY_BUFFER, bufJointWgt);
-    mp_context->glBufferData(GL_ARRAY_BUFFER,
-                             weights.size() * sizeof(glm::vec2), &weights[0],
-                             GL_STATIC_DRAW);
+const DrawRanges *Mesh::getDrawRanges() { return culled ? &visible : nullptr; }
+
+void Mesh::cull(const glm::mat4 &viewProj,
+                const std::vector<glm::mat4> *palette, SkinningMode mode) {
+  frameprofile::Scope profile("Mesh::cull");
+  // rest bounds say nothing about a mesh skinned on the GPU, and the
+  // palette only bounds it when blended linearly
+  bool gpuSkinned = isBound() && !cpuPose;
+  culled = !layoutStale &&
+           (!gpuSkinned || (palette && mode == SkinningMode::LINEAR));
+  if (culled) {
+    chunks.cull(viewProj, gpuSkinned ? palette : nullptr, &visible);
   }
 }
 
-GLenum Mesh::drawMode() { return GL_TRIANGLES; }
-
 Vertex *Mesh::splitEdge(HalfEdge *edge, glm::vec3 pos) {
   // make sure edge is in this mesh
   if (!containsEdge(edge)) {
@@ -133,6 +254,8 @@ Vertex *Mesh::splitEdge(HalfEdge *edge, glm::vec3 pos) {
     return nullptr;
   }
 
+  beginDelta("Split Edge");
+
   HalfEdge *sym = edge->sym;
 
   // get average point
@@ -151,21 +274,23 @@ Vertex *Mesh::splitEdge(HalfEdge *edge, glm::vec3 pos) {
   newSymEdge->sym = edge;
 
   newVert->edge = edge;
-  edge->nextVert->edge = newEdge.get();
-  sym->nextVert->edge = newSymEdge.get();
+  rewire(edge->nextVert->edge, newEdge.get());
+  rewire(sym->nextVert->edge, newSymEdge.get());
 
-  edge->nextVert = newVert.get();
-  edge->nextEdge = newEdge.get();
-  edge->sym = newSymEdge.get();
+  rewire(edge->nextVert, newVert.get());
+  rewire(edge->nextEdge, newEdge.get());
+  rewire(edge->sym, newSymEdge.get());
 
-  sym->nextVert = newVert.get();
-  sym->nextEdge = newSymEdge.get();
-  sym->sym = newEdge.get();
+  rewire(sym->nextVert, newVert.get());
+  rewire(sym->nextEdge, newSymEdge.get());
+  rewire(sym->sym, newEdge.get());
 
   Vertex *newVertPtr = newVert.get();
-  verts.push_back(std::move(newVert));
-  edges.push_back(std::move(newEdge));
-  edges.push_back(std::move(newSymEdge));
+  addVertex(std::move(newVert));
+  addEdge(std::move(newEdge));
+  addEdge(std::move(newSymEdge));
+
+  endDelta();
 
   return newVertPtr;
 }
@@ -187,6 +312,8 @@ void Mesh::triangulateFace(Face *face) {
     return;
   }
 
+  beginDelta("Triangulate Face");
+
   HalfEdge *rootPrevEdge = face->edge; // edge connecting to rootVert
   while (rootPrevEdge->nextEdge != face->edge) {
     rootPrevEdge = rootPrevEdge->nextEdge;
@@ -216,30 +343,34 @@ void Mesh::triangulateFace(Face *face) {
     newEdge->sym = newSymEdge.get();
     newSymEdge->sym = newEdge.get();
 
-    edge->nextEdge = newEdge.get();
-    rootPrevEdge->nextEdge = newSymEdge.get();
+    rewire(edge->nextEdge, newEdge.get());
+    rewire(rootPrevEdge->nextEdge, newSymEdge.get());
 
     newFace->edge = newEdge.get();
-    face->edge = newSymEdge.get();
+    rewire(face->edge, newSymEdge.get());
 
     // assign new face to all right side edges
     HalfEdge *iterEdge = edge;
     do {
-      iterEdge->face = newFace.get();
+      rewire(iterEdge->face, newFace.get());
       iterEdge = iterEdge->nextEdge;
     } while (iterEdge != edge);
 
-    faces.push_back(std::move(newFace));
-    edges.push_back(std::move(newEdge));
-    edges.push_back(std::move(newSymEdge));
+    addFace(std::move(newFace));
+    addEdge(std::move(newEdge));
+    addEdge(std::move(newSymEdge));
 
     // iterate
     prevEdge = face->edge;
     edge = originalNext;
   }
+
+  endDelta();
 }
 
 void Mesh::catmullClarkSubdivide() {
+  beginDelta("Subdivide Mesh");
+
   int initialVertCount = verts.size();
   int initialHalfEdgeCount = edges.size();
   int initialFaceCount = faces.size();
@@ -260,8 +391,7 @@ void Mesh::catmullClarkSubdivide() {
     } while (edge != face->edge);
     avg /= (float)count;
 
-    verts.push_back(mkU<Vertex>(avg));
-    centroids[face.get()] = verts.back().get();
+    centroids[face.get()] = addVertex(mkU<Vertex>(avg));
   }
 
   // split edges, store pointers to edges
@@ -312,9 +442,10 @@ void Mesh::catmullClarkSubdivide() {
       edge = edge->sym;
     } while (edge != vert->edge);
 
-    vert->pos =
-        ((adjMidpointCount - 2.f) / (float)adjMidpointCount) * vert->pos +
-        midpointAndFaceSum / (float)(adjMidpointCount * adjMidpointCount);
+    movePos(vert.get(),
+            ((adjMidpointCount - 2.f) / (float)adjMidpointCount) * vert->pos +
+                midpointAndFaceSum /
+                    (float)(adjMidpointCount * adjMidpointCount));
   }
 
   // quadrangulate faces
@@ -333,23 +464,71 @@ void Mesh::catmullClarkSubdivide() {
     // quadrangulate!
     quadrangulateFace(face.get(), centroids[face.get()], splitEdges);
   }
+
+  endDelta();
+}
+
+void Mesh::setVertexPos(Vertex *vert, glm::vec3 pos) {
+  beginDelta("Move Vertex", vert);
+  movePos(vert, pos);
+  endDelta();
+}
+
+void Mesh::setFaceColor(Face *face, glm::vec3 color) {
+  beginDelta("Recolor Face", face);
+  moveColor(face, color);
+  endDelta();
+}
+
+bool Mesh::undo() {
+  MeshDelta *d = history.stepBack();
+  if (!d) {
+    return false;
+  }
+  size_t oldSize = d->getByteSize();
+  undoDelta(*d);
+  history.resized(*d, oldSize);
+  return true;
+}
+
+bool Mesh::redo() {
+  MeshDelta *d = history.stepForward();
+  if (!d) {
+    return false;
+  }
+  size_t oldSize = d->getByteSize();
+  redoDelta(*d);
+  history.resized(*d, oldSize);
+  return true;
 }
 
-void Mesh::bindSkeleton(Joint *root) {
+const MeshHistory &Mesh::getHistory() const { return history; }
+
+void Mesh::bindSkeleton(Joint *root, int influenceCount) {
+  // weigh every vertex by its distance to the nearest bones
+  std::vector<glm::vec3> positions(verts.size());
+  for (size_t i = 0; i < verts.size(); ++i) {
+    positions[i] = verts[i]->pos;
+  }
+  std::vector<SkinInfluence> influences(verts.size());
+  boneweights::compute(root->getSkeleton(), positions.data(),
+                       positions.size(), influenceCount, BoneFalloff,
+                       influences.data());
+
+  bindSkeleton(root, influences);
+}
+
+void Mesh::bindSkeleton(Joint *root,
+                        const std::vector<SkinInfluence> &weights) {
   if (skeletonRoot) {
     unbindSkeleton();
   }
   skeletonRoot = root;
 
-  // assign weights to joints
-  std::vector<Joint *> joints;
-  skeletonRoot->getAllJoints(joints);
   for (auto &vert : verts) {
-    vert->assignWeights(joints);
+    vert->setWeights(weights[vert->index]);
+    touchVert(vert->index);
   }
-
-  // VBO time!
-  create();
 }
 
 void Mesh::unbindSkeleton() {
@@ -357,45 +536,173 @@ void Mesh::unbindSkeleton() {
 
   for (auto &vert : verts) {
     vert->clearWeights();
+    touchVert(vert->index);
   }
 }
 
-pxr::UsdGeomMesh Mesh::createUsdMesh(pxr::UsdStagePtr stage,
-                                     const char *path) const {
-  auto pxr_points = pxr::VtArray<pxr::GfVec3f>();
-  auto pxr_indices = pxr::VtArray<int>();
-  auto pxr_vtCounts = pxr::VtArray<int>();
+void Mesh::setCpuPose(const std::vector<glm::mat4> *palette,
+                      SkinningMode mode) {
+  cpuPose = palette;
+  cpuMode = mode;
+}
 
-  // fill points, map from vertices to indices
-  auto vertToIndex = std::unordered_map<Vertex *, int>();
-  for (int i = 0; i < verts.size(); ++i) {
-    Vertex *v = verts[i].get();
-    pxr_points.push_back(pxr::GfVec3f(v->pos.x, v->pos.y, v->pos.z));
-    vertToIndex[v] = i;
+std::vector<glm::vec3>
+Mesh::posedPositions(const std::vector<glm::mat4> &palette,
+                     SkinningMode mode) {
+  std::vector<glm::vec3> rest = shapedPositions(), posed(verts.size());
+  std::vector<SkinInfluence> influences(verts.size());
+  for (size_t i = 0; i < verts.size(); ++i) {
+    influences[i] = verts[i]->getInfluence();
   }
 
-  for (auto &face : faces) {
-    int edgeCount = 0;
-    auto iterEdge = face->edge;
-    do {
-      pxr_indices.push_back(vertToIndex[iterEdge->nextVert]);
-      iterEdge = iterEdge->nextEdge;
-      ++edgeCount;
-    } while (iterEdge != face->edge);
-    pxr_vtCounts.push_back(edgeCount);
+  skinning::pose(mode, palette.data(), palette.size(), influences.data(),
+                 rest.data(), nullptr, verts.size(), posed.data(), nullptr);
+  return posed;
+}
+
+bool Mesh::addBlendShape(QFile &file, const std::string &name,
+                         QString *error) {
+  std::vector<glm::vec3> fileVerts;
+  std::vector<std::vector<int>> fileFaces;
+  parseOBJ(file, &fileVerts, &fileFaces);
+  if (fileVerts.size() != verts.size() || fileFaces.size() != faces.size()) {
+    *error = QString("The target has %1 vertices and %2 faces, but the mesh "
+                     "has %3 and %4")
+                 .arg(fileVerts.size())
+                 .arg(fileFaces.size())
+                 .arg(verts.size())
+                 .arg(faces.size());
+    return false;
+  }
+
+  std::vector<glm::vec3> rest(verts.size());
+  for (size_t i = 0; i < verts.size(); ++i) {
+    rest[i] = verts[i]->pos;
+  }
+  blendShapes.addTarget(BlendShape::fromPoints(name, rest.data(),
+                                               fileVerts.data(), rest.size()));
+  return true;
+}
+
+const BlendShapeSet &Mesh::getBlendShapes() const { return blendShapes; }
+
+void Mesh::setBlendShapeWeight(int target, float weight) {
+  blendShapes.setWeight(target, weight);
+}
+
+std::vector<glm::vec3> Mesh::shapedPositions() {
+  if (blendShapes.isActive()) {
+    updateShaped();
+    return shapedVerts;
+  }
+  std::vector<glm::vec3> rest(verts.size());
+  for (size_t i = 0; i < verts.size(); ++i) {
+    rest[i] = verts[i]->pos;
+  }
+  return rest;
+}
+
+void Mesh::updateShaped() {
+  std::vector<int> moved;
+  blendShapes.update(verts.size(), &moved);
+  auto reshape = [&](int i) {
+    shapedVerts[i] = verts[i]->pos + blendShapes.getOffset(i);
+  };
+
+  if (shapedVerts.size() != verts.size()) {
+    shapedVerts.resize(verts.size());
+    for (size_t i = 0; i < verts.size(); ++i) {
+      reshape(i);
+    }
+  } else {
+    for (int i : staleVerts) {
+      if (i < (int)verts.size()) {
+        reshape(i);
+      }
+    }
+    for (int i : moved) {
+      reshape(i);
+    }
+  }
+  // the next create() writes the chunks of whatever the weights moved
+  staleVerts.insert(staleVerts.end(), moved.begin(), moved.end());
+}
+
+MeshSnapshot Mesh::snapshot() {
+  // positions and colors are patched in place, which only clones the chunks
+  // they fall in if an older snapshot still shares them. Until the first
+  // snapshot, nothing is tracked and everything is copied.
+  published.points.resize(verts.size());
+  published.influences.resize(verts.size());
+  auto publishVert = [&](int i) {
+    published.points.set(i, verts[i]->pos);
+    published.influences.set(i, verts[i]->getInfluence());
+  };
+  if (dirtyVerts.isAll()) {
+    for (size_t i = 0; i < verts.size(); ++i) {
+      publishVert(i);
+    }
+  }
+  for (int i : dirtyVerts.getIndices()) {
+    if (i < (int)verts.size()) {
+      publishVert(i);
+    }
+  }
+  dirtyVerts.clear();
+  published.bound = isBound();
+  published.blendShapes = blendShapes.getTargets();
+  published.blendShapeWeights = blendShapes.getWeights();
+
+  published.faceColors.resize(faces.size());
+  if (dirtyFaces.isAll()) {
+    for (size_t i = 0; i < faces.size(); ++i) {
+      published.faceColors.set(i, faces[i]->color);
+    }
+  }
+  for (int i : dirtyFaces.getIndices()) {
+    if (i < (int)faces.size()) {
+      published.faceColors.set(i, faces[i]->color);
+    }
   }
+  dirtyFaces.clear();
+
+  // topology edits can rewire faces anywhere in the mesh, so face loops are
+  // regenerated, but blocks that come out unchanged keep sharing storage
+  if (topologyDirty) {
+    size_t blockCount = (faces.size() + MeshSnapshot::FacesPerBlock - 1) /
+                        MeshSnapshot::FacesPerBlock;
+    std::vector<sPtr<const MeshSnapshot::FaceBlock>> blocks(blockCount);
+
+    for (size_t b = 0; b < blockCount; ++b) {
+      auto block = mkS<MeshSnapshot::FaceBlock>();
+      size_t end =
+          std::min(faces.size(), (b + 1) * MeshSnapshot::FacesPerBlock);
+      for (size_t f = b * MeshSnapshot::FacesPerBlock; f < end; ++f) {
+        int count = 0;
+        HalfEdge *edge = faces[f]->edge;
+        do {
+          block->indices.push_back(edge->nextVert->index);
+          edge = edge->nextEdge;
+          ++count;
+        } while (edge != faces[f]->edge);
+        block->counts.push_back(count);
+      }
 
-  pxr::UsdGeomMesh usdMesh =
-      pxr::UsdGeomMesh::Define(stage, pxr::SdfPath(path));
+      if (b < published.faceBlocks.size() &&
+          *published.faceBlocks[b] == *block) {
+        blocks[b] = published.faceBlocks[b];
+      } else {
+        blocks[b] = block;
+      }
+    }
 
-  auto pointsAttr = usdMesh.GetPointsAttr();
-  pointsAttr.Set(pxr_points);
-  auto idxAttr = usdMesh.GetFaceVertexIndicesAttr();
-  idxAttr.Set(pxr_indices);
-  auto vtCountsAttr = usdMesh.GetFaceVertexCountsAttr();
-  vtCountsAttr.Set(pxr_vtCounts);
+    published.faceBlocks = std::move(blocks);
+    published.faceCount = faces.size();
+    topologyDirty = false;
+  }
 
-  return usdMesh;
+  ++published.version;
+  return published;
 }
 
 void Mesh::parseOBJ(QFile &file, std::vector<glm::vec3> *verts,
@@ -447,7 +754,7 @@ void Mesh::buildMeshData(const std::vector<glm::vec3> &fileVerts,
                          const std::vector<std::vector<int>> &fileFaces) {
   // fill verts
   for (auto &vertPos : fileVerts) {
-    verts.push_back(mkU<Vertex>(vertPos));
+    addVertex(mkU<Vertex>(vertPos));
   }
 
   // fill faces and half-edges
@@ -462,7 +769,7 @@ void Mesh::buildMeshData(const std::vector<glm::vec3> &fileVerts,
     verts[vertIdxs[0]]->edge = firstEdge.get();
 
     HalfEdge *lastEdge = firstEdge.get();
-    edges.push_back(std::move(firstEdge));
+    addEdge(std::move(firstEdge));
 
     for (unsigned int i = 1; i < vertIdxs.size(); ++i) {
       auto edge = mkU<HalfEdge>();
@@ -474,13 +781,13 @@ void Mesh::buildMeshData(const std::vector<glm::vec3> &fileVerts,
       // set prev edge next to this guy
       lastEdge->nextEdge = edge.get();
       lastEdge = edge.get();
-      edges.push_back(std::move(edge));
+      addEdge(std::move(edge));
     }
 
     // connect last edge to first
     lastEdge->nextEdge = face->edge;
 
-    faces.push_back(std::move(face));
+    addFace(std::move(face));
   }
 
   // hash map bullshit
@@ -534,7 +841,7 @@ void Mesh::buildMeshData(const std::vector<glm::vec3> &fileVerts,
         edge->sym = looseSymEdge.get();
 
         // add to edges vector
-        edges.push_back(std::move(looseSymEdge));
+        addEdge(std::move(looseSymEdge));
       }
 
       prevEdge = edge;
@@ -543,29 +850,16 @@ void Mesh::buildMeshData(const std::vector<glm::vec3> &fileVerts,
   }
 }
 
+// Elements always know their own index, and only ever leave a mesh from the
+// back of its vectors, so one lookup tells whether they are still there
 bool Mesh::containsVertex(Vertex *vert) const {
-  for (auto &v : verts) {
-    if (vert == v.get()) {
-      return true;
-    }
-  }
-  return false;
+  return vert->index < (int)verts.size() && verts[vert->index].get() == vert;
 }
 bool Mesh::containsFace(Face *face) const {
-  for (auto &f : faces) {
-    if (face == f.get()) {
-      return true;
-    }
-  }
-  return false;
+  return face->index < (int)faces.size() && faces[face->index].get() == face;
 }
 bool Mesh::containsEdge(HalfEdge *edge) const {
-  for (auto &e : edges) {
-    if (edge == e.get()) {
-      return true;
-    }
-  }
-  return false;
+  return edge->index < (int)edges.size() && edges[edge->index].get() == edge;
 }
 
 void Mesh::quadrangulateFace(Face *face, Vertex *centroid,
@@ -586,7 +880,7 @@ void Mesh::quadrangulateFace(Face *face, Vertex *centroid,
     newInEdge->face = face;
     newOutEdge->face = face;
 
-    edge->nextEdge = newInEdge.get();
+    rewire(edge->nextEdge, newInEdge.get());
     newInEdge->nextEdge = newOutEdge.get();
     newOutEdge->nextEdge =
         lastEdges[((int)ei - 1 + splitEdges.size()) % splitEdges.size()];
@@ -596,10 +890,10 @@ void Mesh::quadrangulateFace(Face *face, Vertex *centroid,
         splitEdges[((int)ei - 1 + splitEdges.size()) % splitEdges.size()]
             ->nextVert;
 
-    centroid->edge = newInEdge.get();
+    rewire(centroid->edge, newInEdge.get());
 
-    edges.push_back(std::move(newInEdge));
-    edges.push_back(std::move(newOutEdge));
+    addEdge(std::move(newInEdge));
+    addEdge(std::move(newOutEdge));
   }
 
   // assign sym pointers
@@ -608,11 +902,11 @@ void Mesh::quadrangulateFace(Face *face, Vertex *centroid,
     HalfEdge *outEdge =
         splitEdges[((int)ei + 1) % splitEdges.size()]->nextEdge->nextEdge;
 
-    inEdge->sym = outEdge;
-    outEdge->sym = inEdge;
+    rewire(inEdge->sym, outEdge);
+    rewire(outEdge->sym, inEdge);
   }
 
-  face->edge = splitEdges[0];
+  rewire(face->edge, splitEdges[0]);
 
   for (unsigned int i = 1; i < splitEdges.size(); ++i) {
     glm::vec3 newCol =
@@ -623,11 +917,226 @@ void Mesh::quadrangulateFace(Face *face, Vertex *centroid,
     newFace->edge = splitEdges[i];
     HalfEdge *currEdge = splitEdges[i];
     do {
-      currEdge->face = newFace.get();
+      rewire(currEdge->face, newFace.get());
       currEdge = currEdge->nextEdge;
     } while (currEdge != splitEdges[i]);
 
-    faces.push_back(std::move(newFace));
+    addFace(std::move(newFace));
+  }
+}
+
+void Mesh::beginDelta(const QString &label, const void *mergeKey) {
+  if (deltaDepth++ > 0) {
+    return;
+  }
+  delta = mkU<MeshDelta>(label, mergeKey);
+  delta->vertStart = verts.size();
+  delta->faceStart = faces.size();
+  delta->edgeStart = edges.size();
+}
+
+void Mesh::endDelta() {
+  if (--deltaDepth > 0) {
+    return;
+  }
+  uPtr<MeshDelta> finished = std::move(delta);
+
+  // an operation that touched nothing is not worth an undo step
+  bool addedElements = verts.size() > finished->vertStart ||
+                       faces.size() > finished->faceStart ||
+                       edges.size() > finished->edgeStart;
+  if (!addedElements && finished->isEmpty()) {
+    return;
+  }
+
+  finished->edgeRewires.shrink_to_fit();
+  finished->vertRewires.shrink_to_fit();
+  finished->faceRewires.shrink_to_fit();
+  finished->posChanges.shrink_to_fit();
+  finished->colChanges.shrink_to_fit();
+  history.push(std::move(finished));
+}
+
+void Mesh::rewire(HalfEdge *&field, HalfEdge *value) {
+  if (delta && field != value) {
+    delta->edgeRewires.push_back({&field, field, value});
+  }
+  field = value;
+  touchTopology();
+}
+
+void Mesh::rewire(Vertex *&field, Vertex *value) {
+  if (delta && field != value) {
+    delta->vertRewires.push_back({&field, field, value});
+  }
+  field = value;
+  touchTopology();
+}
+
+void Mesh::rewire(Face *&field, Face *value) {
+  if (delta && field != value) {
+    delta->faceRewires.push_back({&field, field, value});
+  }
+  field = value;
+  touchTopology();
+}
+
+void Mesh::movePos(Vertex *vert, glm::vec3 pos) {
+  if (delta) {
+    delta->posChanges.push_back({vert, vert->pos, pos});
+  }
+  vert->pos = pos;
+  touchVert(vert->index);
+}
+
+void Mesh::moveColor(Face *face, glm::vec3 color) {
+  if (delta) {
+    delta->colChanges.push_back({face, face->color, color});
+  }
+  face->color = color;
+  touchFace(face->index);
+}
+
+int Mesh::getVertexCount() const { return verts.size(); }
+
+int Mesh::getFaceCount() const { return faces.size(); }
+
+int Mesh::getLayoutVersion() const { return layoutVersion; }
+
+std::vector<glm::ivec4> Mesh::getSlots() const {
+  std::vector<glm::ivec4> slots;
+  slots.reserve(chunks.getVertCount());
+  // corners are written starting from the one after face->edge's, the same
+  // as in writeChunk()
+  for (int f : chunks.getOrder()) {
+    const Face *face = faces[f].get();
+    int corners = face->getEdgeCount();
+    HalfEdge *edge = face->edge->nextEdge;
+    for (int corner = 0; corner < corners; ++corner) {
+      slots.push_back({edge->nextVert->index, f, corner, corners});
+      edge = edge->nextEdge;
+    }
+  }
+  return slots;
+}
+
+void Mesh::touchVert(int index) {
+  dirtyVerts.mark(index);
+  staleVerts.push_back(index);
+}
+
+void Mesh::touchFace(int index) {
+  dirtyFaces.mark(index);
+  staleFaces.push_back(index);
+}
+
+void Mesh::touchTopology() {
+  topologyDirty = true;
+  layoutStale = true;
+}
+
+const glm::vec3 &Mesh::drawnPos(const Vertex *vert,
+                                const std::vector<glm::vec3> &posed) const {
+  return posed.empty() ? vert->pos : posed[vert->index];
+}
+
+Vertex *Mesh::addVertex(uPtr<Vertex> vert) {
+  vert->index = verts.size();
+  touchVert(vert->index);
+  verts.push_back(std::move(vert));
+  return verts.back().get();
+}
+
+Face *Mesh::addFace(uPtr<Face> face) {
+  face->index = faces.size();
+  touchFace(face->index);
+  touchTopology();
+  faces.push_back(std::move(face));
+  return faces.back().get();
+}
+
+HalfEdge *Mesh::addEdge(uPtr<HalfEdge> edge) {
+  edge->index = edges.size();
+  edges.push_back(std::move(edge));
+  return edges.back().get();
+}
+
+void Mesh::undoDelta(MeshDelta &d) {
+  // restore fields newest-first so each ends up with its original value
+  for (auto it = d.edgeRewires.rbegin(); it != d.edgeRewires.rend(); ++it) {
+    *it->field = it->before;
+  }
+  for (auto it = d.vertRewires.rbegin(); it != d.vertRewires.rend(); ++it) {
+    *it->field = it->before;
+  }
+  for (auto it = d.faceRewires.rbegin(); it != d.faceRewires.rend(); ++it) {
+    *it->field = it->before;
+  }
+  for (auto it = d.posChanges.rbegin(); it != d.posChanges.rend(); ++it) {
+    it->elem->pos = it->before;
+    touchVert(it->elem->index);
+  }
+  for (auto it = d.colChanges.rbegin(); it != d.colChanges.rend(); ++it) {
+    it->elem->color = it->before;
+    touchFace(it->elem->index);
+  }
+
+  // detach the elements the operation appended; deltas are undone in order,
+  // so they are always at the back of each vector
+  for (size_t i = d.vertStart; i < verts.size(); ++i) {
+    d.removedVerts.push_back(std::move(verts[i]));
+  }
+  verts.resize(d.vertStart);
+  for (size_t i = d.faceStart; i < faces.size(); ++i) {
+    d.removedFaces.push_back(std::move(faces[i]));
+  }
+  faces.resize(d.faceStart);
+  for (size_t i = d.edgeStart; i < edges.size(); ++i) {
+    d.removedEdges.push_back(std::move(edges[i]));
+  }
+  edges.resize(d.edgeStart);
+
+  if (!d.edgeRewires.empty() || !d.vertRewires.empty() ||
+      !d.faceRewires.empty() || !d.removedFaces.empty()) {
+    touchTopology();
+  }
+}
+
+void Mesh::redoDelta(MeshDelta &d) {
+  for (auto &vert : d.removedVerts) {
+    addVertex(std::move(vert));
+  }
+  d.removedVerts.clear();
+  for (auto &face : d.removedFaces) {
+    addFace(std::move(face));
+  }
+  d.removedFaces.clear();
+  for (auto &edge : d.removedEdges) {
+    addEdge(std::move(edge));
+  }
+  d.removedEdges.clear();
+
+  if (!d.edgeRewires.empty() || !d.vertRewires.empty() ||
+      !d.faceRewires.empty()) {
+    touchTopology();
+  }
+
+  for (auto &r : d.edgeRewires) {
+    *r.field = r.after;
+  }
+  for (auto &r : d.vertRewires) {
+    *r.field = r.after;
+  }
+  for (auto &r : d.faceRewires) {
+    *r.field = r.after;
+  }
+  for (auto &c : d.posChanges) {
+    c.elem->pos = c.after;
+    touchVert(c.elem->index);
+  }
+  for (auto &c : d.colChanges) {
+    c.elem->color = c.after;
+    touchFace(c.elem->index);
   }
 }
 
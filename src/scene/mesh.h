@@ -1,15 +1,18 @@
 #pragma once
 
+#include "blendshapes.h"
+#include "dirtyset.h"
 #include "drawable.h"
 #include "glm/fwd.hpp"
 #include "meshdata/face.h"
 #include "meshdata/halfedge.h"
 #include "meshdata/vertex.h"
+#include "meshchunks.h"
+#include "meshhistory.h"
+#include "meshsnapshot.h"
 #include "smartpointerhelp.h"
 
 #include <QFile>
-#include <pxr/usd/usd/common.h>
-#include <pxr/usd/usdGeom/mesh.h>
 
 #include <vector>
 
@@ -30,11 +33,41 @@ struct PairHash {
 class Mesh : public Drawable {
 public:
   // Constructs a Mesh instance from a given OBJ file
-  Mesh(OpenGLContext *mp_context, QFile &file);
+  Mesh(RenderContext *mp_context, QFile &file);
   virtual ~Mesh();
 
+  /**
+   * Writes the mesh to its buffers. Only the chunks holding vertices and
+   * faces that changed since the last call are written again, unless the
+   * topology, the vertex format or a pose changed everything.
+   */
   void create() override;
   GLenum drawMode() override;
+  const DrawRanges *getDrawRanges() override;
+
+  /**
+   * Limits drawing to the chunks that may be visible through viewProj, until
+   * the next call or a change of topology. A mesh skinned on the GPU also
+   * needs the palette and mode it is drawn with, and is drawn whole without
+   * a palette or with dual quaternion blending, which the palette can't
+   * bound.
+   */
+  void cull(const glm::mat4 &viewProj,
+            const std::vector<glm::mat4> *palette = nullptr,
+            SkinningMode mode = SkinningMode::LINEAR);
+
+  int getVertexCount() const;
+  int getFaceCount() const;
+  // Changes whenever create() lays out the buffers anew, and is never the
+  // same for two meshes
+  int getLayoutVersion() const;
+  /**
+   * Describes every vertex in the vertex buffer as laid out by the last
+   * create(), which must have been since the last topology change: the index
+   * of the mesh vertex it was written for, the index of its face, its corner
+   * in that face and the face's corner count.
+   */
+  std::vector<glm::ivec4> getSlots() const;
 
   /**
    * Split a given HalfEdge in two, adding and returning
@@ -51,18 +84,142 @@ public:
   void triangulateFace(Face *face); // Triangulate a given face.
   void catmullClarkSubdivide();     // Apply Catmull-Clark subdivision.
 
-  void bindSkeleton(Joint *root);
+  void setVertexPos(Vertex *vert, glm::vec3 pos); // Undoable vertex move
+  void setFaceColor(Face *face, glm::vec3 color); // Undoable recolor
+
+  bool undo(); // Revert the last operation. Returns false if there was none.
+  bool redo(); // Reapply the last undone operation, if any.
+  const MeshHistory &getHistory() const;
+
+  // Binds every vertex to the influenceCount joints with the nearest bones
+  // (at most SkinInfluence::MaxInfluences)
+  void bindSkeleton(Joint *root, int influenceCount = 4);
+  // Binds with precomputed weights, indexed like verts
+  void bindSkeleton(Joint *root, const std::vector<SkinInfluence> &weights);
   void unbindSkeleton();
+  // (Binding and unbinding only mark the vertices stale; the next create()
+  // uploads them.)
 
-  pxr::UsdGeomMesh createUsdMesh(pxr::UsdStagePtr stage,
-                                 const char *path) const;
+  /**
+   * Poses a bound mesh on the CPU with the given skinning palette instead of
+   * in the skeleton shader, so create() uploads posed positions that any
+   * shader can draw. The palette is read on every create(); pass nullptr to
+   * go back to GPU skinning.
+   */
+  void setCpuPose(const std::vector<glm::mat4> *palette,
+                  SkinningMode mode = SkinningMode::LINEAR);
+  // Positions of every vertex posed by palette, indexed like verts
+  std::vector<glm::vec3>
+  posedPositions(const std::vector<glm::mat4> &palette,
+                 SkinningMode mode = SkinningMode::LINEAR);
+
+  /**
+   * Adds a morph target read from an OBJ file with the same vertices as the
+   * one this mesh was loaded from, in the same order. On failure, describes
+   * the problem in error and adds nothing.
+   */
+  bool addBlendShape(QFile &file, const std::string &name, QString *error);
+  const BlendShapeSet &getBlendShapes() const;
+  void setBlendShapeWeight(int target, float weight);
+
+  /**
+   * Publishes the current state of the mesh as an immutable snapshot. Only
+   * the parts that changed since the previous snapshot are copied, so this is
+   * cheap to call after small edits.
+   */
+  MeshSnapshot snapshot();
 
 private:
   std::vector<uPtr<Vertex>> verts;
   std::vector<uPtr<Face>> faces;
   std::vector<uPtr<HalfEdge>> edges;
 
+  // Exponent of the inverse bone distance used to weigh influences
+  static constexpr float BoneFalloff = 2.f;
+
   Joint *skeletonRoot;
+  const std::vector<glm::mat4> *cpuPose; // Palette to skin with on the CPU
+  SkinningMode cpuMode;                  // How to blend it
+
+  BlendShapeSet blendShapes; // Morph targets applied before skinning
+  // Rest positions with the blend shapes applied, while any weight is not 0;
+  // empty otherwise
+  std::vector<glm::vec3> shapedVerts;
+
+  MeshHistory history;   // Undo/redo stacks for edits to this mesh
+  uPtr<MeshDelta> delta; // Delta being recorded by the current operation
+  int deltaDepth;        // Nesting depth of beginDelta() calls
+
+  MeshSnapshot published; // Last snapshot handed out
+  DirtySet dirtyVerts;    // Vertices whose position changed since then
+  DirtySet dirtyFaces;    // Faces whose color changed since then
+  bool topologyDirty;     // Whether any face loop changed since then
+
+  MeshChunks chunks;           // Layout of the buffers written by create()
+  std::vector<int> staleVerts; // The same changes, since the last create()
+  std::vector<int> staleFaces;
+  bool layoutStale;
+  DrawRanges visible; // Chunks that passed the last cull()
+  bool culled;        // Whether visible is up to date with the layout
+  int layoutVersion;
+  static int nextLayoutVersion; // The next layoutVersion to use
+
+  // CPU copy of the vertex buffer, in whichever format create() last used
+  std::vector<LitVertex> litVerts;
+  std::vector<SkinnedVertex> skinnedVerts;
+  std::vector<SkinnedVertex8> skinnedVerts8;
+
+  /**
+   * Starts recording an undoable operation. Calls may nest (e.g. subdivision
+   * splits edges), in which case only the outermost one produces a delta.
+   *
+   * @param mergeKey - if non-null, consecutive operations with the same key
+   * are merged into a single undo step
+   */
+  void beginDelta(const QString &label, const void *mergeKey = nullptr);
+  void endDelta(); // Finishes recording and pushes the delta onto the history
+
+  /**
+   * Sets a pointer field of an element that is already part of this mesh,
+   * recording the change in the current delta. Fields of elements that have
+   * not been added to the mesh yet can be assigned directly.
+   */
+  void rewire(HalfEdge *&field, HalfEdge *value);
+  void rewire(Vertex *&field, Vertex *value);
+  void rewire(Face *&field, Face *value);
+
+  void movePos(Vertex *vert, glm::vec3 pos);   // Recorded position change
+  void moveColor(Face *face, glm::vec3 color); // Recorded color change
+
+  // Note a change for both snapshot() and create()
+  void touchVert(int index);
+  void touchFace(int index);
+  void touchTopology();
+
+  // Where a vertex is drawn: its entry in posed, or its own position if
+  // nothing is posed
+  const glm::vec3 &drawnPos(const Vertex *vert,
+                            const std::vector<glm::vec3> &posed) const;
+  // Sorts the faces into chunks by where they are drawn
+  void layoutChunks(const std::vector<glm::vec3> &posed);
+  // Writes the vertices of a chunk into the CPU copy of the vertex buffer
+  void writeChunk(MeshChunks::Chunk &chunk,
+                  const std::vector<glm::vec3> &posed, bool gpuSkinned,
+                  bool wide);
+
+  // Append an element to this mesh, keeping its index up to date
+  Vertex *addVertex(uPtr<Vertex> vert);
+  Face *addFace(uPtr<Face> face);
+  HalfEdge *addEdge(uPtr<HalfEdge> edge);
+
+  // Rest positions with the blend shapes applied, indexed like verts
+  std::vector<glm::vec3> shapedPositions();
+  // Brings shapedVerts up to date for the positions and weights that changed
+  // since the last call, noting the vertices the weights moved for create()
+  void updateShaped();
+
+  void undoDelta(MeshDelta &d);
+  void redoDelta(MeshDelta &d);
 
   /**
    * Parses the provided .obj file, filling the provided vectors with mesh data.
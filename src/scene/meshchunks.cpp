@@ -0,0 +1,182 @@
+#include "meshchunks.h"
+
+#include "frustum.h"
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+namespace {
+// Moves the low 10 bits of v to every third bit, for interleaving
+uint32_t spreadBits(uint32_t v) {
+  v &= 0x3ff;
+  v = (v | (v << 16)) & 0x030000ff;
+  v = (v | (v << 8)) & 0x0300f00f;
+  v = (v | (v << 4)) & 0x030c30c3;
+  v = (v | (v << 2)) & 0x09249249;
+  return v;
+}
+} // namespace
+
+MeshChunks::MeshChunks()
+    : chunks(), order(), faceChunk(), vertChunks(), vertStarts(), indices(),
+      vertCount(0) {}
+
+void MeshChunks::build(const std::vector<glm::vec3> &centroids,
+                       const std::vector<int> &faceStarts,
+                       const std::vector<int> &faceVerts, int meshVerts) {
+  int faceCount = centroids.size();
+
+  // quantize the centroids to a 1024^3 grid over their bounds
+  glm::vec3 lo(std::numeric_limits<float>::max()), hi(-lo);
+  for (const glm::vec3 &c : centroids) {
+    lo = glm::min(lo, c);
+    hi = glm::max(hi, c);
+  }
+  glm::vec3 scale = 1023.f / glm::max(hi - lo, glm::vec3(1e-6f));
+  std::vector<std::pair<uint32_t, int>> keys(faceCount);
+  for (int f = 0; f < faceCount; ++f) {
+    glm::uvec3 q(glm::clamp((centroids[f] - lo) * scale, 0.f, 1023.f));
+    keys[f] = {spreadBits(q.x) | spreadBits(q.y) << 1 | spreadBits(q.z) << 2,
+               f};
+  }
+  std::sort(keys.begin(), keys.end());
+
+  chunks.clear();
+  indices.clear();
+  order.resize(faceCount);
+  faceChunk.resize(faceCount);
+  vertCount = 0;
+  for (int first = 0; first < faceCount; first += FacesPerChunk) {
+    Chunk chunk;
+    chunk.firstFace = first;
+    chunk.faceCount = std::min(FacesPerChunk, faceCount - first);
+    chunk.firstVert = vertCount;
+    chunk.firstIdx = indices.size();
+    chunk.lo = chunk.hi = glm::vec3(0);
+    chunk.dirty = true;
+
+    for (int i = first; i < first + chunk.faceCount; ++i) {
+      int f = keys[i].second;
+      order[i] = f;
+      faceChunk[f] = chunks.size();
+
+      // every face is fanned from its first vertex
+      int n = faceStarts[f + 1] - faceStarts[f];
+      for (int k = 0; k < n - 2; ++k) {
+        indices.push_back(vertCount);
+        indices.push_back(vertCount + k + 1);
+        indices.push_back(vertCount + k + 2);
+      }
+      vertCount += n;
+    }
+
+    chunk.vertCount = vertCount - chunk.firstVert;
+    chunk.idxCount = indices.size() - chunk.firstIdx;
+    chunks.push_back(std::move(chunk));
+  }
+
+  // most vertices are used by a single chunk, and those on a chunk's border
+  // by a few, so the chunks of every vertex are kept in one flat list
+  std::vector<std::pair<int, int>> uses;
+  uses.reserve(faceVerts.size());
+  for (int f = 0; f < faceCount; ++f) {
+    for (int i = faceStarts[f]; i < faceStarts[f + 1]; ++i) {
+      uses.push_back({faceVerts[i], faceChunk[f]});
+    }
+  }
+  std::sort(uses.begin(), uses.end());
+  uses.erase(std::unique(uses.begin(), uses.end()), uses.end());
+
+  vertStarts.assign(meshVerts + 1, 0);
+  vertChunks.clear();
+  for (auto [vert, chunk] : uses) {
+    ++vertStarts[vert + 1];
+    vertChunks.push_back(chunk);
+  }
+  for (int v = 0; v < meshVerts; ++v) {
+    vertStarts[v + 1] += vertStarts[v];
+  }
+}
+
+int MeshChunks::getChunkCount() const { return chunks.size(); }
+
+MeshChunks::Chunk &MeshChunks::getChunk(int chunk) { return chunks[chunk]; }
+
+const std::vector<int> &MeshChunks::getOrder() const { return order; }
+
+const std::vector<GLuint> &MeshChunks::getIndices() const { return indices; }
+
+int MeshChunks::getVertCount() const { return vertCount; }
+
+void MeshChunks::markFace(int face) {
+  if (face < (int)faceChunk.size()) {
+    chunks[faceChunk[face]].dirty = true;
+  }
+}
+
+void MeshChunks::markVertex(int vert) {
+  if (vert + 1 >= (int)vertStarts.size()) {
+    return;
+  }
+  for (int i = vertStarts[vert]; i < vertStarts[vert + 1]; ++i) {
+    chunks[vertChunks[i]].dirty = true;
+  }
+}
+
+void MeshChunks::markAll() {
+  for (Chunk &chunk : chunks) {
+    chunk.dirty = true;
+  }
+}
+
+bool MeshChunks::skinnedBounds(const Chunk &chunk,
+                               const std::vector<glm::mat4> &palette,
+                               glm::vec3 *lo, glm::vec3 *hi) {
+  if (chunk.joints.empty()) {
+    return true;
+  }
+  glm::vec3 skinnedLo(std::numeric_limits<float>::max()), skinnedHi(-skinnedLo);
+  for (uint16_t joint : chunk.joints) {
+    if (joint >= palette.size()) {
+      return false;
+    }
+    for (int corner = 0; corner < 8; ++corner) {
+      glm::vec3 p(corner & 1 ? chunk.hi.x : chunk.lo.x,
+                  corner & 2 ? chunk.hi.y : chunk.lo.y,
+                  corner & 4 ? chunk.hi.z : chunk.lo.z);
+      p = glm::vec3(palette[joint] * glm::vec4(p, 1));
+      skinnedLo = glm::min(skinnedLo, p);
+      skinnedHi = glm::max(skinnedHi, p);
+    }
+  }
+  *lo = skinnedLo;
+  *hi = skinnedHi;
+  return true;
+}
+
+void MeshChunks::cull(const glm::mat4 &viewProj,
+                      const std::vector<glm::mat4> *palette,
+                      DrawRanges *ranges) const {
+  Frustum frustum(viewProj);
+  ranges->counts.clear();
+  ranges->offsets.clear();
+
+  int runEnd = -1; // Index just past the last range
+  for (const Chunk &chunk : chunks) {
+    glm::vec3 lo = chunk.lo, hi = chunk.hi;
+    bool bounded = !palette || skinnedBounds(chunk, *palette, &lo, &hi);
+    if (chunk.idxCount == 0 || (bounded && !frustum.intersects(lo, hi))) {
+      continue;
+    }
+
+    if (chunk.firstIdx == runEnd) {
+      ranges->counts.back() += chunk.idxCount;
+    } else {
+      ranges->counts.push_back(chunk.idxCount);
+      ranges->offsets.push_back(
+          reinterpret_cast<const void *>(chunk.firstIdx * sizeof(GLuint)));
+    }
+    runEnd = chunk.firstIdx + chunk.idxCount;
+  }
+}
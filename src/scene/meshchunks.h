@@ -0,0 +1,81 @@
+#pragma once
+
+#include "drawable.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * Splits the faces of a mesh into spatially coherent chunks, so that drawing
+ * can skip the chunks outside the camera's frustum and rebuilding the buffers
+ * can skip the chunks that did not change.
+ *
+ * Faces are sorted by the Morton code of their centroids, which keeps faces
+ * that are close in space close in the order, and the order is cut into runs
+ * of FacesPerChunk. Each chunk owns one contiguous range of the vertex buffer
+ * and one of the index buffer, so a chunk is rewritten or drawn on its own.
+ */
+class MeshChunks {
+public:
+  static constexpr int FacesPerChunk = 256;
+
+  struct Chunk {
+    int firstFace, faceCount; // Range of getOrder()
+    int firstVert, vertCount; // Range of the vertex buffer
+    int firstIdx, idxCount;   // Range of the index buffer
+    glm::vec3 lo, hi;         // Bounds of the vertices as last written
+    std::vector<uint16_t> joints; // Joints influencing any vertex, sorted
+    bool dirty;                   // Its vertices need to be written again
+  };
+
+  MeshChunks();
+
+  /**
+   * Lays out chunks for faces where face f has the centroid centroids[f] and
+   * the faceStarts[f + 1] - faceStarts[f] vertices listed in faceVerts from
+   * faceStarts[f] on, out of meshVerts. Every chunk starts out dirty.
+   */
+  void build(const std::vector<glm::vec3> &centroids,
+             const std::vector<int> &faceStarts,
+             const std::vector<int> &faceVerts, int meshVerts);
+
+  int getChunkCount() const;
+  Chunk &getChunk(int chunk);
+  const std::vector<int> &getOrder() const;     // Face indices by chunk
+  const std::vector<GLuint> &getIndices() const; // Fanned triangles
+  int getVertCount() const; // Size of the vertex buffer the layout needs
+
+  void markFace(int face);   // Dirties the chunk holding the face
+  void markVertex(int vert); // Dirties every chunk using the vertex
+  void markAll();
+
+  /**
+   * Fills ranges with the parts of the index buffer belonging to chunks that
+   * may be visible through viewProj, merging neighbouring chunks. For a mesh
+   * skinned on the GPU, palette holds its skinning matrices, and each chunk's
+   * box is moved by every joint influencing it. Linearly blended vertices
+   * stay inside the union of those boxes, being weighted averages of points
+   * in them. Dual quaternion blending gives no such guarantee (halfway
+   * between no twist and a half turn is a quarter turn, outside both), so a
+   * mesh blended that way must not be culled with its palette.
+   */
+  void cull(const glm::mat4 &viewProj, const std::vector<glm::mat4> *palette,
+            DrawRanges *ranges) const;
+
+private:
+  std::vector<Chunk> chunks;
+  std::vector<int> order;      // Face indices, chunk by chunk
+  std::vector<int> faceChunk;  // Chunk of each face
+  std::vector<int> vertChunks; // Chunks using each vertex, vertex by vertex
+  std::vector<int> vertStarts; // Where each vertex's run of vertChunks starts
+  std::vector<GLuint> indices;
+  int vertCount; // Vertices written for all chunks together
+
+  // Bounds of chunk after skinning with palette. False if a joint is missing
+  // from the palette, in which case nothing can be said about them.
+  static bool skinnedBounds(const Chunk &chunk,
+                            const std::vector<glm::mat4> &palette,
+                            glm::vec3 *lo, glm::vec3 *hi);
+};
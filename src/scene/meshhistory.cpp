@@ -0,0 +1,124 @@
+#include "meshhistory.h"
+
+#include <algorithm>
+
+MeshDelta::MeshDelta(const QString &label, const void *mergeKey)
+    : label(label), mergeKey(mergeKey), vertStart(0), faceStart(0),
+      edgeStart(0) {}
+
+const QString &MeshDelta::getLabel() const { return label; }
+
+bool MeshDelta::isEmpty() const {
+  return edgeRewires.empty() && vertRewires.empty() && faceRewires.empty() &&
+         posChanges.empty() && colChanges.empty() && removedVerts.empty() &&
+         removedFaces.empty() && removedEdges.empty();
+}
+
+size_t MeshDelta::getByteSize() const {
+  return sizeof(MeshDelta) +
+         edgeRewires.capacity() * sizeof(Rewire<HalfEdge>) +
+         vertRewires.capacity() * sizeof(Rewire<Vertex>) +
+         faceRewires.capacity() * sizeof(Rewire<Face>) +
+         posChanges.capacity() * sizeof(Change<Vertex>) +
+         colChanges.capacity() * sizeof(Change<Face>) +
+         removedVerts.size() * sizeof(Vertex) +
+         removedFaces.size() * sizeof(Face) +
+         removedEdges.size() * sizeof(HalfEdge);
+}
+
+void MeshDelta::mergeWith(const MeshDelta &later) {
+  // only plain attribute edits are ever given a merge key, so there are no
+  // rewires or added elements to reconcile
+  auto mergeChanges = [](auto &into, const auto &from) {
+    for (auto &change : from) {
+      auto existing = std::find_if(into.begin(), into.end(), [&](auto &c) {
+        return c.elem == change.elem;
+      });
+      if (existing != into.end()) {
+        existing->after = change.after;
+      } else {
+        into.push_back(change);
+      }
+    }
+  };
+  mergeChanges(posChanges, later.posChanges);
+  mergeChanges(colChanges, later.colChanges);
+}
+
+MeshHistory::MeshHistory(size_t byteBudget)
+    : undoStack(), redoStack(), byteSize(0), byteBudget(byteBudget),
+      canMerge(false) {}
+
+int MeshHistory::getUndoCount() const { return undoStack.size(); }
+
+int MeshHistory::getRedoCount() const { return redoStack.size(); }
+
+size_t MeshHistory::getByteSize() const { return byteSize; }
+
+size_t MeshHistory::getByteBudget() const { return byteBudget; }
+
+QString MeshHistory::getUndoLabel() const {
+  return undoStack.empty() ? QString() : undoStack.back()->getLabel();
+}
+
+QString MeshHistory::getRedoLabel() const {
+  return redoStack.empty() ? QString() : redoStack.back()->getLabel();
+}
+
+void MeshHistory::setByteBudget(size_t budget) {
+  byteBudget = budget;
+  enforceBudget();
+}
+
+void MeshHistory::push(uPtr<MeshDelta> delta) {
+  // a new edit invalidates everything that was undone
+  for (auto &undone : redoStack) {
+    byteSize -= undone->getByteSize();
+  }
+  redoStack.clear();
+
+  MeshDelta *top = undoStack.empty() ? nullptr : undoStack.back().get();
+  if (canMerge && top && delta->mergeKey && delta->mergeKey == top->mergeKey) {
+    size_t oldSize = top->getByteSize();
+    top->mergeWith(*delta);
+    resized(*top, oldSize);
+  } else {
+    byteSize += delta->getByteSize();
+    undoStack.push_back(std::move(delta));
+  }
+  canMerge = true;
+
+  enforceBudget();
+}
+
+MeshDelta *MeshHistory::stepBack() {
+  if (undoStack.empty()) {
+    return nullptr;
+  }
+  redoStack.push_back(std::move(undoStack.back()));
+  undoStack.pop_back();
+  canMerge = false;
+  return redoStack.back().get();
+}
+
+MeshDelta *MeshHistory::stepForward() {
+  if (redoStack.empty()) {
+    return nullptr;
+  }
+  undoStack.push_back(std::move(redoStack.back()));
+  redoStack.pop_back();
+  canMerge = false;
+  return undoStack.back().get();
+}
+
+void MeshHistory::resized(const MeshDelta &delta, size_t oldSize) {
+  byteSize = byteSize - oldSize + delta.getByteSize();
+}
+
+void MeshHistory::enforceBudget() {
+  // always keep the most recent step, even if it alone is over budget
+  while (byteSize > byteBudget && undoStack.size() > 1) {
+    byteSize -= undoStack.front()->getByteSize();
+    undoStack.pop_front();
+  }
+}
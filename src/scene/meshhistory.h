@@ -0,0 +1,114 @@
+#pragma once
+
+#include "meshdata/face.h"
+#include "meshdata/halfedge.h"
+#include "meshdata/vertex.h"
+#include "smartpointerhelp.h"
+
+#include <QString>
+#include <glm/glm.hpp>
+
+#include <deque>
+#include <vector>
+
+/**
+ * A compact record of one undoable mesh operation.
+ *
+ * Rather than snapshotting the mesh, a delta stores only what the operation
+ * touched: the range of elements it appended to the mesh, every pointer it
+ * rewired on pre-existing elements, and the old and new values of any
+ * positions or colors it changed. Undoing or redoing a delta therefore costs
+ * time proportional to the size of the change, not the size of the mesh.
+ */
+class MeshDelta {
+public:
+  MeshDelta(const QString &label, const void *mergeKey);
+
+  const QString &getLabel() const;
+  bool isEmpty() const;
+  size_t getByteSize() const; // Approximate heap footprint of this delta
+
+private:
+  // A pointer field that was changed from `before` to `after`
+  template <typename T> struct Rewire {
+    T **field;
+    T *before;
+    T *after;
+  };
+
+  // A position or color of `elem` that was changed from `before` to `after`
+  template <typename T> struct Change {
+    T *elem;
+    glm::vec3 before;
+    glm::vec3 after;
+  };
+
+  QString label;
+  const void *mergeKey; // Consecutive deltas with the same non-null key are
+                        // merged, e.g. scrubbing one vertex's position
+
+  // Sizes of Mesh::verts/faces/edges before the operation. Anything appended
+  // past these indices was created by the operation.
+  size_t vertStart, faceStart, edgeStart;
+
+  std::vector<Rewire<HalfEdge>> edgeRewires;
+  std::vector<Rewire<Vertex>> vertRewires;
+  std::vector<Rewire<Face>> faceRewires;
+  std::vector<Change<Vertex>> posChanges;
+  std::vector<Change<Face>> colChanges;
+
+  // Elements created by the operation, held here while it is undone
+  std::vector<uPtr<Vertex>> removedVerts;
+  std::vector<uPtr<Face>> removedFaces;
+  std::vector<uPtr<HalfEdge>> removedEdges;
+
+  // Folds a later delta on the same merge key into this one
+  void mergeWith(const MeshDelta &later);
+
+  friend class Mesh;
+  friend class MeshHistory;
+};
+
+/**
+ * Undo and redo stacks of MeshDeltas for a single Mesh.
+ *
+ * The total footprint of both stacks is capped at a byte budget. Once it is
+ * exceeded, the oldest undo steps are discarded first.
+ */
+class MeshHistory {
+public:
+  MeshHistory(size_t byteBudget = 64 * 1024 * 1024);
+
+  int getUndoCount() const;
+  int getRedoCount() const;
+  size_t getByteSize() const;
+  size_t getByteBudget() const;
+  QString getUndoLabel() const; // Label of the next step undo() would revert
+  QString getRedoLabel() const; // Label of the next step redo() would reapply
+
+  void setByteBudget(size_t budget);
+
+private:
+  std::deque<uPtr<MeshDelta>> undoStack;
+  std::vector<uPtr<MeshDelta>> redoStack;
+  size_t byteSize; // Running total of both stacks' getByteSize()
+  size_t byteBudget;
+  bool canMerge; // False right after an undo or redo so that a new edit never
+                 // merges into a step the user has already stepped over
+
+  // Records a finished delta, clearing the redo stack
+  void push(uPtr<MeshDelta> delta);
+  // Moves the newest undo step onto the redo stack and returns it for the
+  // Mesh to revert, or returns null if there is nothing to undo
+  MeshDelta *stepBack();
+  // Moves the newest redo step back onto the undo stack and returns it for the
+  // Mesh to reapply, or returns null if there is nothing to redo
+  MeshDelta *stepForward();
+
+  // Accounts for delta having changed size from oldSize, as it does when the
+  // elements it created move between it and the mesh
+  void resized(const MeshDelta &delta, size_t oldSize);
+  void enforceBudget();
+
+  friend class Mesh;
+};
@@ -0,0 +1,114 @@
+#include "meshoverlay.h"
+
+#include "frameprofile.h"
+#include "mesh.h"
+
+#include <glm/glm.hpp>
+
+MeshOverlay::MeshOverlay(RenderContext *context)
+    : context(context), slotBuffer(0), slotTexture(0), selectionBuffer(0),
+      selectionTexture(0), layoutVersion(-1), vertCount(0), flags(), marked(),
+      vert(nullptr), edge(nullptr), face(nullptr), selectionDirty(false) {}
+
+MeshOverlay::~MeshOverlay() { destroy(); }
+
+void MeshOverlay::setSelection(const Vertex *v, const HalfEdge *e,
+                               const Face *f) {
+  vert = v;
+  edge = e;
+  face = f;
+  selectionDirty = true;
+}
+
+void MeshOverlay::update(const Mesh &mesh) {
+  frameprofile::Scope profile("MeshOverlay::update");
+  if (!slotBuffer) {
+    context->glGenBuffers(1, &slotBuffer);
+    context->glGenTextures(1, &slotTexture);
+    context->glGenBuffers(1, &selectionBuffer);
+    context->glGenTextures(1, &selectionTexture);
+  }
+
+  if (mesh.getLayoutVersion() != layoutVersion) {
+    layoutVersion = mesh.getLayoutVersion();
+    std::vector<glm::ivec4> slots = mesh.getSlots();
+    vertCount = mesh.getVertexCount();
+    for (glm::ivec4 &slot : slots) {
+      slot.y += vertCount; // face indices become selection texels
+    }
+    flags.assign(vertCount + mesh.getFaceCount(), 0);
+    marked.clear();
+    selectionDirty = true;
+
+    context->glState().bindBuffer(GL_TEXTURE_BUFFER, slotBuffer);
+    context->glBufferData(GL_TEXTURE_BUFFER, slots.size() * sizeof(glm::ivec4),
+                          slots.data(), GL_STATIC_DRAW);
+    context->glState().bindBuffer(GL_TEXTURE_BUFFER, selectionBuffer);
+    context->glBufferData(GL_TEXTURE_BUFFER, flags.size(), flags.data(),
+                          GL_DYNAMIC_DRAW);
+
+    // reallocating the buffers' storage requires attaching them again
+    context->glState().bindTexture(0, GL_TEXTURE_BUFFER, slotTexture);
+    context->glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32I, slotBuffer);
+    context->glState().bindTexture(0, GL_TEXTURE_BUFFER, selectionTexture);
+    context->glTexBuffer(GL_TEXTURE_BUFFER, GL_R8UI, selectionBuffer);
+  }
+
+  if (!selectionDirty) {
+    return;
+  }
+  selectionDirty = false;
+
+  std::vector<int> cleared;
+  cleared.swap(marked);
+  for (int texel : cleared) {
+    flags[texel] = 0;
+  }
+  if (vert) {
+    mark(vert->getIndex(), SELECTED);
+  }
+  if (edge) {
+    mark(edge->getNextVert()->getIndex(), EDGE_END);
+    mark(edge->getSymEdge()->getNextVert()->getIndex(), EDGE_END);
+  }
+  if (face) {
+    mark(vertCount + face->getIndex(), SELECTED);
+  }
+
+  // only the bytes of the old and new selection change
+  context->glState().bindBuffer(GL_TEXTURE_BUFFER, selectionBuffer);
+  for (const std::vector<int> *texels : {&cleared, &marked}) {
+    for (int texel : *texels) {
+      context->glBufferSubData(GL_TEXTURE_BUFFER, texel, 1, &flags[texel]);
+    }
+  }
+}
+
+void MeshOverlay::destroy() {
+  if (slotBuffer) {
+    context->glState().deleteTexture(slotTexture);
+    context->glState().deleteBuffer(slotBuffer);
+    context->glState().deleteTexture(selectionTexture);
+    context->glState().deleteBuffer(selectionBuffer);
+  }
+  slotBuffer = slotTexture = selectionBuffer = selectionTexture = 0;
+  layoutVersion = -1;
+  flags.clear();
+  marked.clear();
+}
+
+void MeshOverlay::bind(GLuint slotUnit, GLuint selectionUnit) {
+  context->glState().bindTexture(slotUnit, GL_TEXTURE_BUFFER, slotTexture);
+  context->glState().bindTexture(selectionUnit, GL_TEXTURE_BUFFER,
+                                 selectionTexture);
+}
+
+void MeshOverlay::mark(int texel, Flag flag) {
+  if (texel < 0 || texel >= (int)flags.size()) {
+    return;
+  }
+  if (!flags[texel]) {
+    marked.push_back(texel);
+  }
+  flags[texel] |= flag;
+}
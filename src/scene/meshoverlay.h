@@ -0,0 +1,64 @@
+#pragma once
+
+#include "meshdata/face.h"
+#include "meshdata/halfedge.h"
+#include "meshdata/vertex.h"
+#include "rendercontext.h"
+
+#include <cstdint>
+#include <vector>
+
+class Mesh;
+
+/**
+ * The texture buffers the overlay shader reads to draw polygon edges and
+ * highlight the selection over a Mesh's own triangles.
+ *
+ * The slot table tells, for every vertex in the mesh's vertex buffer, which
+ * mesh vertex and face it belongs to, so it only changes with the topology.
+ * The selection buffer holds one byte of flags per mesh vertex, followed by
+ * one per face, so a new selection uploads only the bytes whose flags change.
+ */
+class MeshOverlay {
+public:
+  // Flags in the selection buffer
+  enum Flag : uint8_t {
+    SELECTED = 1, // The vertex or face itself
+    EDGE_END = 2, // A vertex at either end of the selected edge
+  };
+
+  MeshOverlay(RenderContext *context);
+  ~MeshOverlay();
+
+  // Highlights at most one of each; nullptr for none. Takes effect on the
+  // next update(), so it is cheap to call outside of drawing.
+  void setSelection(const Vertex *vert, const HalfEdge *edge,
+                    const Face *face);
+
+  // Rebuilds the slot table if mesh was laid out again since the last call,
+  // and uploads whatever the selection changed
+  void update(const Mesh &mesh);
+  void destroy();
+
+  // Binds the slot table and selection textures to the given texture units
+  void bind(GLuint slotUnit, GLuint selectionUnit);
+
+private:
+  RenderContext *context;
+  GLuint slotBuffer;  // GL_TEXTURE_BUFFER storage, one RGBA32I texel per slot
+  GLuint slotTexture;
+  GLuint selectionBuffer; // One R8UI texel per vertex, then per face
+  GLuint selectionTexture;
+  int layoutVersion; // Of the mesh the slot table was built for, -1 if none
+  int vertCount;     // Where the faces' flags start
+
+  std::vector<uint8_t> flags; // CPU copy of the selection buffer
+  std::vector<int> marked;    // Texels with any flag set
+
+  const Vertex *vert;
+  const HalfEdge *edge;
+  const Face *face;
+  bool selectionDirty; // The selection changed since the last update()
+
+  void mark(int texel, Flag flag); // Sets a flag if the texel exists
+};
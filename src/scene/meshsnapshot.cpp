@@ -0,0 +1,160 @@
+#include "meshsnapshot.h"
+
+#include <pxr/base/tf/stringUtils.h>
+#include <pxr/usd/usdSkel/bindingAPI.h>
+#include <pxr/usd/usdSkel/blendShape.h>
+
+#include <algorithm>
+#include <set>
+
+bool MeshSnapshot::FaceBlock::operator==(const FaceBlock &other) const {
+  return counts == other.counts && indices == other.indices;
+}
+
+MeshSnapshot::MeshSnapshot()
+    : version(0), points(), faceColors(), influences(), bound(false),
+      blendShapes(), blendShapeWeights(), faceBlocks(), faceCount(0) {}
+
+uint64_t MeshSnapshot::getVersion() const { return version; }
+
+size_t MeshSnapshot::getVertexCount() const { return points.size(); }
+
+size_t MeshSnapshot::getFaceCount() const { return faceCount; }
+
+glm::vec3 MeshSnapshot::getPoint(int vert) const { return points[vert]; }
+
+glm::vec3 MeshSnapshot::getFaceColor(int face) const {
+  return faceColors[face];
+}
+
+const SkinInfluence &MeshSnapshot::getInfluence(int vert) const {
+  return influences[vert];
+}
+
+bool MeshSnapshot::isBound() const { return bound; }
+
+int MeshSnapshot::getBlendShapeCount() const { return blendShapes.size(); }
+
+const BlendShape &MeshSnapshot::getBlendShape(int target) const {
+  return *blendShapes[target];
+}
+
+float MeshSnapshot::getBlendShapeWeight(int target) const {
+  return blendShapeWeights[target];
+}
+
+std::vector<glm::vec3> MeshSnapshot::shapedPoints() const {
+  size_t count = points.size();
+  std::vector<glm::vec3> rest(count);
+  for (size_t i = 0; i < count; ++i) {
+    rest[i] = points[i];
+  }
+  if (blendShapes.empty()) {
+    return rest;
+  }
+
+  std::vector<glm::vec3> out(count);
+  BlendShapeSet::evaluate(blendShapes, blendShapeWeights, rest.data(), count,
+                          out.data());
+  return out;
+}
+
+MeshSnapshot MeshSnapshot::posed(const std::vector<glm::mat4> &palette,
+                                 SkinningMode mode) const {
+  MeshSnapshot result(*this);
+  bool skinned = bound && !palette.empty();
+  if (!skinned && blendShapes.empty()) {
+    return result;
+  }
+
+  size_t count = points.size();
+  std::vector<glm::vec3> rest = shapedPoints(), out(count);
+  if (skinned) {
+    std::vector<SkinInfluence> infl(count);
+    for (size_t i = 0; i < count; ++i) {
+      infl[i] = influences[i];
+    }
+    skinning::pose(mode, palette.data(), palette.size(), infl.data(),
+                   rest.data(), nullptr, count, out.data(), nullptr);
+  } else {
+    out = std::move(rest);
+  }
+
+  for (size_t i = 0; i < count; ++i) {
+    result.points.set(i, out[i]);
+  }
+  // the shapes are in the points now
+  std::fill(result.blendShapeWeights.begin(), result.blendShapeWeights.end(),
+            0.f);
+  return result;
+}
+
+pxr::UsdGeomMesh MeshSnapshot::createUsdMesh(pxr::UsdStagePtr stage,
+                                             const char *path) const {
+  auto pxr_points = pxr::VtArray<pxr::GfVec3f>();
+  auto pxr_indices = pxr::VtArray<int>();
+  auto pxr_vtCounts = pxr::VtArray<int>();
+
+  pxr_points.reserve(points.size());
+  for (size_t i = 0; i < points.size(); ++i) {
+    const glm::vec3 &p = points[i];
+    pxr_points.push_back(pxr::GfVec3f(p.x, p.y, p.z));
+  }
+
+  pxr_vtCounts.reserve(faceCount);
+  forEachFace([&](int, const int *indices, int count) {
+    for (int i = 0; i < count; ++i) {
+      pxr_indices.push_back(indices[i]);
+    }
+    pxr_vtCounts.push_back(count);
+  });
+
+  pxr::UsdGeomMesh usdMesh =
+      pxr::UsdGeomMesh::Define(stage, pxr::SdfPath(path));
+
+  auto pointsAttr = usdMesh.GetPointsAttr();
+  pointsAttr.Set(pxr_points);
+  auto idxAttr = usdMesh.GetFaceVertexIndicesAttr();
+  idxAttr.Set(pxr_indices);
+  auto vtCountsAttr = usdMesh.GetFaceVertexCountsAttr();
+  vtCountsAttr.Set(pxr_vtCounts);
+
+  if (blendShapes.empty()) {
+    return usdMesh;
+  }
+
+  // each target becomes a child prim, named after it where that is a valid
+  // and unused prim name
+  pxr::VtTokenArray shapeNames;
+  pxr::SdfPathVector shapePaths;
+  std::set<std::string> used;
+  for (size_t t = 0; t < blendShapes.size(); ++t) {
+    const BlendShape &shape = *blendShapes[t];
+    std::string name = pxr::TfMakeValidIdentifier(shape.name);
+    if (!used.insert(name).second) {
+      name += "_" + std::to_string(t);
+      used.insert(name);
+    }
+
+    pxr::VtVec3fArray offsets(shape.offsets.size());
+    for (size_t i = 0; i < shape.offsets.size(); ++i) {
+      const glm::vec3 &o = shape.offsets[i];
+      offsets[i] = pxr::GfVec3f(o.x, o.y, o.z);
+    }
+    pxr::VtIntArray indices(shape.indices.begin(), shape.indices.end());
+
+    pxr::SdfPath shapePath = usdMesh.GetPath().AppendChild(pxr::TfToken(name));
+    auto usdShape = pxr::UsdSkelBlendShape::Define(stage, shapePath);
+    usdShape.CreateOffsetsAttr().Set(offsets);
+    usdShape.CreatePointIndicesAttr().Set(indices);
+
+    shapeNames.push_back(pxr::TfToken(name));
+    shapePaths.push_back(shapePath);
+  }
+
+  auto binding = pxr::UsdSkelBindingAPI::Apply(usdMesh.GetPrim());
+  binding.CreateBlendShapesAttr().Set(shapeNames);
+  binding.CreateBlendShapeTargetsRel().SetTargets(shapePaths);
+
+  return usdMesh;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "blendshapes.h"
+#include "cowarray.h"
+#include "skeletondata/skinning.h"
+#include "smartpointerhelp.h"
+
+#include <glm/glm.hpp>
+#include <pxr/usd/usd/common.h>
+#include <pxr/usd/usdGeom/mesh.h>
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * An immutable, index-based copy of a Mesh at one point in time.
+ *
+ * Snapshots are cheap to take and to copy: their arrays are chunked and
+ * structurally shared with the live mesh and with each other, and only the
+ * chunks the mesh writes to afterwards are ever duplicated. A snapshot can
+ * therefore be handed to a background thread (USD export, validation, LOD
+ * generation) while the UI thread keeps editing the mesh.
+ */
+class MeshSnapshot {
+public:
+  // Faces are stored in blocks of this many faces each
+  static constexpr size_t FacesPerBlock = 1024;
+
+  // The vertex loops of a contiguous block of faces
+  struct FaceBlock {
+    std::vector<int> counts;  // Number of vertices in each face
+    std::vector<int> indices; // Vertex indices of every face, concatenated
+
+    bool operator==(const FaceBlock &other) const;
+  };
+
+  MeshSnapshot();
+
+  uint64_t getVersion() const; // Increases every time the mesh publishes one
+  size_t getVertexCount() const;
+  size_t getFaceCount() const;
+
+  glm::vec3 getPoint(int vert) const;
+  glm::vec3 getFaceColor(int face) const;
+  const SkinInfluence &getInfluence(int vert) const;
+  bool isBound() const; // Whether the mesh was bound to a skeleton
+
+  int getBlendShapeCount() const;
+  const BlendShape &getBlendShape(int target) const;
+  float getBlendShapeWeight(int target) const;
+  // Every point with the blend shapes applied at their weights
+  std::vector<glm::vec3> shapedPoints() const;
+
+  // Returns a copy whose points have the blend shapes applied and are then
+  // posed by the given skinning palette, if the mesh was bound. The copy
+  // keeps the blend shapes, at zero weight.
+  MeshSnapshot posed(const std::vector<glm::mat4> &palette,
+                     SkinningMode mode = SkinningMode::LINEAR) const;
+
+  // Calls fn(faceIndex, vertIndices, vertCount) for every face, in order
+  template <typename F> void forEachFace(F fn) const;
+
+  // Writes this snapshot to the given stage as a UsdGeomMesh. Blend shapes
+  // are written as UsdSkelBlendShape children bound to the mesh; the points
+  // are written as they are, so any weights already applied stay baked in.
+  pxr::UsdGeomMesh createUsdMesh(pxr::UsdStagePtr stage,
+                                 const char *path) const;
+
+private:
+  uint64_t version;
+  CowArray<glm::vec3> points;
+  CowArray<glm::vec3> faceColors;
+  CowArray<SkinInfluence> influences;
+  bool bound;
+  std::vector<sPtr<const BlendShape>> blendShapes; // Shared with the mesh
+  std::vector<float> blendShapeWeights;
+  std::vector<sPtr<const FaceBlock>> faceBlocks;
+  size_t faceCount;
+
+  friend class Mesh;
+};
+
+template <typename F> void MeshSnapshot::forEachFace(F fn) const {
+  int face = 0;
+  for (auto &block : faceBlocks) {
+    const int *indices = block->indices.data();
+    for (int count : block->counts) {
+      fn(face++, indices, count);
+      indices += count;
+    }
+  }
+}
@@ -0,0 +1,157 @@
+#include "pointcache.h"
+
+#include "parallel.h"
+
+#include <pxr/base/gf/vec3f.h>
+#include <pxr/base/vt/array.h>
+#include <pxr/usd/usd/stage.h>
+#include <pxr/usd/usdGeom/tokens.h>
+
+#include <algorithm>
+#include <filesystem>
+
+namespace {
+// Frames are baked in batches of about this many bytes of points and normals
+constexpr size_t BatchBytes = size_t(64) << 20;
+
+// Frames are skinned straight into the arrays handed to USD
+static_assert(sizeof(pxr::GfVec3f) == sizeof(glm::vec3),
+              "GfVec3f and glm::vec3 must share a layout");
+
+glm::vec3 *asGlm(pxr::VtVec3fArray &array) {
+  return reinterpret_cast<glm::vec3 *>(array.data());
+}
+
+// Area weighted vertex normals of the rest pose
+std::vector<glm::vec3> restNormals(const MeshSnapshot &mesh,
+                                   const std::vector<glm::vec3> &rest) {
+  std::vector<glm::vec3> normals(rest.size(), glm::vec3(0));
+  mesh.forEachFace([&](int, const int *indices, int count) {
+    // summing edge cross products gives twice the area along the normal,
+    // even for faces that are not planar
+    glm::vec3 n(0);
+    for (int i = 0; i < count; ++i) {
+      n += glm::cross(rest[indices[i]], rest[indices[(i + 1) % count]]);
+    }
+    for (int i = 0; i < count; ++i) {
+      normals[indices[i]] += n;
+    }
+  });
+
+  for (glm::vec3 &n : normals) {
+    float length = glm::length(n);
+    n = length > 0 ? n / length : glm::vec3(0, 1, 0);
+  }
+  return normals;
+}
+} // namespace
+
+namespace pointcache {
+bool write(const std::string &path, const MeshSnapshot &mesh,
+           const Skeleton &skeleton, const Animation &animation,
+           const Settings &settings, const Progress &progress) {
+  if (!mesh.isBound()) {
+    return false;
+  }
+  auto stage = pxr::UsdStage::CreateNew(path);
+  if (!stage) {
+    return false;
+  }
+
+  // topology and the rest pose are written once, as default values
+  auto meshPath = "/" + std::filesystem::path(path).stem().string();
+  pxr::UsdGeomMesh usdMesh = mesh.createUsdMesh(stage, meshPath.c_str());
+  stage->SetDefaultPrim(usdMesh.GetPrim());
+  stage->SetStartTimeCode(settings.firstFrame);
+  stage->SetEndTimeCode(settings.lastFrame);
+  stage->SetTimeCodesPerSecond(settings.framesPerSecond);
+  stage->SetFramesPerSecond(settings.framesPerSecond);
+
+  // blend shapes are applied ahead of skinning, at the snapshot's weights
+  size_t count = mesh.getVertexCount();
+  std::vector<glm::vec3> rest = mesh.shapedPoints();
+  std::vector<SkinInfluence> influences(count);
+  for (size_t i = 0; i < count; ++i) {
+    influences[i] = mesh.getInfluence(i);
+  }
+  std::vector<glm::vec3> restNor;
+  if (settings.normals) {
+    restNor = restNormals(mesh, rest);
+    usdMesh.SetNormalsInterpolation(pxr::UsdGeomTokens->vertex);
+  }
+
+  int frameCount = std::max(settings.lastFrame - settings.firstFrame + 1, 0);
+  size_t frameBytes =
+      std::max<size_t>(count * sizeof(glm::vec3) * (settings.normals ? 2 : 1),
+                       1);
+  int batchFrames =
+      std::clamp<size_t>(BatchBytes / frameBytes, 1, std::max(frameCount, 1));
+  std::vector<pxr::VtVec3fArray> points(batchFrames);
+  std::vector<pxr::VtVec3fArray> normals(settings.normals ? batchFrames : 0);
+  int jointCount = skeleton.getJointCount();
+
+  for (int first = 0; first < frameCount; first += batchFrames) {
+    int frames = std::min(batchFrames, frameCount - first);
+
+    // each worker poses its own copy of the skeleton and skins whole frames
+    // with the serial kernels, so threads are never nested
+    parallel::forBlocks(frames, 1, [&](size_t begin, size_t end) {
+      Skeleton posed = skeleton;
+      std::vector<glm::mat4> palette(jointCount);
+      std::vector<DualQuat> dualQuats(jointCount);
+
+      for (size_t f = begin; f < end; ++f) {
+        animation.sample(settings.firstFrame + first + (int)f, posed);
+        const std::vector<glm::mat4> &worlds = posed.getWorldTransforms();
+        for (int j = 0; j < jointCount; ++j) {
+          palette[j] = worlds[j] * posed.getBindMatrix(j);
+        }
+
+        // fresh arrays, since the stage still shares the previous batch's
+        points[f] = pxr::VtVec3fArray(count);
+        glm::vec3 *outNor = nullptr;
+        if (settings.normals) {
+          normals[f] = pxr::VtVec3fArray(count);
+          outNor = asGlm(normals[f]);
+        }
+        const glm::vec3 *inNor = restNor.empty() ? nullptr : restNor.data();
+
+        if (settings.mode == SkinningMode::DUAL_QUATERNION) {
+          skinning::toDualQuats(palette.data(), jointCount, dualQuats.data());
+          skinning::skinDualQuatSerial(dualQuats.data(), influences.data(),
+                                       rest.data(), inNor, count,
+                                       asGlm(points[f]), outNor);
+        } else {
+          skinning::skinLinearSerial(palette.data(), influences.data(),
+                                     rest.data(), inNor, count,
+                                     asGlm(points[f]), outNor);
+        }
+      }
+    });
+
+    for (int f = 0; f < frames; ++f) {
+      pxr::UsdTimeCode time(settings.firstFrame + first + f);
+      usdMesh.GetPointsAttr().Set(points[f], time);
+      pxr::VtVec3fArray extent(2);
+      if (pxr::UsdGeomPointBased::ComputeExtent(points[f], &extent)) {
+        usdMesh.GetExtentAttr().Set(extent, time);
+      }
+      if (settings.normals) {
+        usdMesh.GetNormalsAttr().Set(normals[f], time);
+      }
+    }
+
+    // saving a crate layer leaves the samples written so far in the file,
+    // to be read back on demand, so at most one batch is held in memory
+    stage->Save();
+    if (progress) {
+      progress(first + frames, frameCount);
+    }
+  }
+
+  if (frameCount == 0) {
+    stage->Save();
+  }
+  return true;
+}
+} // namespace pointcache
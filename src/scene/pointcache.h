@@ -0,0 +1,42 @@
+#pragma once
+
+#include "meshsnapshot.h"
+#include "skeletondata/animation.h"
+#include "skeletondata/skeleton.h"
+#include "skeletondata/skinning.h"
+
+#include <functional>
+#include <string>
+
+/**
+ * Baked point caches: USD files in which an animated, skinned mesh is a
+ * plain UsdGeomMesh whose points (and optionally normals) are time sampled
+ * once per frame, for consumers that cannot evaluate UsdSkel.
+ *
+ * Frames are baked in batches sized to bound memory use. Within a batch,
+ * worker threads pose the skeleton and skin the mesh for separate frames,
+ * then the batch is written in frame order and the stage saved, so the
+ * output does not depend on how the work was scheduled.
+ */
+namespace pointcache {
+struct Settings {
+  int firstFrame, lastFrame; // Inclusive range of frames to bake
+  double framesPerSecond;
+  SkinningMode mode;
+  bool normals; // Also bake vertex normals
+};
+
+// Reports the number of frames written so far. Called from the thread that
+// called write().
+using Progress = std::function<void(int written, int total)>;
+
+/**
+ * Writes a new stage at path holding mesh, skinned to skeleton as animated
+ * by animation over the frames in settings. skeleton must hold the bind
+ * matrices mesh was bound with. Returns false if mesh is not bound or the
+ * stage could not be created.
+ */
+bool write(const std::string &path, const MeshSnapshot &mesh,
+           const Skeleton &skeleton, const Animation &animation,
+           const Settings &settings, const Progress &progress = nullptr);
+} // namespace pointcache
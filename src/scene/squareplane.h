@@ -10,6 +10,6 @@
 
 class SquarePlane : public Drawable {
 public:
-  SquarePlane(OpenGLContext *mp_context);
+  SquarePlane(RenderContext *mp_context);
   virtual void create();
 };
@@ -0,0 +1,154 @@
+#include "shadercache.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QOpenGLContext>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include <cstring>
+
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+namespace {
+// Every entry starts with this, then the binary format, then the binary.
+// Changing the layout means changing the magic.
+constexpr char Magic[8] = {'M', 'M', 'S', 'H', 'D', 'R', '0', '1'};
+constexpr int HeaderSize = sizeof(Magic) + sizeof(GLenum);
+
+QByteArray glString(RenderContext *context, GLenum name) {
+  return reinterpret_cast<const char *>(context->glGetString(name));
+}
+} // namespace
+
+ShaderCache::ShaderCache(RenderContext *context)
+    : context(context), directory(), driver(), getProgramBinary(nullptr),
+      programBinary(nullptr), programParameteri(nullptr) {}
+
+void ShaderCache::initialize() {
+  QOpenGLContext *ctx = context->glContext();
+  bool supported = ctx->format().version() >= qMakePair(4, 1) ||
+                   ctx->hasExtension("GL_ARB_get_program_binary");
+  GLint formats = 0;
+  if (supported) {
+    context->glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+  }
+  if (formats > 0) {
+    getProgramBinary = reinterpret_cast<GetProgramBinary>(
+        ctx->getProcAddress("glGetProgramBinary"));
+    programBinary =
+        reinterpret_cast<ProgramBinary>(ctx->getProcAddress("glProgramBinary"));
+    programParameteri = reinterpret_cast<ProgramParameteri>(
+        ctx->getProcAddress("glProgramParameteri"));
+  }
+  if (!getProgramBinary || !programBinary || !programParameteri) {
+    getProgramBinary = nullptr;
+    return;
+  }
+
+  if (qEnvironmentVariableIsSet("MICROMAYA_SHADER_CACHE")) {
+    directory = qEnvironmentVariable("MICROMAYA_SHADER_CACHE");
+  } else {
+    directory =
+        QStandardPaths::writableLocation(QStandardPaths::CacheLocation) +
+        "/shaders";
+  }
+  driver = glString(context, GL_VENDOR) + '\n' +
+           glString(context, GL_RENDERER) + '\n' +
+           glString(context, GL_VERSION);
+}
+
+bool ShaderCache::isEnabled() const {
+  return getProgramBinary && !directory.isEmpty();
+}
+
+QByteArray
+ShaderCache::makeKey(std::initializer_list<QByteArray> inputs) const {
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+  hash.addData(driver);
+  for (const QByteArray &input : inputs) {
+    // lengths keep inputs from running into each other
+    hash.addData(QByteArray::number(input.size()) + ':');
+    hash.addData(input);
+  }
+  return hash.result().toHex();
+}
+
+bool ShaderCache::load(GLuint prog, const QByteArray &key) {
+  if (!isEnabled()) {
+    return false;
+  }
+  QFile file(pathOf(key));
+  if (!file.open(QIODevice::ReadOnly)) {
+    return false;
+  }
+  QByteArray data = file.readAll();
+  if (data.size() <= HeaderSize ||
+      std::memcmp(data.constData(), Magic, sizeof(Magic)) != 0) {
+    return false;
+  }
+
+  GLenum format;
+  std::memcpy(&format, data.constData() + sizeof(Magic), sizeof(format));
+  programBinary(prog, format, data.constData() + HeaderSize,
+                data.size() - HeaderSize);
+
+  GLint linked = 0;
+  context->glGetProgramiv(prog, GL_LINK_STATUS, &linked);
+  if (!linked) {
+    // a format the driver no longer accepts also raises an error, which is
+    // expected here
+    context->glGetError();
+  }
+  return linked;
+}
+
+void ShaderCache::prepare(GLuint prog) {
+  if (isEnabled()) {
+    programParameteri(prog, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  }
+}
+
+void ShaderCache::store(GLuint prog, const QByteArray &key) {
+  if (!isEnabled()) {
+    return;
+  }
+  GLint length = 0;
+  context->glGetProgramiv(prog, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0) {
+    return;
+  }
+
+  QByteArray data(HeaderSize + length, Qt::Uninitialized);
+  GLsizei written = 0;
+  GLenum format = 0;
+  getProgramBinary(prog, length, &written, &format, data.data() + HeaderSize);
+  if (written <= 0) {
+    return;
+  }
+  std::memcpy(data.data(), Magic, sizeof(Magic));
+  std::memcpy(data.data() + sizeof(Magic), &format, sizeof(format));
+  data.resize(HeaderSize + written);
+
+  // entries are replaced whole, so a crash or another instance starting up
+  // at the same time never sees half of one
+  QDir().mkpath(directory);
+  QSaveFile file(pathOf(key));
+  if (file.open(QIODevice::WriteOnly)) {
+    file.write(data);
+    file.commit();
+  }
+}
+
+QString ShaderCache::pathOf(const QByteArray &key) const {
+  return directory + '/' + QString::fromLatin1(key) + ".bin";
+}
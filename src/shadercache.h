@@ -0,0 +1,63 @@
+#pragma once
+
+#include "rendercontext.h"
+
+#include <QByteArray>
+#include <QString>
+
+#include <initializer_list>
+
+/**
+ * Linked shader programs saved to disk with glGetProgramBinary, so later
+ * launches can skip compiling and linking GLSL. That matters most on
+ * software GL such as llvmpipe, where compilation dominates startup.
+ *
+ * Entries are keyed by a hash of everything that goes into a program and
+ * the driver's vendor, renderer and version strings, so editing a shader or
+ * updating the driver just misses. A binary the driver rejects is a miss
+ * too, and the caller compiles from source as before.
+ *
+ * Program binaries need OpenGL 4.1 or ARB_get_program_binary; without them
+ * every lookup misses and nothing is written. Entries live in the user's
+ * cache directory, or in MICROMAYA_SHADER_CACHE if that is set; setting it
+ * to an empty string turns the cache off.
+ */
+class ShaderCache {
+public:
+  explicit ShaderCache(RenderContext *context);
+
+  // Checks for program binary support. Needs the context to be current.
+  void initialize();
+  bool isEnabled() const;
+
+  // The key for a program built from the given inputs, in order
+  QByteArray makeKey(std::initializer_list<QByteArray> inputs) const;
+
+  // Loads the binary stored under key into prog, which then counts as
+  // linked. Returns false if there is none or the driver rejects it.
+  bool load(GLuint prog, const QByteArray &key);
+  // Marks prog, before it is linked, as one that will be stored
+  void prepare(GLuint prog);
+  // Saves the binary of prog, which must be linked, under key
+  void store(GLuint prog, const QByteArray &key);
+
+private:
+  // Entry points of ARB_get_program_binary, resolved at runtime since the
+  // 3.2 core functions do not include them
+  using GetProgramBinary = void(QOPENGLF_APIENTRYP)(GLuint, GLsizei, GLsizei *,
+                                                    GLenum *, void *);
+  using ProgramBinary = void(QOPENGLF_APIENTRYP)(GLuint, GLenum, const void *,
+                                                 GLsizei);
+  using ProgramParameteri = void(QOPENGLF_APIENTRYP)(GLuint, GLenum, GLint);
+
+  RenderContext *context;
+  QString directory; // Empty if the cache is off
+  QByteArray driver; // Identifies the driver that made the binaries
+
+  // Null if program binaries are unsupported
+  GetProgramBinary getProgramBinary;
+  ProgramBinary programBinary;
+  ProgramParameteri programParameteri;
+
+  QString pathOf(const QByteArray &key) const;
+};
@@ -1,33 +1,131 @@
 #include "shaderprogram.h"
 
+#include "startupprofile.h"
+
 #include <QFile>
-#include <QStringBuilder>
 
-ShaderProgram::ShaderProgram(OpenGLContext *context)
-    : vertShader(), fragShader(), prog(), attrPos(-1), attrNor(-1), attrCol(-1),
-      attrJointIdx(-1), attrJointWgt(-1), unifModel(-1), unifModelInvTr(-1),
-      unifViewProj(-1), unifCamPos(-1), unifBindMats(-1), unifJointTfms(-1),
-      context(context) {}
+#include <string>
+#include <utility>
+
+namespace {
+// Every vertex input gets the same location in all programs, so that the VAO
+// each Drawable sets up once works with whichever shader draws it
+const std::pair<GLuint, const char *> AttribLocations[] = {
+    {ATTR_POS, "vs_Pos"},
+    {ATTR_NOR, "vs_Nor"},
+    {ATTR_COL, "vs_Col"},
+    {ATTR_JOINT_IDX0, "vs_JointIdx0"},
+    {ATTR_JOINT_WGT0, "vs_JointWgt0"},
+    {ATTR_JOINT_IDX1, "vs_JointIdx1"},
+    {ATTR_JOINT_WGT1, "vs_JointWgt1"},
+};
+
+// The raw bytes of a file or Qt resource, empty if it cannot be read
+QByteArray readFile(const char *fileName) {
+  QFile file(fileName);
+  return file.open(QFile::ReadOnly) ? file.readAll() : QByteArray();
+}
+} // namespace
+
+ShaderProgram::ShaderProgram(RenderContext *context)
+    : vertShader(), fragShader(), geomShader(), prog(), unifModel(-1),
+      unifModelInvTr(-1), unifViewProj(-1), unifCamPos(-1),
+      unifJointPalette(-1), unifJointDualQuats(-1), unifSkinningMode(-1),
+      unifSlots(-1), unifSelection(-1), unifViewport(-1), unifWireframe(-1),
+      unifOccluded(-1), unifJointWorlds(-1), unifJointInfo(-1), linked(false),
+      context(context), model(), viewProj(), camPos(), jointUnits(),
+      skinningMode(), overlayUnits(), viewport(), wireframe(), occluded(),
+      gizmoUnits() {}
+
+void ShaderProgram::create(const char *vertfile, const char *fragfile,
+                           ShaderCache *cache) {
+  create(vertfile, nullptr, fragfile, cache);
+}
 
-void ShaderProgram::create(const char *vertfile, const char *fragfile) {
-  // Allocate space on our GPU for a vertex shader and a fragment shader and a
-  // shader program to manage the two
-  vertShader = context->glCreateShader(GL_VERTEX_SHADER);
-  fragShader = context->glCreateShader(GL_FRAGMENT_SHADER);
+void ShaderProgram::create(const char *vertfile, const char *geomfile,
+                           const char *fragfile, ShaderCache *cache) {
+  // Allocate space on our GPU for a shader program
   prog = context->glCreateProgram();
-  // Get the body of text stored in our two .glsl files
-  QString qVertSource = qTextFileRead(vertfile);
-  QString qFragSource = qTextFileRead(fragfile);
+  // Get the body of text stored in our .glsl files. GLSL is plain ASCII, so
+  // the bytes are handed to OpenGL as they are
+  QByteArray vertSource = readFile(vertfile);
+  QByteArray geomSource = geomfile ? readFile(geomfile) : QByteArray();
+  QByteArray fragSource = readFile(fragfile);
+
+  // A program linked from the same sources, with the same attribute
+  // locations, may already be on disk
+  QByteArray key;
+  bool fromCache = false;
+  if (cache && cache->isEnabled()) {
+    QByteArray locations;
+    for (auto &attrib : AttribLocations) {
+      locations += QByteArray::number(attrib.first) + attrib.second + ';';
+    }
+    // programs without a geometry shader keep the keys they always had
+    key = geomfile ? cache->makeKey({vertSource, geomSource, fragSource,
+                                     locations})
+                   : cache->makeKey({vertSource, fragSource, locations});
+    fromCache = cache->load(prog, key);
+  }
 
-  char *vertSource = new char[qVertSource.size() + 1];
-  strcpy(vertSource, qVertSource.toStdString().c_str());
-  char *fragSource = new char[qFragSource.size() + 1];
-  strcpy(fragSource, qFragSource.toStdString().c_str());
+  if (fromCache) {
+    linked = true;
+  } else {
+    compileAndLink(vertSource, geomSource, fragSource,
+                   key.isEmpty() ? nullptr : cache);
+    if (linked && !key.isEmpty()) {
+      cache->store(prog, key);
+    }
+  }
+
+  // Get the handles to the variables stored in our shaders
+  // See shaderprogram.h for more information about these variables
+  // (a program that failed to link has none, and asking would be an error)
+  auto location = [&](const char *name) {
+    return linked ? context->glGetUniformLocation(prog, name) : -1;
+  };
+
+  unifModel = location("u_Model");
+  unifModelInvTr = location("u_ModelInvTr");
+  unifViewProj = location("u_ViewProj");
+  unifCamPos = location("u_CamPos");
+  unifJointPalette = location("u_JointPalette");
+  unifJointDualQuats = location("u_JointDualQuats");
+  unifSkinningMode = location("u_SkinningMode");
+  unifSlots = location("u_Slots");
+  unifSelection = location("u_Selection");
+  unifViewport = location("u_Viewport");
+  unifWireframe = location("u_Wireframe");
+  unifOccluded = location("u_Occluded");
+  unifJointWorlds = location("u_JointWorlds");
+  unifJointInfo = location("u_JointInfo");
+  clearUniforms();
+
+  if (startupprofile::isEnabled()) {
+    std::string step = std::string(geomfile ? geomfile : vertfile) +
+                       (fromCache ? " program loaded from cache"
+                                  : " program compiled");
+    startupprofile::mark(step.c_str());
+  }
+}
+
+void ShaderProgram::compileAndLink(const QByteArray &vertSource,
+                                   const QByteArray &geomSource,
+                                   const QByteArray &fragSource,
+                                   ShaderCache *cache) {
+  // Allocate space on our GPU for a vertex shader and a fragment shader
+  vertShader = context->glCreateShader(GL_VERTEX_SHADER);
+  fragShader = context->glCreateShader(GL_FRAGMENT_SHADER);
 
   // Send the shader text to OpenGL and store it in the shaders specified by the
-  // handles vertShader and fragShader
-  context->glShaderSource(vertShader, 1, &vertSource, 0);
-  context->glShaderSource(fragShader, 1, &fragSource, 0);
+  // handles vertShader and fragShader. Passing lengths means the text needs
+  // no terminating null, so it is used straight from the buffers it was read
+  // into
+  const char *vertText = vertSource.constData();
+  const char *fragText = fragSource.constData();
+  GLint vertLength = vertSource.size(), fragLength = fragSource.size();
+  context->glShaderSource(vertShader, 1, &vertText, &vertLength);
+  context->glShaderSource(fragShader, 1, &fragText, &fragLength);
   // Tell OpenGL to compile the shader text stored above
   context->glCompileShader(vertShader);
   context->glCompileShader(fragShader);
@@ -45,35 +143,75 @@ void ShaderProgram::create(const char *vertfile, const char *fragfile) {
   // Tell prog that it manages these particular vertex and fragment shaders
   context->glAttachShader(prog, vertShader);
   context->glAttachShader(prog, fragShader);
+
+  // The geometry shader, if any, goes between the two
+  if (!geomSource.isEmpty()) {
+    geomShader = context->glCreateShader(GL_GEOMETRY_SHADER);
+    const char *geomText = geomSource.constData();
+    GLint geomLength = geomSource.size();
+    context->glShaderSource(geomShader, 1, &geomText, &geomLength);
+    context->glCompileShader(geomShader);
+    context->glGetShaderiv(geomShader, GL_COMPILE_STATUS, &compiled);
+    if (!compiled) {
+      printShaderInfoLog(geomShader);
+    }
+    context->glAttachShader(prog, geomShader);
+  }
+
+  for (auto &attrib : AttribLocations) {
+    context->glBindAttribLocation(prog, attrib.first, attrib.second);
+  }
+  if (cache) {
+    cache->prepare(prog);
+  }
   context->glLinkProgram(prog);
 
   // Check for linking success
-  GLint linked;
-  context->glGetProgramiv(prog, GL_LINK_STATUS, &linked);
+  GLint linkStatus;
+  context->glGetProgramiv(prog, GL_LINK_STATUS, &linkStatus);
+  linked = linkStatus;
   if (!linked) {
     printLinkInfoLog(prog);
   }
+}
 
-  // Get the handles to the variables stored in our shaders
-  // See shaderprogram.h for more information about these variables
+void ShaderProgram::useMe() { context->glState().useProgram(prog); }
 
-  attrPos = context->glGetAttribLocation(prog, "vs_Pos");
-  attrNor = context->glGetAttribLocation(prog, "vs_Nor");
-  attrCol = context->glGetAttribLocation(prog, "vs_Col");
-  attrJointIdx = context->glGetAttribLocation(prog, "vs_JointIdx");
-  attrJointWgt = context->glGetAttribLocation(prog, "vs_JointWgt");
-
-  unifModel = context->glGetUniformLocation(prog, "u_Model");
-  unifModelInvTr = context->glGetUniformLocation(prog, "u_ModelInvTr");
-  unifViewProj = context->glGetUniformLocation(prog, "u_ViewProj");
-  unifCamPos = context->glGetUniformLocation(prog, "u_CamPos");
-  unifBindMats = context->glGetUniformLocation(prog, "u_BindMats");
-  unifJointTfms = context->glGetUniformLocation(prog, "u_JointTfms");
+bool ShaderProgram::isLinked() const { return linked; }
+
+template <typename T>
+bool ShaderProgram::changes(std::optional<T> &cached, const T &value,
+                            int uploads) {
+  // a program that failed to link is never drawn with, and using it would be
+  // an error
+  if (!linked) {
+    return false;
+  }
+  if (cached == value) {
+    context->glState().countSkipped(1 + uploads);
+    return false;
+  }
+  cached = value;
+  return true;
 }
 
-void ShaderProgram::useMe() { context->glUseProgram(prog); }
+void ShaderProgram::clearUniforms() {
+  model.reset();
+  viewProj.reset();
+  camPos.reset();
+  jointUnits.reset();
+  skinningMode.reset();
+  overlayUnits.reset();
+  viewport.reset();
+  wireframe.reset();
+  occluded.reset();
+  gizmoUnits.reset();
+}
 
-void ShaderProgram::setModelMatrix(const glm::mat4 &model) {
+void ShaderProgram::setModelMatrix(const glm::mat4 &m) {
+  if (!changes(model, m, (unifModel != -1) + (unifModelInvTr != -1))) {
+    return;
+  }
   useMe();
 
   if (unifModel != -1) {
@@ -86,11 +224,15 @@ void ShaderProgram::setModelMatrix(const glm::mat4 &model) {
         // Transpose the matrix? OpenGL uses column-major, so no.
         GL_FALSE,
         // Pointer to the first element of the matrix
-        &model[0][0]);
+        &m[0][0]);
+    context->glState().countIssued();
   }
 
   if (unifModelInvTr != -1) {
-    glm::mat4 modelinvtr = glm::inverse(glm::transpose(model));
+    // the identity, which nearly everything is drawn with, is its own
+    // inverse transpose
+    glm::mat4 modelinvtr =
+        m == glm::mat4(1) ? m : glm::inverse(glm::transpose(m));
     // Pass a 4x4 matrix into a uniform variable in our shader
     // Handle to the matrix variable on the GPU
     context->glUniformMatrix4fv(
@@ -101,10 +243,14 @@ void ShaderProgram::setModelMatrix(const glm::mat4 &model) {
         GL_FALSE,
         // Pointer to the first element of the matrix
         &modelinvtr[0][0]);
+    context->glState().countIssued();
   }
 }
 
 void ShaderProgram::setViewProjMatrix(const glm::mat4 &vp) {
+  if (!changes(viewProj, vp, unifViewProj != -1)) {
+    return;
+  }
   // Tell OpenGL to use this shader program for subsequent function calls
   useMe();
 
@@ -119,129 +265,171 @@ void ShaderProgram::setViewProjMatrix(const glm::mat4 &vp) {
         GL_FALSE,
         // Pointer to the first element of the matrix
         &vp[0][0]);
+    context->glState().countIssued();
   }
 }
 
 void ShaderProgram::setCamPos(glm::vec3 pos) {
+  if (!changes(camPos, pos, unifCamPos != -1)) {
+    return;
+  }
   useMe();
 
   if (unifCamPos != -1) {
     context->glUniform3fv(unifCamPos, 1, &pos[0]);
+    context->glState().countIssued();
   }
 }
 
-void ShaderProgram::setBindMats(std::array<glm::mat4, 100> mats) {
+void ShaderProgram::setJointPalette(int matrixUnit, int dualQuatUnit) {
+  if (!changes(jointUnits, glm::ivec2(matrixUnit, dualQuatUnit),
+               (unifJointPalette != -1) + (unifJointDualQuats != -1))) {
+    return;
+  }
   useMe();
 
-  if (unifBindMats != -1) {
-    context->glUniformMatrix4fv(unifBindMats, 100, false, &mats[0][0][0]);
+  if (unifJointPalette != -1) {
+    context->glUniform1i(unifJointPalette, matrixUnit);
+    context->glState().countIssued();
+  }
+  if (unifJointDualQuats != -1) {
+    context->glUniform1i(unifJointDualQuats, dualQuatUnit);
+    context->glState().countIssued();
   }
 }
 
-void ShaderProgram::setJointTfms(std::array<glm::mat4, 100> tfms) {
+void ShaderProgram::setSkinningMode(SkinningMode mode) {
+  if (!changes(skinningMode, mode, unifSkinningMode != -1)) {
+    return;
+  }
   useMe();
 
-  if (unifJointTfms != -1) {
-    context->glUniformMatrix4fv(unifJointTfms, 100, false, &tfms[0][0][0]);
+  if (unifSkinningMode != -1) {
+    context->glUniform1i(unifSkinningMode, static_cast<int>(mode));
+    context->glState().countIssued();
   }
 }
 
-// This function, as its name implies, uses the passed in GL widget
-void ShaderProgram::draw(Drawable &d) {
-  if (d.elemCount() < 0) {
-    throw std::invalid_argument(
-        "Attempting to draw a Drawable that has not initialized its count "
-        "variable! Remember to set it to the length of your index array in "
-        "create().");
+void ShaderProgram::setOverlayUnits(int slotUnit, int selectionUnit) {
+  if (!changes(overlayUnits, glm::ivec2(slotUnit, selectionUnit),
+               (unifSlots != -1) + (unifSelection != -1))) {
+    return;
   }
   useMe();
 
-  // Each of the following blocks checks that:
-  //   * This shader has this attribute, and
-  //   * This Drawable has a vertex buffer for this attribute.
-  // If so, it binds the appropriate buffers to each attribute.
+  if (unifSlots != -1) {
+    context->glUniform1i(unifSlots, slotUnit);
+    context->glState().countIssued();
+  }
+  if (unifSelection != -1) {
+    context->glUniform1i(unifSelection, selectionUnit);
+    context->glState().countIssued();
+  }
+}
 
-  // Remember, by calling bindPos(), we call
-  // glBindBuffer on the Drawable's VBO for vertex position,
-  // meaning that glVertexAttribPointer associates vs_Pos
-  // (referred to by attrPos) with that VBO
-  if (attrPos != -1 && d.bindPos()) {
-    context->glEnableVertexAttribArray(attrPos);
-    context->glVertexAttribPointer(attrPos, 4, GL_FLOAT, false, 0, nullptr);
+void ShaderProgram::setViewport(glm::vec2 size) {
+  if (!changes(viewport, size, unifViewport != -1)) {
+    return;
   }
+  useMe();
 
-  if (attrNor != -1 && d.bindNor()) {
-    context->glEnableVertexAttribArray(attrNor);
-    context->glVertexAttribPointer(attrNor, 4, GL_FLOAT, false, 0, nullptr);
+  if (unifViewport != -1) {
+    context->glUniform2fv(unifViewport, 1, &size[0]);
+    context->glState().countIssued();
   }
+}
 
-  if (attrCol != -1 && d.bindCol()) {
-    context->glEnableVertexAttribArray(attrCol);
-    context->glVertexAttribPointer(attrCol, 4, GL_FLOAT, false, 0, nullptr);
+void ShaderProgram::setWireframe(bool on) {
+  if (!changes(wireframe, on, unifWireframe != -1)) {
+    return;
   }
+  useMe();
 
-  if (attrJointIdx != -1 && d.bindJointIdx()) {
-    context->glEnableVertexAttribArray(attrJointIdx);
-    context->glVertexAttribIPointer(attrJointIdx, 2, GL_INT, 0, nullptr);
+  if (unifWireframe != -1) {
+    context->glUniform1i(unifWireframe, on);
+    context->glState().countIssued();
   }
+}
 
-  if (attrJointWgt != -1 && d.bindJointWgt()) {
-    context->glEnableVertexAttribArray(attrJointWgt);
-    context->glVertexAttribPointer(attrJointWgt, 2, GL_FLOAT, false, 0,
-                                   nullptr);
+void ShaderProgram::setOccluded(bool on) {
+  if (!changes(occluded, on, unifOccluded != -1)) {
+    return;
   }
+  useMe();
 
-  // Bind the index buffer and then draw shapes from it.
-  // This invokes the shader program, which accesses the vertex buffers.
-  d.bindIdx();
-  context->glDrawElements(d.drawMode(), d.elemCount(), GL_UNSIGNED_INT, 0);
+  if (unifOccluded != -1) {
+    context->glUniform1i(unifOccluded, on);
+    context->glState().countIssued();
+  }
+}
 
-  if (attrPos != -1)
-    context->glDisableVertexAttribArray(attrPos);
-  if (attrNor != -1)
-    context->glDisableVertexAttribArray(attrNor);
-  if (attrCol != -1)
-    context->glDisableVertexAttribArray(attrCol);
-  if (attrJointIdx != -1)
-    context->glDisableVertexAttribArray(attrJointIdx);
-  if (attrJointWgt != -1)
-    context->glDisableVertexAttribArray(attrJointWgt);
+void ShaderProgram::setGizmoUnits(int worldUnit, int infoUnit) {
+  if (!changes(gizmoUnits, glm::ivec2(worldUnit, infoUnit),
+               (unifJointWorlds != -1) + (unifJointInfo != -1))) {
+    return;
+  }
+  useMe();
 
-  context->printGLErrorLog();
+  if (unifJointWorlds != -1) {
+    context->glUniform1i(unifJointWorlds, worldUnit);
+    context->glState().countIssued();
+  }
+  if (unifJointInfo != -1) {
+    context->glUniform1i(unifJointInfo, infoUnit);
+    context->glState().countIssued();
+  }
 }
 
-char *ShaderProgram::textFileRead(const char *fileName) {
-  char *text;
-
-  if (fileName != NULL) {
-    FILE *file = fopen(fileName, "rt");
+// This function, as its name implies, uses the passed in GL widget
+void ShaderProgram::draw(Drawable &d, const char *label) {
+  if (d.elemCount() < 0) {
+    throw std::invalid_argument(
+        "Attempting to draw a Drawable that has not initialized its count "
+        "variable! Remember to set it to the length of your index array in "
+        "create().");
+  }
+  if (!linked) {
+    return;
+  }
+  useMe();
 
-    if (file != NULL) {
-      fseek(file, 0, SEEK_END);
-      int count = ftell(file);
-      rewind(file);
+  // The Drawable's VAO already records where each attribute lives in its
+  // interleaved buffer, as well as its index buffer, so binding it is all the
+  // vertex setup a draw needs.
+  if (!d.bindVert()) {
+    return;
+  }
 
-      if (count > 0) {
-        text = (char *)malloc(sizeof(char) * (count + 1));
-        count = fread(text, sizeof(char), count, file);
-        text[count] =
-            '\0'; // cap off the string with a terminal symbol, fixed by Cory
-      }
-      fclose(file);
-    }
+  // Draw shapes from the index buffer if there is one, limited to the ranges
+  // the Drawable asks for, or the vertices in order otherwise. This invokes
+  // the shader program, which accesses the vertex buffers.
+  const DrawRanges *ranges = d.bindIdx() ? d.getDrawRanges() : nullptr;
+  if (ranges && ranges->counts.empty()) {
+    return; // every part was culled
+  }
+  GLsizei instances = d.getInstanceCount();
+  if (instances <= 0) {
+    return;
   }
-  return text;
-}
 
-QString ShaderProgram::qTextFileRead(const char *fileName) {
-  QString text;
-  QFile file(fileName);
-  if (file.open(QFile::ReadOnly)) {
-    QTextStream in(&file);
-    text = in.readAll();
-    text.append('\0');
+  context->gpuTimers().begin(label);
+  if (ranges) {
+    context->glMultiDrawElements(d.drawMode(), ranges->counts.data(),
+                                 GL_UNSIGNED_INT, ranges->offsets.data(),
+                                 ranges->counts.size());
+  } else if (d.bindIdx() && instances != 1) {
+    context->glDrawElementsInstanced(d.drawMode(), d.elemCount(),
+                                     GL_UNSIGNED_INT, 0, instances);
+  } else if (d.bindIdx()) {
+    context->glDrawElements(d.drawMode(), d.elemCount(), GL_UNSIGNED_INT, 0);
+  } else {
+    context->glDrawArrays(d.drawMode(), 0, d.elemCount());
   }
-  return text;
+  context->gpuTimers().end();
+  context->glState().countIssued();
+
+  // waiting on the driver for errors is only worth it when debugging
+  context->glState().checkErrors();
 }
 
 void ShaderProgram::printShaderInfoLog(int shader) {
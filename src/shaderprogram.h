@@ -1,30 +1,25 @@
 #pragma once
 
 #include "drawable.h"
-#include "openglcontext.h"
+#include "rendercontext.h"
+#include "shadercache.h"
+#include "skeletondata/skinning.h"
+#include "vertexformat.h"
 #include <la.h>
 
 #include <glm/glm.hpp>
 
+#include <optional>
+
 class ShaderProgram {
 public:
   GLuint vertShader; // A handle for the vertex shader stored in this shader
                      // program
   GLuint fragShader; // A handle for the fragment shader stored in this shader
                      // program
+  GLuint geomShader; // A handle for the geometry shader, 0 if there is none
   GLuint prog; // A handle for the linked shader program stored in this class
 
-  int attrPos; // A handle for the "in" vec4 representing vertex position in the
-               // vertex shader
-  int attrNor; // A handle for the "in" vec4 representing vertex normal in the
-               // vertex shader
-  int attrCol; // A handle for the "in" vec4 representing vertex color in the
-               // vertex shader
-  int attrJointIdx; // A handle for the "in" ivec2 made of the indices of the
-                    // two joints affecting this vertex
-  int attrJointWgt; // A handle for the "in" vec2 made of the weights of the two
-                    // joints affecting this vertex
-
   int unifModel; // A handle for the "uniform" mat4 representing model matrix in
                  // the vertex shader
   int unifModelInvTr; // A handle for the "uniform" mat4 representing inverse
@@ -33,41 +28,106 @@ public:
                       // projection and view matrices in the vertex shader
   int unifCamPos;     // A handle for the "uniform" vec4 representing color of
                       // geometry in the vertex shader
-  int unifBindMats;   // A handle for the "uniform" array of mat4s made of bind
-                      // matrices to respectively indexed joints
-  int unifJointTfms;  // A handle for the "uniform" array of mat4s made of
-                      // overall transformations of respectively indexed joints
+  int unifJointPalette; // A handle for the "uniform" samplerBuffer holding
+                        // each joint's overall transformation times its bind
+                        // matrix, as four texels per joint
+  int unifJointDualQuats; // A handle for the "uniform" samplerBuffer holding
+                          // the same transformations as dual quaternions
+  int unifSkinningMode;   // A handle for the "uniform" int selecting linear or
+                          // dual quaternion blending
+  int unifSlots;     // A handle for the "uniform" isamplerBuffer describing the
+                     // mesh element behind each vertex, for the overlay
+  int unifSelection; // A handle for the "uniform" usamplerBuffer of selection
+                     // flags
+  int unifViewport;  // A handle for the "uniform" vec2 size of the viewport
+  int unifWireframe; // A handle for the "uniform" int choosing whether the
+                     // overlay draws every polygon edge
+  int unifOccluded;  // A handle for the "uniform" int choosing whether the
+                     // overlay draws the faded selection behind the mesh
+  int unifJointWorlds; // A handle for the "uniform" samplerBuffer holding
+                       // each joint's overall transformation, for gizmos
+  int unifJointInfo;   // A handle for the "uniform" isamplerBuffer holding
+                       // each joint's parent and selection
 
 public:
-  ShaderProgram(OpenGLContext *context);
-  // Sets up the requisite GL data and shaders from the given .glsl files
-  void create(const char *vertfile, const char *fragfile);
+  ShaderProgram(RenderContext *context);
+  // Sets up the requisite GL data and shaders from the given .glsl files,
+  // loading the linked program from cache instead if it holds one
+  void create(const char *vertfile, const char *fragfile,
+              ShaderCache *cache = nullptr);
+  // The same, with a geometry shader between the other two
+  void create(const char *vertfile, const char *geomfile,
+              const char *fragfile, ShaderCache *cache);
   // Tells our OpenGL context to use this shader to draw things
   void useMe();
+  // Whether the last create() linked successfully
+  bool isLinked() const;
 
-  // Pass the given model matrix to this shader on the GPU
+  // Pass the given model matrix to this shader on the GPU. Like the other
+  // setters, this does nothing if the uniform already holds that value.
   void setModelMatrix(const glm::mat4 &model);
   // Pass the given Projection * View matrix to this shader on the GPU
   void setViewProjMatrix(const glm::mat4 &vp);
   // Pass the given color to this shader on the GPU
   void setCamPos(glm::vec3 pos);
-  void setBindMats(std::array<glm::mat4, 100> mats);
-  void setJointTfms(std::array<glm::mat4, 100> mats);
+  // Tell the shader which texture units the joint palette's matrices and
+  // dual quaternions are bound to
+  void setJointPalette(int matrixUnit, int dualQuatUnit);
+  // Choose how the skeleton shader blends a vertex's influences
+  void setSkinningMode(SkinningMode mode);
+  // Tell the overlay shader which texture units its slot table and
+  // selection flags are bound to
+  void setOverlayUnits(int slotUnit, int selectionUnit);
+  // Pass the size of the viewport in pixels, for measuring on screen
+  void setViewport(glm::vec2 size);
+  // Choose whether the overlay shader draws every polygon edge
+  void setWireframe(bool on);
+  // Choose whether the overlay shader draws the parts of the selection the
+  // mesh hides, faded, rather than the visible overlay
+  void setOccluded(bool on);
+  // Tell the gizmo shader which texture units the joints' world transforms
+  // and parents are bound to
+  void setGizmoUnits(int worldUnit, int infoUnit);
 
-  // Draw the given object to our screen using this ShaderProgram's shaders
-  void draw(Drawable &d);
-  // Utility function used in create()
-  char *textFileRead(const char *);
+  // Draw the given object to our screen using this ShaderProgram's shaders.
+  // The GPU time it takes is profiled under label, which must be a literal.
+  void draw(Drawable &d, const char *label = "Draw");
   // Utility function that prints any shader compilation errors to the console
   void printShaderInfoLog(int shader);
   // Utility function that prints any shader linking errors to the console
   void printLinkInfoLog(int prog);
 
-  QString qTextFileRead(const char *);
-
 private:
-  OpenGLContext *context; // Since Qt's OpenGL support is done through classes
+  bool linked;
+  RenderContext *context; // Since Qt's OpenGL support is done through classes
                           // like QOpenGLFunctions_3_2_Core, we need to pass our
                           // OpenGL context to the Drawable in order to call GL
                           // functions from within this class.
+
+  // The values last passed to each uniform, which the program keeps until it
+  // is linked again. Empty until set.
+  std::optional<glm::mat4> model;
+  std::optional<glm::mat4> viewProj;
+  std::optional<glm::vec3> camPos;
+  std::optional<glm::ivec2> jointUnits; // Matrix and dual quaternion units
+  std::optional<SkinningMode> skinningMode;
+  std::optional<glm::ivec2> overlayUnits; // Slot table and selection units
+  std::optional<glm::vec2> viewport;
+  std::optional<bool> wireframe;
+  std::optional<bool> occluded;
+  std::optional<glm::ivec2> gizmoUnits; // World transform and joint info units
+
+  // Whether setting cached to value changes it, in which case cached is
+  // updated. Otherwise the glUseProgram and the given number of uniform
+  // uploads the setter would have made are counted as skipped.
+  template <typename T>
+  bool changes(std::optional<T> &cached, const T &value, int uploads);
+  void clearUniforms();
+
+  // Compiles the shaders and links prog from them, preparing it to be stored
+  // in cache if that is not null. An empty geomSource means no geometry
+  // shader.
+  void compileAndLink(const QByteArray &vertSource,
+                      const QByteArray &geomSource,
+                      const QByteArray &fragSource, ShaderCache *cache);
 };
@@ -0,0 +1,179 @@
+#include "animation.h"
+
+#include <algorithm>
+
+namespace {
+// Interpolates between the keys on either side of frame. Frames outside the
+// keyed range hold the first or last key.
+template <typename Value>
+Value sample(const std::vector<float> &frames,
+             const std::vector<Value> &values, float frame,
+             Value (*interpolate)(const Value &, const Value &, float)) {
+  auto next = std::upper_bound(frames.begin(), frames.end(), frame);
+  if (next == frames.begin()) {
+    return values.front();
+  }
+  if (next == frames.end()) {
+    return values.back();
+  }
+
+  size_t i = next - frames.begin() - 1;
+  float t = (frame - frames[i]) / (frames[i + 1] - frames[i]);
+  return interpolate(values[i], values[i + 1], t);
+}
+
+// Inserts a key in frame order, replacing one already at frame
+template <typename Value>
+void insertKey(std::vector<float> &frames, std::vector<Value> &values,
+               float frame, const Value &value) {
+  auto at = std::lower_bound(frames.begin(), frames.end(), frame);
+  size_t i = at - frames.begin();
+  if (at != frames.end() && *at == frame) {
+    values[i] = value;
+    return;
+  }
+  frames.insert(at, frame);
+  values.insert(values.begin() + i, value);
+}
+
+glm::quat slerp(const glm::quat &a, const glm::quat &b, float t) {
+  return glm::slerp(a, b, t);
+}
+
+glm::vec3 lerp(const glm::vec3 &a, const glm::vec3 &b, float t) {
+  return glm::mix(a, b, t);
+}
+} // namespace
+
+bool JointTrack::isEmpty() const {
+  return rotationFrames.empty() && translationFrames.empty();
+}
+
+glm::quat JointTrack::sampleRotation(float frame) const {
+  return sample(rotationFrames, rotations, frame, slerp);
+}
+
+glm::vec3 JointTrack::sampleTranslation(float frame) const {
+  return sample(translationFrames, translations, frame, lerp);
+}
+
+Animation::Animation()
+    : tracks(), animatedJoints(), cache(), firstFrame(0), lastFrame(47),
+      fps(24) {
+  invalidate();
+}
+
+void Animation::setFrameRange(int first, int last) {
+  firstFrame = first;
+  lastFrame = std::max(first, last);
+  invalidate();
+}
+
+int Animation::getFirstFrame() const { return firstFrame; }
+
+int Animation::getLastFrame() const { return lastFrame; }
+
+void Animation::setFramesPerSecond(float fps) { this->fps = fps; }
+
+float Animation::getFramesPerSecond() const { return fps; }
+
+void Animation::setRotationKey(int joint, float frame, glm::quat rotation) {
+  JointTrack &track = getTrack(joint);
+  insertKey(track.rotationFrames, track.rotations, frame,
+            glm::normalize(rotation));
+  invalidate();
+}
+
+void Animation::setTranslationKey(int joint, float frame,
+                                  glm::vec3 translation) {
+  JointTrack &track = getTrack(joint);
+  insertKey(track.translationFrames, track.translations, frame, translation);
+  invalidate();
+}
+
+void Animation::clear() {
+  tracks.clear();
+  animatedJoints.clear();
+  invalidate();
+}
+
+bool Animation::isEmpty() const { return animatedJoints.empty(); }
+
+const std::vector<int> &Animation::getAnimatedJoints() const {
+  return animatedJoints;
+}
+
+void Animation::apply(int frame, Skeleton &skeleton) {
+  if (fits(skeleton)) {
+    setPose(getPose(std::clamp(frame, firstFrame, lastFrame)), skeleton);
+  }
+}
+
+void Animation::sample(float frame, Skeleton &skeleton) const {
+  if (fits(skeleton)) {
+    Pose pose;
+    samplePose(frame, pose);
+    setPose(pose, skeleton);
+  }
+}
+
+JointTrack &Animation::getTrack(int joint) {
+  if ((size_t)joint >= tracks.size()) {
+    tracks.resize(joint + 1);
+  }
+  if (tracks[joint].isEmpty()) {
+    animatedJoints.insert(std::lower_bound(animatedJoints.begin(),
+                                           animatedJoints.end(), joint),
+                          joint);
+  }
+  return tracks[joint];
+}
+
+bool Animation::fits(const Skeleton &skeleton) const {
+  return !isEmpty() && tracks.size() <= (size_t)skeleton.getJointCount();
+}
+
+void Animation::samplePose(float frame, Pose &pose) const {
+  pose.rotations.resize(animatedJoints.size());
+  pose.translations.resize(animatedJoints.size());
+  for (size_t k = 0; k < animatedJoints.size(); ++k) {
+    const JointTrack &track = tracks[animatedJoints[k]];
+    if (!track.rotationFrames.empty()) {
+      // the skeleton stores normalized rotations, so normalizing here lets
+      // a joint that holds still compare equal to its stored rotation
+      pose.rotations[k] = glm::normalize(track.sampleRotation(frame));
+    }
+    if (!track.translationFrames.empty()) {
+      pose.translations[k] = track.sampleTranslation(frame);
+    }
+  }
+}
+
+const Animation::Pose &Animation::getPose(int frame) {
+  Pose &pose = cache[frame - firstFrame];
+  if (pose.rotations.empty()) {
+    samplePose(frame, pose);
+  }
+  return pose;
+}
+
+void Animation::setPose(const Pose &pose, Skeleton &skeleton) const {
+  for (size_t k = 0; k < animatedJoints.size(); ++k) {
+    int joint = animatedJoints[k];
+    const JointTrack &track = tracks[joint];
+    // a channel without keys stays as the user left it
+    if (!track.rotationFrames.empty() &&
+        pose.rotations[k] != skeleton.getRotation(joint)) {
+      skeleton.setRotation(joint, pose.rotations[k]);
+    }
+    if (!track.translationFrames.empty() &&
+        pose.translations[k] != skeleton.getTranslation(joint)) {
+      skeleton.setTranslation(joint, pose.translations[k]);
+    }
+  }
+}
+
+void Animation::invalidate() {
+  cache.clear();
+  cache.resize(lastFrame - firstFrame + 1);
+}
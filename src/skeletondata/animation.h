@@ -0,0 +1,80 @@
+#pragma once
+
+#include "skeleton.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <vector>
+
+// Keyframes of one joint's local rotation and translation. Each channel is
+// sorted by frame and only holds the keys that were set on it.
+struct JointTrack {
+  std::vector<float> rotationFrames;
+  std::vector<glm::quat> rotations;
+  std::vector<float> translationFrames;
+  std::vector<glm::vec3> translations;
+
+  bool isEmpty() const;
+  glm::quat sampleRotation(float frame) const; // Slerps between keys
+  glm::vec3 sampleTranslation(float frame) const; // Lerps between keys
+};
+
+/**
+ * Keyframe animation of a skeleton's local transforms over a range of whole
+ * frames.
+ *
+ * Sampling a frame interpolates every animated joint's tracks. The result is
+ * cached per frame, so once a frame has been shown, playing it again only
+ * copies the cached pose into the Skeleton. Setting a key clears the cache.
+ *
+ * Joints without keys are left alone, so they can still be posed by hand.
+ */
+class Animation {
+public:
+  Animation();
+
+  void setFrameRange(int first, int last);
+  int getFirstFrame() const;
+  int getLastFrame() const;
+  void setFramesPerSecond(float fps);
+  float getFramesPerSecond() const;
+
+  // Adds a key, replacing any key of the same channel at that frame
+  void setRotationKey(int joint, float frame, glm::quat rotation);
+  void setTranslationKey(int joint, float frame, glm::vec3 translation);
+  void clear();
+  bool isEmpty() const;
+  const std::vector<int> &getAnimatedJoints() const; // Sorted by id
+
+  /**
+   * Poses skeleton at frame, which is clamped to the frame range. Only the
+   * joints whose transform differs from the skeleton's current one are
+   * marked dirty, so consumers see the smallest possible changed range.
+   */
+  void apply(int frame, Skeleton &skeleton);
+  // Poses skeleton at frame without going through the cache, so separate
+  // copies of a skeleton can be posed from several threads at once
+  void sample(float frame, Skeleton &skeleton) const;
+
+private:
+  // The sampled transforms of every animated joint at one frame, in the
+  // order of animatedJoints
+  struct Pose {
+    std::vector<glm::quat> rotations;
+    std::vector<glm::vec3> translations;
+  };
+
+  std::vector<JointTrack> tracks; // Indexed by joint id
+  std::vector<int> animatedJoints;
+  std::vector<Pose> cache; // Indexed by frame - firstFrame; empty if unsampled
+  int firstFrame, lastFrame;
+  float fps;
+
+  JointTrack &getTrack(int joint);
+  bool fits(const Skeleton &skeleton) const; // Whether every joint exists
+  void samplePose(float frame, Pose &pose) const;
+  const Pose &getPose(int frame);
+  void setPose(const Pose &pose, Skeleton &skeleton) const;
+  void invalidate();
+};
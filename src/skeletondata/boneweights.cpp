@@ -0,0 +1,193 @@
+#include "boneweights.h"
+
+#include "parallel.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+// Bones per leaf of the hierarchy
+constexpr int LeafSize = 4;
+// Vertices per parallel work item
+constexpr size_t BlockSize = 4096;
+
+// Squared distance from point to the box [min, max], 0 inside it
+float boxDistance2(glm::vec3 point, glm::vec3 min, glm::vec3 max) {
+  glm::vec3 d = glm::max(glm::max(min - point, point - max), glm::vec3(0));
+  return glm::dot(d, d);
+}
+} // namespace
+
+float BoneSegment::distance2(glm::vec3 point) const {
+  glm::vec3 axis = end - start;
+  float length2 = glm::dot(axis, axis);
+  float t = length2 > 0
+                ? glm::clamp(glm::dot(point - start, axis) / length2, 0.f, 1.f)
+                : 0.f;
+  glm::vec3 d = point - (start + t * axis);
+  return glm::dot(d, d);
+}
+
+BoneBvh::BoneBvh(Skeleton &skeleton) : bones(), nodes() {
+  const std::vector<glm::mat4> &worlds = skeleton.getWorldTransforms();
+  int jointCount = skeleton.getJointCount();
+
+  for (int i = 0; i < jointCount; ++i) {
+    glm::vec3 origin(worlds[i][3]);
+    int parent = skeleton.getParent(i);
+    if (parent >= 0) {
+      bones.push_back({glm::vec3(worlds[parent][3]), origin, parent});
+    }
+    if (skeleton.getSubtreeEnd(i) == i + 1) {
+      bones.push_back({origin, origin, i});
+    }
+  }
+
+  if (!bones.empty()) {
+    nodes.reserve(2 * bones.size() / LeafSize + 1);
+    build(0, bones.size());
+  }
+}
+
+int BoneBvh::getBoneCount() const { return bones.size(); }
+
+int BoneBvh::findNearest(glm::vec3 point, int n, int *joints,
+                         float *distances2) const {
+  int found = 0;
+  if (nodes.empty() || n <= 0) {
+    return found;
+  }
+
+  // joints[] is kept sorted, so the last entry bounds what is worth visiting
+  auto worst = [&] {
+    return found < n ? INFINITY : distances2[found - 1];
+  };
+
+  // nodes waiting to be visited, with the distance to their bounds
+  int stack[64];
+  float stackDistance2[64];
+  int top = 0;
+  stack[top] = 0;
+  stackDistance2[top++] = 0;
+  while (top > 0) {
+    --top;
+    if (stackDistance2[top] >= worst()) {
+      continue;
+    }
+    const Node &node = nodes[stack[top]];
+
+    if (node.count == 0) {
+      // push the nearer child last so it is visited first and the bound
+      // tightens sooner
+      int first = stack[top] + 1;
+      int second = node.second;
+      float d1 = boxDistance2(point, nodes[first].min, nodes[first].max);
+      float d2 = boxDistance2(point, nodes[second].min, nodes[second].max);
+      if (d1 < d2) {
+        std::swap(first, second);
+        std::swap(d1, d2);
+      }
+      stack[top] = first;
+      stackDistance2[top++] = d1;
+      stack[top] = second;
+      stackDistance2[top++] = d2;
+      continue;
+    }
+
+    for (int b = node.first; b < node.first + node.count; ++b) {
+      const BoneSegment &bone = bones[b];
+      float d = bone.distance2(point);
+      if (d >= worst()) {
+        continue;
+      }
+
+      // a joint owning several bones only counts once, at its nearest
+      int slot = std::find(joints, joints + found, bone.joint) - joints;
+      if (slot < found) {
+        if (d >= distances2[slot]) {
+          continue;
+        }
+      } else {
+        slot = found < n ? found++ : n - 1;
+      }
+      for (; slot > 0 && distances2[slot - 1] > d; --slot) {
+        joints[slot] = joints[slot - 1];
+        distances2[slot] = distances2[slot - 1];
+      }
+      joints[slot] = bone.joint;
+      distances2[slot] = d;
+    }
+  }
+  return found;
+}
+
+void BoneBvh::build(int first, int count) {
+  int index = nodes.size();
+  nodes.push_back(Node());
+
+  glm::vec3 min(INFINITY), max(-INFINITY);
+  glm::vec3 centerMin(INFINITY), centerMax(-INFINITY);
+  for (int b = first; b < first + count; ++b) {
+    const BoneSegment &bone = bones[b];
+    min = glm::min(min, glm::min(bone.start, bone.end));
+    max = glm::max(max, glm::max(bone.start, bone.end));
+    glm::vec3 center = 0.5f * (bone.start + bone.end);
+    centerMin = glm::min(centerMin, center);
+    centerMax = glm::max(centerMax, center);
+  }
+  nodes[index].min = min;
+  nodes[index].max = max;
+
+  if (count <= LeafSize) {
+    nodes[index].first = first;
+    nodes[index].count = count;
+    nodes[index].second = -1;
+    return;
+  }
+
+  // split at the median bone along the axis the centers spread most on
+  glm::vec3 extent = centerMax - centerMin;
+  int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2)
+                                 : (extent.y > extent.z ? 1 : 2);
+  int half = count / 2;
+  std::nth_element(bones.begin() + first, bones.begin() + first + half,
+                   bones.begin() + first + count,
+                   [axis](const BoneSegment &a, const BoneSegment &b) {
+                     return a.start[axis] + a.end[axis] <
+                            b.start[axis] + b.end[axis];
+                   });
+
+  nodes[index].first = first;
+  nodes[index].count = 0;
+  build(first, half);
+  nodes[index].second = nodes.size();
+  build(first + half, count - half);
+}
+
+namespace boneweights {
+void compute(Skeleton &skeleton, const glm::vec3 *positions, size_t count,
+             int influenceCount, float falloff, SkinInfluence *out) {
+  BoneBvh bvh(skeleton);
+  int n = std::clamp(influenceCount, 1, SkinInfluence::MaxInfluences);
+
+  parallel::forBlocks(count, BlockSize, [&](size_t begin, size_t end) {
+    int joints[SkinInfluence::MaxInfluences];
+    float distances2[SkinInfluence::MaxInfluences];
+    float weights[SkinInfluence::MaxInfluences];
+
+    for (size_t i = begin; i < end; ++i) {
+      int found = bvh.findNearest(positions[i], n, joints, distances2);
+
+      // weights relative to the nearest bone keep the powers in range; a
+      // vertex on a bone is bound to it alone
+      float nearest = found ? distances2[0] : 0;
+      for (int k = 0; k < found; ++k) {
+        weights[k] = nearest > 0 ? std::pow(nearest / distances2[k],
+                                            0.5f * falloff)
+                                 : (k == 0 ? 1.f : 0.f);
+      }
+      out[i] = found ? SkinInfluence(joints, weights, found) : SkinInfluence();
+    }
+  });
+}
+} // namespace boneweights
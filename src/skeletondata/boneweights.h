@@ -0,0 +1,67 @@
+#pragma once
+
+#include "skeleton.h"
+#include "skinning.h"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+// The segment from a joint to one of its children, which the joint rotates.
+// Joints without children get a zero-length segment at their origin.
+struct BoneSegment {
+  glm::vec3 start;
+  glm::vec3 end;
+  int joint; // Id of the joint that moves the segment
+
+  float distance2(glm::vec3 point) const; // Squared distance to the segment
+};
+
+/**
+ * A bounding volume hierarchy over the bone segments of a skeleton, used to
+ * find the joints whose bones pass closest to a point without testing every
+ * bone.
+ *
+ * Nodes are stored depth first, so a node's first child directly follows it
+ * and only the second child's index is kept. Leaves hold a few bones each.
+ */
+class BoneBvh {
+public:
+  explicit BoneBvh(Skeleton &skeleton); // Uses current world transforms
+
+  int getBoneCount() const;
+
+  /**
+   * Finds the (at most) n distinct joints with a bone nearest to point.
+   * Joints are written sorted by increasing distance, along with their
+   * squared distances. Returns the number found.
+   */
+  int findNearest(glm::vec3 point, int n, int *joints, float *distances2) const;
+
+private:
+  struct Node {
+    glm::vec3 min, max; // Bounds of every bone below this node
+    int first, count;   // Range of bones in a leaf; count is 0 otherwise
+    int second;         // Index of the second child of an inner node
+  };
+
+  std::vector<BoneSegment> bones;
+  std::vector<Node> nodes;
+
+  void build(int first, int count);
+};
+
+/**
+ * Automatic skin weights from the distance of each vertex to the bones of a
+ * skeleton, as used by Mesh::bindSkeleton.
+ *
+ * Every vertex is bound to the influenceCount joints whose bones pass
+ * closest to it, weighted by inverse distance raised to falloff and
+ * normalized. Higher falloff values give tighter, more rigid regions around
+ * each bone. Vertices are processed in parallel blocks.
+ */
+namespace boneweights {
+void compute(Skeleton &skeleton, const glm::vec3 *positions, size_t count,
+             int influenceCount, float falloff, SkinInfluence *out);
+} // namespace boneweights
@@ -0,0 +1,316 @@
+#include "heatweights.h"
+
+#include "boneweights.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+namespace {
+// Conjugate gradients stops once the residual shrinks by this factor
+constexpr double Tolerance = 1e-4;
+constexpr int MaxIterations = 4000;
+// Weights below this are treated as no influence
+constexpr float MinWeight = 1e-3f;
+// Joints solved together, sharing every pass over the matrix
+constexpr int Batch = 4;
+// Falloff of the distance weights solves start from without a guess
+constexpr float GuessFalloff = 2.f;
+
+// A symmetric sparse matrix in compressed sparse row form
+struct SparseMatrix {
+  std::vector<int> rowStart; // Entries of row i are [rowStart[i], [i + 1])
+  std::vector<int> cols;
+  std::vector<double> values;
+
+  size_t size() const { return rowStart.size() - 1; }
+
+  // Multiplies Batch vectors at once, stored interleaved: element i of
+  // vector k is at i * Batch + k
+  void multiply(const std::vector<double> &x, std::vector<double> &out) const {
+    for (size_t i = 0; i < size(); ++i) {
+      double sum[Batch] = {};
+      for (int e = rowStart[i]; e < rowStart[i + 1]; ++e) {
+        const double *xc = &x[cols[e] * Batch];
+        for (int k = 0; k < Batch; ++k) {
+          sum[k] += values[e] * xc[k];
+        }
+      }
+      for (int k = 0; k < Batch; ++k) {
+        out[i * Batch + k] = sum[k];
+      }
+    }
+  }
+};
+
+struct Entry {
+  int row, col;
+  double value;
+};
+
+// Sums duplicate entries into a CSR matrix with rows of the given count
+SparseMatrix assemble(std::vector<Entry> &entries, size_t rows) {
+  std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) {
+    return a.row != b.row ? a.row < b.row : a.col < b.col;
+  });
+
+  SparseMatrix m;
+  m.rowStart.assign(rows + 1, 0);
+  for (size_t e = 0; e < entries.size(); ++e) {
+    const Entry &entry = entries[e];
+    if (e > 0 && entry.row == entries[e - 1].row &&
+        entry.col == entries[e - 1].col) {
+      m.values.back() += entry.value;
+      continue;
+    }
+    m.cols.push_back(entry.col);
+    m.values.push_back(entry.value);
+    ++m.rowStart[entry.row + 1];
+  }
+  for (size_t i = 0; i < rows; ++i) {
+    m.rowStart[i + 1] += m.rowStart[i];
+  }
+  return m;
+}
+
+/**
+ * Solves a x = b for symmetric positive definite a by conjugate gradients,
+ * preconditioned by the inverse diagonal of a. Runs Batch independent
+ * solves in lockstep, with b and x interleaved as in SparseMatrix::multiply;
+ * x holds the initial guesses. The matrix is read once per iteration for all
+ * of them, which is what bounds the speed of a lone solve.
+ */
+void solve(const SparseMatrix &a, const std::vector<double> &inverseDiagonal,
+           const std::vector<double> &b, std::vector<double> &x) {
+  size_t n = a.size();
+  std::vector<double> r(n * Batch), z(n * Batch), p(n * Batch), ap(n * Batch);
+
+  double rz[Batch] = {}, limit[Batch] = {}, rr[Batch] = {};
+  a.multiply(x, ap);
+  for (size_t i = 0; i < n; ++i) {
+    for (int k = 0; k < Batch; ++k) {
+      size_t e = i * Batch + k;
+      r[e] = b[e] - ap[e];
+      z[e] = inverseDiagonal[i] * r[e];
+      rz[k] += r[e] * z[e];
+      rr[k] += r[e] * r[e];
+      limit[k] += Tolerance * Tolerance * b[e] * b[e];
+    }
+  }
+  p = z;
+
+  for (int it = 0; it < MaxIterations; ++it) {
+    // finished systems keep their solution by taking zero-length steps
+    bool active[Batch];
+    bool anyActive = false;
+    for (int k = 0; k < Batch; ++k) {
+      active[k] = rr[k] > limit[k];
+      anyActive |= active[k];
+    }
+    if (!anyActive) {
+      break;
+    }
+
+    a.multiply(p, ap);
+    double pap[Batch] = {};
+    for (size_t e = 0; e < n * Batch; ++e) {
+      pap[e % Batch] += p[e] * ap[e];
+    }
+
+    double alpha[Batch], rzNext[Batch] = {};
+    for (int k = 0; k < Batch; ++k) {
+      alpha[k] = active[k] ? rz[k] / pap[k] : 0;
+      rr[k] = 0;
+    }
+    for (size_t i = 0; i < n; ++i) {
+      for (int k = 0; k < Batch; ++k) {
+        size_t e = i * Batch + k;
+        x[e] += alpha[k] * p[e];
+        r[e] -= alpha[k] * ap[e];
+        z[e] = inverseDiagonal[i] * r[e];
+        rzNext[k] += r[e] * z[e];
+        rr[k] += r[e] * r[e];
+      }
+    }
+
+    double beta[Batch];
+    for (int k = 0; k < Batch; ++k) {
+      beta[k] = active[k] ? rzNext[k] / rz[k] : 0;
+      rz[k] = rzNext[k];
+    }
+    for (size_t i = 0; i < n; ++i) {
+      for (int k = 0; k < Batch; ++k) {
+        size_t e = i * Batch + k;
+        p[e] = z[e] + beta[k] * p[e];
+      }
+    }
+  }
+}
+} // namespace
+
+namespace heatweights {
+std::vector<SkinInfluence> compute(Skeleton &skeleton,
+                                   const std::vector<glm::vec3> &positions,
+                                   const std::vector<glm::ivec3> &triangles,
+                                   int influenceCount,
+                                   const std::vector<SkinInfluence> &guess,
+                                   const Progress &progress) {
+  size_t n = positions.size();
+  int jointCount = skeleton.getJointCount();
+  std::vector<SkinInfluence> result(n);
+  if (n == 0 || jointCount == 0) {
+    return result;
+  }
+
+  // cotangent Laplacian and lumped areas; each corner's cotangent weighs the
+  // opposite edge
+  std::vector<Entry> entries;
+  entries.reserve(triangles.size() * 9 + n);
+  std::vector<double> mass(n, 0);
+  for (const glm::ivec3 &tri : triangles) {
+    glm::vec3 p[3] = {positions[tri[0]], positions[tri[1]], positions[tri[2]]};
+    double area2 = glm::length(glm::cross(p[1] - p[0], p[2] - p[0]));
+    if (area2 <= 0) {
+      continue;
+    }
+
+    for (int c = 0; c < 3; ++c) {
+      int i = tri[(c + 1) % 3], j = tri[(c + 2) % 3];
+      glm::vec3 e1 = p[(c + 1) % 3] - p[c], e2 = p[(c + 2) % 3] - p[c];
+      double w = 0.5 * glm::dot(e1, e2) / area2;
+      entries.push_back({i, j, -w});
+      entries.push_back({j, i, -w});
+      entries.push_back({i, i, w});
+      entries.push_back({j, j, w});
+      mass[tri[c]] += area2 / 6;
+    }
+  }
+
+  // heat flows in from the nearest bone of each vertex
+  BoneBvh bvh(skeleton);
+  std::vector<int> nearestJoint(n);
+  std::vector<double> heat(n);
+  double meanMass = 0;
+  for (double m : mass) {
+    meanMass += m / n;
+  }
+  parallel::forBlocks(n, 4096, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      float d2;
+      bvh.findNearest(positions[i], 1, &nearestJoint[i], &d2);
+      // vertices outside any face still need some mass to stay solvable
+      double m = mass[i] > 0 ? mass[i] : meanMass;
+      heat[i] = m / std::max<double>(d2, 1e-8);
+    }
+  });
+  for (size_t i = 0; i < n; ++i) {
+    entries.push_back({(int)i, (int)i, heat[i]});
+  }
+
+  SparseMatrix a = assemble(entries, n);
+  entries = std::vector<Entry>();
+
+  // the preconditioner is shared by every solve
+  std::vector<double> inverseDiagonal(n, 1);
+  for (size_t i = 0; i < n; ++i) {
+    for (int e = a.rowStart[i]; e < a.rowStart[i + 1]; ++e) {
+      if (a.cols[e] == (int)i && a.values[e] > 0) {
+        inverseDiagonal[i] = 1 / a.values[e];
+      }
+    }
+  }
+
+  // a previous binding already has the shape of the solution, so the solves
+  // only have to correct it; weights by distance to the bones are the next
+  // best thing
+  std::vector<SkinInfluence> start = guess;
+  if (start.size() != n) {
+    start.resize(n);
+    boneweights::compute(skeleton, positions.data(), n,
+                         SkinInfluence::MaxInfluences, GuessFalloff,
+                         start.data());
+  }
+
+  // one solve per joint, in batches; joints no vertex is nearest to get no
+  // weight at all
+  std::vector<std::vector<float>> weights(jointCount);
+  std::atomic<int> solved(0);
+  size_t batches = (jointCount + Batch - 1) / Batch;
+  parallel::forBlocks(batches, 1, [&](size_t begin, size_t end) {
+    for (size_t batch = begin; batch < end; ++batch) {
+      int first = batch * Batch;
+      int count = std::min(Batch, jointCount - first);
+
+      std::vector<double> b(n * Batch, 0), x(n * Batch, 0);
+      bool used[Batch] = {};
+      for (size_t i = 0; i < n; ++i) {
+        int k = nearestJoint[i] - first;
+        if (k >= 0 && k < count) {
+          b[i * Batch + k] = heat[i];
+          used[k] = true;
+        }
+        const SkinInfluence &inf = start[i];
+        for (int c = 0; c < inf.count; ++c) {
+          int j = inf.joints[c] - first;
+          if (j >= 0 && j < count) {
+            x[i * Batch + j] = inf.getWeight(c);
+          }
+        }
+      }
+
+      solve(a, inverseDiagonal, b, x);
+
+      for (int k = 0; k < count; ++k) {
+        if (used[k]) {
+          std::vector<float> &w = weights[first + k];
+          w.resize(n);
+          for (size_t i = 0; i < n; ++i) {
+            w[i] = std::clamp<float>(x[i * Batch + k], 0, 1);
+          }
+        }
+      }
+
+      int done = solved += count;
+      if (progress) {
+        progress(done, jointCount);
+      }
+    }
+  });
+
+  // keep the heaviest joints of every vertex
+  int count = std::clamp(influenceCount, 1, SkinInfluence::MaxInfluences);
+  parallel::forBlocks(n, 4096, [&](size_t begin, size_t end) {
+    std::vector<std::pair<float, int>> candidates;
+    int ids[SkinInfluence::MaxInfluences];
+    float w[SkinInfluence::MaxInfluences];
+
+    for (size_t i = begin; i < end; ++i) {
+      candidates.clear();
+      for (int j = 0; j < jointCount; ++j) {
+        if (!weights[j].empty() && weights[j][i] > MinWeight) {
+          candidates.push_back({weights[j][i], j});
+        }
+      }
+
+      int k = std::min<int>(count, candidates.size());
+      std::partial_sort(candidates.begin(), candidates.begin() + k,
+                        candidates.end(),
+                        [](auto &a, auto &b) { return a.first > b.first; });
+      for (int c = 0; c < k; ++c) {
+        w[c] = candidates[c].first;
+        ids[c] = candidates[c].second;
+      }
+
+      // a vertex the heat never reached keeps its nearest bone
+      if (k == 0) {
+        ids[0] = nearestJoint[i];
+        w[0] = 1;
+        k = 1;
+      }
+      result[i] = SkinInfluence(ids, w, k);
+    }
+  });
+  return result;
+}
+} // namespace heatweights
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "skeleton.h"
+#include "skinning.h"
+
+#include <glm/glm.hpp>
+
+#include <functional>
+#include <vector>
+
+/**
+ * Bone heat skin weights: each joint's weights are the steady state of heat
+ * diffusing over the surface from the parts nearest to its bones.
+ *
+ * For every joint j this solves (L + M H) w_j = M H p_j, where L is the
+ * cotangent Laplacian of the mesh, M its lumped vertex areas, H the inverse
+ * squared distance from each vertex to its nearest bone, and p_j is 1 where
+ * that bone belongs to j. Unlike weighting by distance, heat does not jump
+ * across gaps in the surface, so e.g. neighbouring legs stay separate.
+ *
+ * The system matrix is the same for every joint, so it is assembled and
+ * preconditioned once, and the joints are solved in parallel on the worker
+ * pool by Jacobi-preconditioned conjugate gradients. Each solve starts from a
+ * previous binding's weights for its joint, which are usually close already.
+ */
+namespace heatweights {
+// Reports the number of joints solved so far. Called from worker threads.
+using Progress = std::function<void(int solved, int total)>;
+
+// Computes the influences of every vertex of a triangle mesh, keeping the
+// influenceCount heaviest joints. The solves start from guess, indexed like
+// positions, which is typically the mesh's current binding; if it is empty,
+// they start from weights by distance to the bones.
+std::vector<SkinInfluence> compute(Skeleton &skeleton,
+                                   const std::vector<glm::vec3> &positions,
+                                   const std::vector<glm::ivec3> &triangles,
+                                   int influenceCount,
+                                   const std::vector<SkinInfluence> &guess = {},
+                                   const Progress &progress = nullptr);
+} // namespace heatweights
@@ -0,0 +1,166 @@
+#include "ik.h"
+
+#include <algorithm>
+
+namespace {
+// Iterations per solve; the next frame's solve carries on from the result
+constexpr int MaxIterations = 8;
+// The effector is close enough once within this fraction of the chain length
+constexpr float Tolerance = 1e-4f;
+// Directions shorter than this cannot be turned towards
+constexpr float MinLength = 1e-6f;
+
+glm::vec3 origin(const glm::mat4 &m) { return glm::vec3(m[3]); }
+
+// The shortest rotation taking unit vector a to unit vector b. Built from the
+// half-way quaternion, which stays accurate for the tiny turns of a nearly
+// converged solve where thresholds on the angle would stall it.
+glm::quat shortestArc(glm::vec3 a, glm::vec3 b) {
+  float w = 1 + glm::dot(a, b);
+  if (w > MinLength) {
+    glm::vec3 axis = glm::cross(a, b);
+    return glm::normalize(glm::quat(w, axis.x, axis.y, axis.z));
+  }
+
+  // opposite directions: half a turn about any perpendicular axis
+  glm::vec3 axis = glm::cross(glm::vec3(1, 0, 0), a);
+  if (glm::length(axis) < MinLength) {
+    axis = glm::cross(glm::vec3(0, 1, 0), a);
+  }
+  axis = glm::normalize(axis);
+  return glm::quat(0, axis.x, axis.y, axis.z);
+}
+} // namespace
+
+IkChain::IkChain(const Skeleton &skeleton, int root, int effector)
+    : joints(), rotations(), worlds(), positions(), lengths(), base(1) {
+  for (int j = effector; j >= 0; j = skeleton.getParent(j)) {
+    joints.push_back(j);
+    if (j == root) {
+      std::reverse(joints.begin(), joints.end());
+      return;
+    }
+  }
+  joints.clear();
+}
+
+bool IkChain::isEmpty() const { return joints.size() < 2; }
+
+int IkChain::getRoot() const { return joints.empty() ? -1 : joints.front(); }
+
+int IkChain::getEffector() const {
+  return joints.empty() ? -1 : joints.back();
+}
+
+float IkChain::solve(Skeleton &skeleton, glm::vec3 target, IkMethod method) {
+  if (isEmpty()) {
+    return 0;
+  }
+
+  int n = joints.size();
+  int parent = skeleton.getParent(joints[0]);
+  base = parent >= 0 ? skeleton.getWorldTransform(parent) : glm::mat4(1);
+  rotations.resize(n);
+  worlds.resize(n);
+  for (int i = 0; i < n; ++i) {
+    rotations[i] = skeleton.getRotation(joints[i]);
+  }
+  updateWorlds(skeleton, 0);
+
+  float reach = 0;
+  for (int i = 0; i + 1 < n; ++i) {
+    reach += glm::length(origin(worlds[i + 1]) - origin(worlds[i]));
+  }
+  float error = glm::length(target - origin(worlds[n - 1]));
+  for (int it = 0; it < MaxIterations && error > Tolerance * reach; ++it) {
+    if (method == IkMethod::FABRIK) {
+      iterateFabrik(skeleton, target);
+    } else {
+      iterateCcd(skeleton, target);
+    }
+    error = glm::length(target - origin(worlds[n - 1]));
+  }
+
+  // the effector's own rotation is not part of the solve
+  for (int i = 0; i + 1 < n; ++i) {
+    if (rotations[i] != skeleton.getRotation(joints[i])) {
+      skeleton.setRotation(joints[i], rotations[i]);
+    }
+  }
+  return error;
+}
+
+void IkChain::updateWorlds(const Skeleton &skeleton, int first) {
+  for (size_t i = first; i < joints.size(); ++i) {
+    int j = joints[i];
+    worlds[i] = (i > 0 ? worlds[i - 1] : base) *
+                Skeleton::compose(skeleton.getTranslation(j), rotations[i],
+                                  skeleton.getScale(j));
+  }
+}
+
+void IkChain::turn(const Skeleton &skeleton, int i, glm::vec3 from,
+                   glm::vec3 to) {
+  // a joint's rotation applies in its parent's frame, so the turn is found
+  // there; this also accounts for scaled parents
+  glm::mat3 toParent = glm::inverse(glm::mat3(i > 0 ? worlds[i - 1] : base));
+  glm::vec3 a = toParent * from, b = toParent * to;
+  if (glm::length(a) < MinLength || glm::length(b) < MinLength) {
+    return;
+  }
+
+  glm::quat delta = shortestArc(glm::normalize(a), glm::normalize(b));
+  glm::quat rotation = glm::normalize(delta * rotations[i]);
+  const JointLimit &limit = skeleton.getLimit(joints[i]);
+  rotations[i] = limit.isLimited() ? limit.clamp(rotation) : rotation;
+  updateWorlds(skeleton, i);
+}
+
+void IkChain::iterateCcd(const Skeleton &skeleton, glm::vec3 target) {
+  // from the joint nearest the effector up to the root, turn each so the
+  // effector points at the target
+  int n = joints.size();
+  for (int i = n - 2; i >= 0; --i) {
+    glm::vec3 pivot = origin(worlds[i]);
+    turn(skeleton, i, origin(worlds[n - 1]) - pivot, target - pivot);
+  }
+}
+
+void IkChain::iterateFabrik(const Skeleton &skeleton, glm::vec3 target) {
+  int n = joints.size();
+  positions.resize(n);
+  lengths.resize(n);
+  for (int i = 0; i < n; ++i) {
+    positions[i] = origin(worlds[i]);
+  }
+  for (int i = 0; i + 1 < n; ++i) {
+    lengths[i] = glm::length(positions[i + 1] - positions[i]);
+  }
+
+  // pull the chain to the target from the effector end, then back to the
+  // root, keeping every bone's length
+  auto place = [&](int i, int towards) {
+    glm::vec3 d = positions[i] - positions[towards];
+    float length = glm::length(d);
+    if (length > MinLength) {
+      positions[i] =
+          positions[towards] + d * (lengths[std::min(i, towards)] / length);
+    }
+  };
+  glm::vec3 root = positions[0];
+  positions[n - 1] = target;
+  for (int i = n - 2; i >= 0; --i) {
+    place(i, i + 1);
+  }
+  positions[0] = root;
+  for (int i = 1; i < n; ++i) {
+    place(i, i - 1);
+  }
+
+  // then turn each joint, root first, to point at its child's new position;
+  // limits may keep it short, which the next iteration starts from
+  for (int i = 0; i + 1 < n; ++i) {
+    glm::vec3 pivot = origin(worlds[i]);
+    turn(skeleton, i, origin(worlds[i + 1]) - pivot, positions[i + 1] - pivot);
+  }
+}
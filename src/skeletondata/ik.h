@@ -0,0 +1,54 @@
+#pragma once
+
+#include "skeleton.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <vector>
+
+enum class IkMethod {
+  CCD = 0,   // Cyclic coordinate descent: turns one joint at a time
+  FABRIK = 1 // Forward and backward reaching: moves positions, then turns
+};
+
+/**
+ * A chain of joints from a root down to an end effector, posed by inverse
+ * kinematics so that the effector reaches for a target.
+ *
+ * Every solve starts from the skeleton's current rotations, which are the
+ * previous solve's result while dragging, so a few iterations per frame are
+ * enough to follow the target. The chain is posed on its own copy of its
+ * world transforms, starting from the root's parent's cached one, and only
+ * the final rotations are written back to the Skeleton. Rotations are kept
+ * within each joint's JointLimit after every step.
+ */
+class IkChain {
+public:
+  // The chain from root down to effector. If root is not an ancestor of
+  // effector the chain is empty and solving does nothing.
+  IkChain(const Skeleton &skeleton, int root, int effector);
+
+  bool isEmpty() const;
+  int getRoot() const;
+  int getEffector() const;
+
+  // Returns the distance left between the effector and target
+  float solve(Skeleton &skeleton, glm::vec3 target, IkMethod method);
+
+private:
+  std::vector<int> joints; // Root first, effector last
+
+  // Scratch state of a solve, indexed like joints
+  std::vector<glm::quat> rotations;
+  std::vector<glm::mat4> worlds;
+  std::vector<glm::vec3> positions;
+  std::vector<float> lengths; // From each joint to the next
+  glm::mat4 base;             // World transform of the root's parent
+
+  void updateWorlds(const Skeleton &skeleton, int first);
+  // Turns joints[i] so its world direction from moves towards to
+  void turn(const Skeleton &skeleton, int i, glm::vec3 from, glm::vec3 to);
+  void iterateCcd(const Skeleton &skeleton, glm::vec3 target);
+  void iterateFabrik(const Skeleton &skeleton, glm::vec3 target);
+};
@@ -0,0 +1,138 @@
+#include "jointgizmo.h"
+
+#include "frameprofile.h"
+#include "utils.h"
+
+#include <cmath>
+
+namespace {
+const int CircleSegments = 12;
+const float CircleRadius = 0.5f;
+} // namespace
+
+JointGizmo::JointGizmo(RenderContext *context)
+    : Drawable(context), worldBuffer(0), worldTexture(0), infoBuffer(0),
+      infoTexture(0), info(), selected(-1), selectedNew(-1) {}
+
+JointGizmo::~JointGizmo() { destroy(); }
+
+void JointGizmo::create() {
+  // the bone comes first, so the shader can tell its ends by gl_VertexID:
+  // vertex 0 is moved to the parent's origin
+  std::vector<ColorVertex> verts = {
+      {glm::vec3(0), packColor(glm::vec4(1, 0, 0, 1))},
+      {glm::vec3(0), packColor(glm::vec4(1, 1, 0, 1))},
+  };
+  std::vector<GLuint> idx = {0, 1};
+
+  // a loop of edges around each axis, colored after it
+  const glm::vec3 axes[3] = {glm::vec3(1, 0, 0), glm::vec3(0, 1, 0),
+                             glm::vec3(0, 0, 1)};
+  for (int a = 0; a < 3; ++a) {
+    const glm::vec3 &u = axes[(a + 2) % 3];
+    const glm::vec3 &v = axes[(a + 1) % 3];
+    GLuint start = verts.size();
+    for (int i = 0; i < CircleSegments; ++i) {
+      float angle = i * 2 * PI / CircleSegments;
+      glm::vec3 pos = std::cos(angle) * u + std::sin(angle) * v;
+      verts.push_back({CircleRadius * pos, packColor(glm::vec4(axes[a], 1))});
+      idx.push_back(start + i);
+      idx.push_back(start + (i + 1) % CircleSegments);
+    }
+  }
+
+  count = idx.size();
+  uploadIdx(idx.data(), idx.size() * sizeof(GLuint));
+  uploadVert(verts);
+}
+
+GLenum JointGizmo::drawMode() { return GL_LINES; }
+
+GLsizei JointGizmo::getInstanceCount() { return info.size(); }
+
+void JointGizmo::setSkeleton(Skeleton &skeleton) {
+  frameprofile::Scope profile("JointGizmo::setSkeleton");
+  if (elemCount() < 0) {
+    create();
+  }
+  if (!worldBuffer) {
+    mp_context->glGenBuffers(1, &worldBuffer);
+    mp_context->glGenTextures(1, &worldTexture);
+    mp_context->glGenBuffers(1, &infoBuffer);
+    mp_context->glGenTextures(1, &infoTexture);
+  }
+
+  int jointCount = skeleton.getJointCount();
+  info.resize(jointCount);
+  for (int i = 0; i < jointCount; ++i) {
+    int parent = skeleton.getParent(i);
+    info[i] = glm::ivec2(parent < 0 ? i : parent, 0);
+  }
+  selected = -1; // highlighted again by the next update()
+
+  const std::vector<glm::mat4> &worlds = skeleton.getWorldTransforms();
+  mp_context->glState().bindBuffer(GL_TEXTURE_BUFFER, worldBuffer);
+  mp_context->glBufferData(GL_TEXTURE_BUFFER, worlds.size() * sizeof(glm::mat4),
+                           worlds.data(), GL_DYNAMIC_DRAW);
+  mp_context->glState().bindBuffer(GL_TEXTURE_BUFFER, infoBuffer);
+  mp_context->glBufferData(GL_TEXTURE_BUFFER, info.size() * sizeof(glm::ivec2),
+                           info.data(), GL_DYNAMIC_DRAW);
+
+  // reallocating the buffers' storage requires attaching them again
+  mp_context->glState().bindTexture(0, GL_TEXTURE_BUFFER, worldTexture);
+  mp_context->glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, worldBuffer);
+  mp_context->glState().bindTexture(0, GL_TEXTURE_BUFFER, infoTexture);
+  mp_context->glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32I, infoBuffer);
+}
+
+void JointGizmo::update(Skeleton &skeleton, int first, int end) {
+  frameprofile::Scope profile("JointGizmo::update");
+  if (info.size() != (size_t)skeleton.getJointCount()) {
+    return;
+  }
+
+  if (first < end) {
+    const std::vector<glm::mat4> &worlds = skeleton.getWorldTransforms();
+    mp_context->glState().bindBuffer(GL_TEXTURE_BUFFER, worldBuffer);
+    mp_context->glBufferSubData(GL_TEXTURE_BUFFER, first * sizeof(glm::mat4),
+                                (end - first) * sizeof(glm::mat4),
+                                &worlds[first]);
+  }
+
+  if (selectedNew != selected) {
+    setInfo(selected, 0);
+    setInfo(selectedNew, 1);
+    selected = selectedNew;
+  }
+}
+
+void JointGizmo::destroy() {
+  if (worldBuffer) {
+    mp_context->glState().deleteTexture(worldTexture);
+    mp_context->glState().deleteBuffer(worldBuffer);
+    mp_context->glState().deleteTexture(infoTexture);
+    mp_context->glState().deleteBuffer(infoBuffer);
+  }
+  worldBuffer = worldTexture = infoBuffer = infoTexture = 0;
+  info.clear();
+  selected = -1;
+  Drawable::destroy();
+}
+
+void JointGizmo::setSelected(int joint) { selectedNew = joint; }
+
+void JointGizmo::bind(GLuint worldUnit, GLuint infoUnit) {
+  mp_context->glState().bindTexture(worldUnit, GL_TEXTURE_BUFFER,
+                                    worldTexture);
+  mp_context->glState().bindTexture(infoUnit, GL_TEXTURE_BUFFER, infoTexture);
+}
+
+void JointGizmo::setInfo(int joint, int selection) {
+  if (joint < 0 || joint >= (int)info.size()) {
+    return;
+  }
+  info[joint].y = selection;
+  mp_context->glState().bindBuffer(GL_TEXTURE_BUFFER, infoBuffer);
+  mp_context->glBufferSubData(GL_TEXTURE_BUFFER, joint * sizeof(glm::ivec2),
+                              sizeof(glm::ivec2), &info[joint]);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "drawable.h"
+#include "rendercontext.h"
+#include "skeleton.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+/**
+ * Draws every joint of a skeleton as three axis circles and a bone to its
+ * parent, in one instanced draw.
+ *
+ * The circles and the bone are a single static mesh in joint space, uploaded
+ * once. Each instance is one joint, whose world transform, parent and
+ * selection the gizmo shader reads from texture buffers indexed by
+ * gl_InstanceID. Moving joints uploads only the world transforms of the range
+ * the Skeleton reports as changed, and a new selection only the two joints
+ * whose highlight changes; the mesh itself is never rebuilt.
+ */
+class JointGizmo : public Drawable {
+public:
+  JointGizmo(RenderContext *context);
+  ~JointGizmo();
+
+  void create() override; // Uploads the circles and bone
+  GLenum drawMode() override;
+  GLsizei getInstanceCount() override; // One per joint
+
+  // (Re)allocates the instance buffers for skeleton and fills every entry,
+  // creating the mesh the first time
+  void setSkeleton(Skeleton &skeleton);
+  // Uploads the world transforms of joints [first, end) and whatever the
+  // selection changed
+  void update(Skeleton &skeleton, int first, int end);
+  void destroy();
+
+  // Highlights a joint's circles, or none if -1. Takes effect on the next
+  // update(), so it is cheap to call outside of drawing.
+  void setSelected(int joint);
+
+  // Binds the world transform and joint info textures to the given units
+  void bind(GLuint worldUnit, GLuint infoUnit);
+
+private:
+  GLuint worldBuffer; // GL_TEXTURE_BUFFER storage, four RGBA32F texels per
+                      // joint
+  GLuint worldTexture;
+  GLuint infoBuffer; // One RG32I texel per joint: parent id and selection
+  GLuint infoTexture;
+  std::vector<glm::ivec2> info; // CPU copy of the info buffer
+
+  int selected;    // Joint highlighted in the info buffer, -1 if none
+  int selectedNew; // Joint to highlight on the next update()
+
+  void setInfo(int joint, int selection); // Uploads if the joint exists
+};
@@ -0,0 +1,96 @@
+#include "jointpalette.h"
+
+#include "frameprofile.h"
+
+JointPalette::JointPalette(RenderContext *context)
+    : context(context), buffer(0), texture(0), palette(), dqBuffer(0),
+      dqTexture(0), dualQuats() {}
+
+JointPalette::~JointPalette() { destroy(); }
+
+void JointPalette::create(Skeleton &skeleton) {
+  frameprofile::Scope profile("JointPalette::create");
+  int jointCount = skeleton.getJointCount();
+  palette.assign(jointCount, glm::mat4(1));
+  dualQuats.assign(jointCount, DualQuat());
+  compute(skeleton, 0, jointCount);
+
+  if (!buffer) {
+    context->glGenBuffers(1, &buffer);
+    context->glGenTextures(1, &texture);
+    context->glGenBuffers(1, &dqBuffer);
+    context->glGenTextures(1, &dqTexture);
+  }
+
+  context->glState().bindBuffer(GL_TEXTURE_BUFFER, buffer);
+  context->glBufferData(GL_TEXTURE_BUFFER, palette.size() * sizeof(glm::mat4),
+                        palette.data(), GL_DYNAMIC_DRAW);
+  context->glState().bindBuffer(GL_TEXTURE_BUFFER, dqBuffer);
+  context->glBufferData(GL_TEXTURE_BUFFER, dualQuats.size() * sizeof(DualQuat),
+                        dualQuats.data(), GL_DYNAMIC_DRAW);
+
+  // the textures only need attaching once, but reallocating the buffers'
+  // storage requires attaching them again
+  context->glState().bindTexture(0, GL_TEXTURE_BUFFER, texture);
+  context->glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffer);
+  context->glState().bindTexture(0, GL_TEXTURE_BUFFER, dqTexture);
+  context->glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, dqBuffer);
+}
+
+void JointPalette::update(Skeleton &skeleton, int first, int end) {
+  frameprofile::Scope profile("JointPalette::update");
+  if (palette.size() != (size_t)skeleton.getJointCount() || first >= end) {
+    return;
+  }
+
+  compute(skeleton, first, end);
+  upload(first, end - first);
+}
+
+void JointPalette::destroy() {
+  if (buffer) {
+    context->glState().deleteTexture(texture);
+    context->glState().deleteBuffer(buffer);
+    context->glState().deleteTexture(dqTexture);
+    context->glState().deleteBuffer(dqBuffer);
+  }
+  buffer = texture = dqBuffer = dqTexture = 0;
+  palette.clear();
+  dualQuats.clear();
+}
+
+void JointPalette::bind(GLuint matrixUnit, GLuint dualQuatUnit) {
+  context->glState().bindTexture(matrixUnit, GL_TEXTURE_BUFFER, texture);
+  context->glState().bindTexture(dualQuatUnit, GL_TEXTURE_BUFFER, dqTexture);
+}
+
+int JointPalette::getJointCount() const { return palette.size(); }
+
+const glm::mat4 &JointPalette::getMatrix(int joint) const {
+  return palette[joint];
+}
+
+const std::vector<glm::mat4> &JointPalette::getMatrices() const {
+  return palette;
+}
+
+const std::vector<DualQuat> &JointPalette::getDualQuats() const {
+  return dualQuats;
+}
+
+void JointPalette::compute(Skeleton &skeleton, int first, int end) {
+  const std::vector<glm::mat4> &worlds = skeleton.getWorldTransforms();
+  for (int i = first; i < end; ++i) {
+    palette[i] = worlds[i] * skeleton.getBindMatrix(i);
+    dualQuats[i] = DualQuat(palette[i]);
+  }
+}
+
+void JointPalette::upload(int first, int count) {
+  context->glState().bindBuffer(GL_TEXTURE_BUFFER, buffer);
+  context->glBufferSubData(GL_TEXTURE_BUFFER, first * sizeof(glm::mat4),
+                           count * sizeof(glm::mat4), &palette[first]);
+  context->glState().bindBuffer(GL_TEXTURE_BUFFER, dqBuffer);
+  context->glBufferSubData(GL_TEXTURE_BUFFER, first * sizeof(DualQuat),
+                           count * sizeof(DualQuat), &dualQuats[first]);
+}
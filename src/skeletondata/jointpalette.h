@@ -0,0 +1,55 @@
+#pragma once
+
+#include "rendercontext.h"
+#include "skeleton.h"
+#include "skinning.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+/**
+ * The skinning matrices of a skeleton, stored in a texture buffer.
+ *
+ * Entry i holds the world transform of joint i times its bind matrix, so the
+ * skeleton shader only has to blend the matrices of a vertex's influences.
+ * The buffer is sized to the skeleton's real joint count, and since a joint's
+ * subtree covers a contiguous range of ids, moving one joint recomputes and
+ * uploads only the range the Skeleton reports as changed.
+ *
+ * The same transforms are kept as dual quaternions in a second texture
+ * buffer for dual quaternion skinning.
+ */
+class JointPalette {
+public:
+  JointPalette(RenderContext *context);
+  ~JointPalette();
+
+  // (Re)allocates the buffer for skeleton and fills every entry
+  void create(Skeleton &skeleton);
+  // Recomputes and uploads just the entries of joints [first, end), the range
+  // Skeleton::takeChangedRange() reported
+  void update(Skeleton &skeleton, int first, int end);
+  void destroy();
+
+  // Binds the matrix and dual quaternion textures to the given texture units
+  void bind(GLuint matrixUnit, GLuint dualQuatUnit);
+
+  int getJointCount() const;
+  const glm::mat4 &getMatrix(int joint) const;
+  const std::vector<glm::mat4> &getMatrices() const; // Indexed by joint id
+  const std::vector<DualQuat> &getDualQuats() const;  // Indexed by joint id
+
+private:
+  RenderContext *context;
+  GLuint buffer;  // GL_TEXTURE_BUFFER storage, four RGBA32F texels per joint
+  GLuint texture; // Buffer texture sampled by the skeleton shader
+  std::vector<glm::mat4> palette; // CPU copy, indexed by joint id
+  GLuint dqBuffer;  // The same entries as dual quaternions, two texels each
+  GLuint dqTexture;
+  std::vector<DualQuat> dualQuats;
+
+  // Fills the entries of joints [first, end)
+  void compute(Skeleton &skeleton, int first, int end);
+  void upload(int first, int count);
+};
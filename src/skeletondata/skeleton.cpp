@@ -0,0 +1,224 @@
+#include "skeleton.h"
+
+#include <glm/gtx/euler_angles.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+JointLimit::JointLimit()
+    : rest(1, 0, 0, 0), min(-INFINITY), max(INFINITY) {}
+
+bool JointLimit::isLimited() const {
+  return min.x > -INFINITY || min.y > -INFINITY || min.z > -INFINITY ||
+         max.x < INFINITY || max.y < INFINITY || max.z < INFINITY;
+}
+
+glm::quat JointLimit::clamp(glm::quat rotation) const {
+  glm::vec3 angles;
+  glm::extractEulerAngleXYZ(glm::mat4_cast(glm::inverse(rest) * rotation),
+                            angles.x, angles.y, angles.z);
+  glm::vec3 clamped = glm::clamp(angles, min, max);
+  if (clamped == angles) {
+    return rotation;
+  }
+  return rest * glm::quat_cast(
+                    glm::eulerAngleXYZ(clamped.x, clamped.y, clamped.z));
+}
+
+Skeleton::Skeleton()
+    : parents(), subtreeEnds(), translations(), rotations(), scales(),
+      limits(), worlds(), binds(), dirty(), subtreesValid(true), dirtyBegin(0),
+      dirtyEnd(0), changedBegin(0), changedEnd(0) {}
+
+int Skeleton::addJoint(int parent, glm::vec3 translation, glm::quat rotation,
+                       glm::vec3 scale) {
+  int id = parents.size();
+  parents.push_back(parent);
+  subtreeEnds.push_back(id + 1);
+  translations.push_back(translation);
+  rotations.push_back(glm::normalize(rotation));
+  scales.push_back(scale);
+  limits.push_back(JointLimit());
+  worlds.push_back(glm::mat4(1));
+  binds.push_back(glm::mat4(1));
+  dirty.push_back(1);
+
+  // the ancestors' subtrees grow too, which is patched up lazily so that
+  // building a deep skeleton stays linear
+  subtreesValid = false;
+  if (dirtyBegin >= dirtyEnd) {
+    dirtyBegin = id;
+  }
+  dirtyEnd = id + 1;
+  return id;
+}
+
+void Skeleton::reserve(int jointCount) {
+  parents.reserve(jointCount);
+  subtreeEnds.reserve(jointCount);
+  translations.reserve(jointCount);
+  rotations.reserve(jointCount);
+  scales.reserve(jointCount);
+  limits.reserve(jointCount);
+  worlds.reserve(jointCount);
+  binds.reserve(jointCount);
+  dirty.reserve(jointCount);
+}
+
+int Skeleton::getJointCount() const { return parents.size(); }
+
+int Skeleton::getParent(int joint) const { return parents[joint]; }
+
+int Skeleton::getSubtreeEnd(int joint) const {
+  if (!subtreesValid) {
+    updateSubtrees();
+  }
+  return subtreeEnds[joint];
+}
+
+const glm::vec3 &Skeleton::getTranslation(int joint) const {
+  return translations[joint];
+}
+
+const glm::quat &Skeleton::getRotation(int joint) const {
+  return rotations[joint];
+}
+
+const glm::vec3 &Skeleton::getScale(int joint) const { return scales[joint]; }
+
+glm::mat4 Skeleton::getLocalTransform(int joint) const {
+  return compose(translations[joint], rotations[joint], scales[joint]);
+}
+
+glm::mat4 Skeleton::compose(glm::vec3 translation, glm::quat rotation,
+                            glm::vec3 scale) {
+  glm::mat4 local = glm::mat4_cast(rotation);
+  local[0] *= scale.x;
+  local[1] *= scale.y;
+  local[2] *= scale.z;
+  local[3] = glm::vec4(translation, 1);
+  return local;
+}
+
+void Skeleton::setTranslation(int joint, glm::vec3 translation) {
+  translations[joint] = translation;
+  markDirty(joint);
+}
+
+void Skeleton::setRotation(int joint, glm::quat rotation) {
+  rotations[joint] = glm::normalize(rotation);
+  markDirty(joint);
+}
+
+void Skeleton::setScale(int joint, glm::vec3 scale) {
+  scales[joint] = scale;
+  markDirty(joint);
+}
+
+void Skeleton::rotateLocal(int joint, glm::quat delta) {
+  setRotation(joint, rotations[joint] * delta);
+}
+
+void Skeleton::setLimit(int joint, glm::vec3 min, glm::vec3 max) {
+  limits[joint].rest = rotations[joint];
+  limits[joint].min = min;
+  limits[joint].max = max;
+}
+
+const JointLimit &Skeleton::getLimit(int joint) const {
+  return limits[joint];
+}
+
+void Skeleton::evaluate() {
+  if (dirtyBegin >= dirtyEnd) {
+    return;
+  }
+
+  // parents come first, so a joint whose parent was recomputed in this pass
+  // is marked before it is reached
+  for (int i = dirtyBegin; i < dirtyEnd; ++i) {
+    int parent = parents[i];
+    if (parent >= 0 && dirty[parent]) {
+      dirty[i] = 1;
+    }
+    if (dirty[i]) {
+      worlds[i] = parent >= 0 ? worlds[parent] * getLocalTransform(i)
+                              : getLocalTransform(i);
+    }
+  }
+  std::fill(dirty.begin() + dirtyBegin, dirty.begin() + dirtyEnd, 0);
+
+  if (changedBegin >= changedEnd) {
+    changedBegin = dirtyBegin;
+    changedEnd = dirtyEnd;
+  } else {
+    changedBegin = std::min(changedBegin, dirtyBegin);
+    changedEnd = std::max(changedEnd, dirtyEnd);
+  }
+  dirtyBegin = dirtyEnd = 0;
+}
+
+const glm::mat4 &Skeleton::getWorldTransform(int joint) {
+  evaluate();
+  return worlds[joint];
+}
+
+const std::vector<glm::mat4> &Skeleton::getWorldTransforms() {
+  evaluate();
+  return worlds;
+}
+
+glm::vec3 Skeleton::getWorldPosition(int joint) {
+  return glm::vec3(getWorldTransform(joint)[3]);
+}
+
+bool Skeleton::takeChangedRange(int *first, int *end) {
+  evaluate();
+  if (changedBegin >= changedEnd) {
+    return false;
+  }
+
+  *first = changedBegin;
+  *end = changedEnd;
+  changedBegin = changedEnd = 0;
+  return true;
+}
+
+void Skeleton::generateBindMatrices() {
+  evaluate();
+  for (size_t i = 0; i < worlds.size(); ++i) {
+    binds[i] = glm::inverse(worlds[i]);
+  }
+}
+
+const glm::mat4 &Skeleton::getBindMatrix(int joint) const {
+  return binds[joint];
+}
+
+void Skeleton::markDirty(int joint) {
+  dirty[joint] = 1;
+
+  int end = getSubtreeEnd(joint);
+  if (dirtyBegin >= dirtyEnd) {
+    dirtyBegin = joint;
+    dirtyEnd = end;
+  } else {
+    dirtyBegin = std::min(dirtyBegin, joint);
+    dirtyEnd = std::max(dirtyEnd, end);
+  }
+}
+
+void Skeleton::updateSubtrees() const {
+  // children come after their parents, so one backward pass carries each
+  // subtree's end up to its ancestors
+  for (size_t i = 0; i < subtreeEnds.size(); ++i) {
+    subtreeEnds[i] = i + 1;
+  }
+  for (int i = (int)parents.size() - 1; i > 0; --i) {
+    int parent = parents[i];
+    if (parent >= 0) {
+      subtreeEnds[parent] = std::max(subtreeEnds[parent], subtreeEnds[i]);
+    }
+  }
+  subtreesValid = true;
+}
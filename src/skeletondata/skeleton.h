@@ -0,0 +1,106 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// Bounds on a joint's rotation, as ranges of the XYZ Euler angles (radians)
+// of its rotation relative to a rest rotation
+struct JointLimit {
+  glm::quat rest;
+  glm::vec3 min, max;
+
+  JointLimit(); // Unlimited
+  bool isLimited() const;
+  glm::quat clamp(glm::quat rotation) const; // Nearest rotation within range
+};
+
+/**
+ * The runtime state of a skeleton, flattened into parallel arrays indexed by
+ * joint id.
+ *
+ * Joints are stored parent before child, in depth-first order, so every
+ * subtree covers a contiguous range of ids and a single forward pass over the
+ * arrays visits each parent before its children. Each joint has a local
+ * translation, rotation (a unit quaternion, renormalized after every edit so
+ * it cannot drift) and scale. World transforms are cached and only the
+ * subtrees of joints marked dirty are recomputed, in one linear pass.
+ *
+ * Joint is a view over this: the tree, names and UI items live there, while
+ * transforms are read from and written to the Skeleton.
+ */
+class Skeleton {
+public:
+  Skeleton();
+
+  // Appends a joint, which must come after its parent and after every joint
+  // of the parent's earlier subtrees. Pass -1 as the parent of the root.
+  // Returns the new joint's id.
+  int addJoint(int parent, glm::vec3 translation, glm::quat rotation,
+               glm::vec3 scale = glm::vec3(1));
+  void reserve(int jointCount);
+
+  int getJointCount() const;
+  int getParent(int joint) const; // -1 for the root
+  int getSubtreeEnd(int joint) const; // One past the last id in the subtree
+
+  const glm::vec3 &getTranslation(int joint) const;
+  const glm::quat &getRotation(int joint) const;
+  const glm::vec3 &getScale(int joint) const;
+  glm::mat4 getLocalTransform(int joint) const; // Translate * rotate * scale
+  static glm::mat4 compose(glm::vec3 translation, glm::quat rotation,
+                           glm::vec3 scale);
+
+  void setTranslation(int joint, glm::vec3 translation);
+  void setRotation(int joint, glm::quat rotation);
+  void setScale(int joint, glm::vec3 scale);
+  // Applies a rotation about the joint's own axes
+  void rotateLocal(int joint, glm::quat delta);
+
+  // Limits the rotations IK may give a joint, relative to its current one.
+  // Other edits are not limited.
+  void setLimit(int joint, glm::vec3 min, glm::vec3 max);
+  const JointLimit &getLimit(int joint) const;
+
+  /**
+   * Recomputes the world transforms of every dirty joint and its descendants
+   * in one pass. Called automatically by the world transform getters, so it
+   * only needs calling directly to control when the work happens.
+   */
+  void evaluate();
+  const glm::mat4 &getWorldTransform(int joint);
+  const std::vector<glm::mat4> &getWorldTransforms(); // Indexed by joint id
+  glm::vec3 getWorldPosition(int joint);
+
+  /**
+   * Reports the range of ids whose world transform changed since the last
+   * call, then resets it. Returns false if none did. The caller hands the
+   * range to every consumer that mirrors world transforms (JointPalette,
+   * JointGizmo), so each updates only that range.
+   */
+  bool takeChangedRange(int *first, int *end);
+
+  // Stores the inverse of every joint's current world transform
+  void generateBindMatrices();
+  const glm::mat4 &getBindMatrix(int joint) const;
+
+private:
+  std::vector<int> parents;
+  mutable std::vector<int> subtreeEnds;
+  std::vector<glm::vec3> translations;
+  std::vector<glm::quat> rotations;
+  std::vector<glm::vec3> scales;
+  std::vector<JointLimit> limits;
+  std::vector<glm::mat4> worlds; // Cached world transforms
+  std::vector<glm::mat4> binds;  // Inverse world transforms at bind time
+  std::vector<uint8_t> dirty;    // Local transform changed since evaluate()
+
+  mutable bool subtreesValid; // Whether subtreeEnds matches the hierarchy
+  int dirtyBegin, dirtyEnd;     // Range of ids evaluate() has to visit
+  int changedBegin, changedEnd; // Range reported by takeChangedRange()
+
+  void markDirty(int joint);
+  void updateSubtrees() const;
+};
@@ -0,0 +1,110 @@
+#include "skeletonjson.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <glm/gtc/quaternion.hpp>
+
+#include <cmath>
+#include <utility>
+
+namespace {
+// Reads an array of up to count numbers into out, leaving the rest as they
+// are. False if value is not an array of numbers.
+bool readNumbers(const QJsonValue &value, float *out, int count) {
+  if (!value.isArray()) {
+    return false;
+  }
+  QJsonArray array = value.toArray();
+  for (int i = 0; i < array.size(); ++i) {
+    if (!array[i].isDouble()) {
+      return false;
+    }
+    if (i < count) {
+      out[i] = float(array[i].toDouble());
+    }
+  }
+  return true;
+}
+
+Result failure(const std::string &error) {
+  Result result;
+  result.error = error;
+  return result;
+}
+
+// Why a joint could not be read, naming it if it has a name already
+std::string jointError(const std::string &name, const char *message) {
+  return name.empty() ? message : message + (" in joint " + name);
+}
+} // namespace
+
+namespace skeletonjson {
+Result parse(const char *json, size_t size) {
+  // rejects trailing content, invalid literals and malformed numbers, and
+  // reads numbers the same in every locale
+  QJsonParseError parseError;
+  QJsonDocument document = QJsonDocument::fromJson(
+      QByteArray::fromRawData(json, size), &parseError);
+  if (document.isNull()) {
+    return failure(parseError.errorString().toStdString() + " at offset " +
+                   std::to_string(parseError.offset));
+  }
+  QJsonValue root = document.object().value("root");
+  if (!root.isObject()) {
+    return failure("No root joint");
+  }
+
+  Result result;
+  // visiting joints from a stack, children pushed last first, numbers them
+  // in the order their objects open
+  auto skeleton = mkU<Skeleton>();
+  std::vector<std::pair<QJsonObject, int>> pending = {{root.toObject(), -1}};
+  while (!pending.empty()) {
+    auto [object, parent] = std::move(pending.back());
+    pending.pop_back();
+
+    std::string name = object.value("name").toString().toStdString();
+    float pos[3] = {0, 0, 0}, rot[4] = {0, 0, 0, 0};
+    QJsonValue posValue = object.value("pos"), rotValue = object.value("rot");
+    if ((!posValue.isUndefined() && !readNumbers(posValue, pos, 3)) ||
+        (!rotValue.isUndefined() && !readNumbers(rotValue, rot, 4))) {
+      return failure(jointError(name, "Expected an array of numbers"));
+    }
+
+    glm::vec3 axis(rot[1], rot[2], rot[3]);
+    glm::quat rotation = glm::length(axis) > 0
+                             ? glm::angleAxis(rot[0], glm::normalize(axis))
+                             : glm::quat(1, 0, 0, 0);
+    int id = skeleton->addJoint(parent, glm::vec3(pos[0], pos[1], pos[2]),
+                                rotation);
+    result.names.push_back(name);
+
+    QJsonValue limits = object.value("limits");
+    if (limits.isObject()) {
+      // an axis missing from either bound is left free
+      float lo[3] = {-INFINITY, -INFINITY, -INFINITY};
+      float hi[3] = {INFINITY, INFINITY, INFINITY};
+      QJsonValue min = limits["min"], max = limits["max"];
+      if ((!min.isUndefined() && !readNumbers(min, lo, 3)) ||
+          (!max.isUndefined() && !readNumbers(max, hi, 3))) {
+        return failure(jointError(name, "Expected an array of numbers"));
+      }
+      skeleton->setLimit(id, glm::vec3(lo[0], lo[1], lo[2]),
+                         glm::vec3(hi[0], hi[1], hi[2]));
+    }
+
+    QJsonArray children = object.value("children").toArray();
+    for (int i = children.size() - 1; i >= 0; --i) {
+      if (!children[i].isObject()) {
+        return failure(jointError(name, "Expected a joint object"));
+      }
+      pending.push_back({children[i].toObject(), id});
+    }
+  }
+
+  result.skeleton = std::move(skeleton);
+  return result;
+}
+} // namespace skeletonjson
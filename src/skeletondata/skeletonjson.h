@@ -0,0 +1,33 @@
+#pragma once
+
+#include "skeleton.h"
+#include "smartpointerhelp.h"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+ * Reads skeleton JSON files straight into a Skeleton.
+ *
+ * A file holds a "root" joint object; every joint has a "name", a "pos"
+ * [x, y, z], a "rot" [angle, axisX, axisY, axisZ] in radians and an array of
+ * "children" joints. An optional "limits" object bounds the rotations inverse
+ * kinematics may give the joint, with "min" and "max" [x, y, z] Euler angles
+ * in radians relative to "rot"; see JointLimit. Other members are skipped.
+ *
+ * The text is parsed with QJsonDocument, and joints are numbered in the order
+ * their objects open. That is depth-first order, so ids are dense from 0 in
+ * every file and each subtree covers a contiguous range, as Skeleton
+ * requires. The tree is walked with an explicit stack rather than recursion,
+ * so chains as deep as the parser accepts load too.
+ */
+namespace skeletonjson {
+struct Result {
+  uPtr<Skeleton> skeleton;        // Null if the file could not be read
+  std::vector<std::string> names; // Indexed by joint id
+  std::string error;              // Why and where reading failed, if it did
+};
+
+Result parse(const char *json, size_t size);
+} // namespace skeletonjson
@@ -0,0 +1,445 @@
+#include "skinning.h"
+
+#include "parallel.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#define SKINNING_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define SKINNING_AVX // MSVC compiles AVX intrinsics for any target
+#else
+#define SKINNING_AVX __attribute__((target("avx")))
+#endif
+#endif
+
+namespace {
+// Vertices per parallel block; large enough to amortize scheduling, small
+// enough to balance across cores
+constexpr size_t BlockSize = 16384;
+
+constexpr float WeightScale = 1.f / 65535.f;
+
+using LinearKernel = void (*)(const glm::mat4 *palette,
+                              const SkinInfluence *influences,
+                              const glm::vec3 *restPos,
+                              const glm::vec3 *restNor, size_t count,
+                              glm::vec3 *outPos, glm::vec3 *outNor);
+
+// Transforms normal n by the inverse transpose of the matrix with columns c0,
+// c1 and c2, up to a positive scale the caller normalizes away, so normals
+// stay perpendicular to the surface under non-uniform scale. The cofactor
+// matrix is the inverse transpose times the determinant.
+inline glm::vec3 transformNormal(const glm::vec3 &c0, const glm::vec3 &c1,
+                                 const glm::vec3 &c2, const glm::vec3 &n) {
+  glm::vec3 c12 = glm::cross(c1, c2);
+  glm::vec3 r = n.x * c12 + n.y * glm::cross(c2, c0) + n.z * glm::cross(c0, c1);
+  return glm::dot(c0, c12) < 0 ? -r : r;
+}
+
+#if defined(SKINNING_X86)
+
+inline void store3(glm::vec3 &out, __m128 v) {
+  alignas(16) float f[4];
+  _mm_store_ps(f, v);
+  out = glm::vec3(f[0], f[1], f[2]);
+}
+
+// Broadcasts a into the low four lanes and b into the high four
+SKINNING_AVX inline __m256 splat2(float a, float b) {
+  return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(a)),
+                              _mm_set1_ps(b), 1);
+}
+
+// Each matrix is held as two registers, columns 0|1 and columns 2|3, so
+// blending in one influence is two multiplies and two adds, and transforming
+// a point needs one add across the register halves. Compiled for AVX
+// whatever the build targets, and only called if the CPU has it.
+SKINNING_AVX void
+linearKernelAvx(const glm::mat4 *palette, const SkinInfluence *influences,
+                const glm::vec3 *restPos, const glm::vec3 *restNor,
+                size_t count, glm::vec3 *outPos, glm::vec3 *outNor) {
+  for (size_t i = 0; i < count; ++i) {
+    const SkinInfluence &inf = influences[i];
+
+    const float *m = &palette[inf.joints[0]][0][0];
+    __m256 w = _mm256_set1_ps(inf.weights[0] * WeightScale);
+    __m256 c01 = _mm256_mul_ps(w, _mm256_loadu_ps(m));
+    __m256 c23 = _mm256_mul_ps(w, _mm256_loadu_ps(m + 8));
+    for (int k = 1; k < inf.count; ++k) {
+      m = &palette[inf.joints[k]][0][0];
+      w = _mm256_set1_ps(inf.weights[k] * WeightScale);
+      c01 = _mm256_add_ps(c01, _mm256_mul_ps(w, _mm256_loadu_ps(m)));
+      c23 = _mm256_add_ps(c23, _mm256_mul_ps(w, _mm256_loadu_ps(m + 8)));
+    }
+
+    const glm::vec3 &p = restPos[i];
+    __m256 s = _mm256_add_ps(_mm256_mul_ps(c01, splat2(p.x, p.y)),
+                             _mm256_mul_ps(c23, splat2(p.z, 1.f)));
+    store3(outPos[i], _mm_add_ps(_mm256_castps256_ps128(s),
+                                 _mm256_extractf128_ps(s, 1)));
+
+    if (outNor) {
+      float f01[8], f23[8];
+      _mm256_storeu_ps(f01, c01);
+      _mm256_storeu_ps(f23, c23);
+      outNor[i] = glm::normalize(transformNormal(
+          glm::vec3(f01[0], f01[1], f01[2]), glm::vec3(f01[4], f01[5], f01[6]),
+          glm::vec3(f23[0], f23[1], f23[2]), restNor[i]));
+    }
+  }
+}
+
+// One register per matrix column; SSE2 is part of x86-64
+void linearKernelSse2(const glm::mat4 *palette,
+                      const SkinInfluence *influences,
+                      const glm::vec3 *restPos, const glm::vec3 *restNor,
+                      size_t count, glm::vec3 *outPos, glm::vec3 *outNor) {
+  for (size_t i = 0; i < count; ++i) {
+    const SkinInfluence &inf = influences[i];
+
+    const float *m = &palette[inf.joints[0]][0][0];
+    __m128 w = _mm_set1_ps(inf.weights[0] * WeightScale);
+    __m128 c0 = _mm_mul_ps(w, _mm_loadu_ps(m));
+    __m128 c1 = _mm_mul_ps(w, _mm_loadu_ps(m + 4));
+    __m128 c2 = _mm_mul_ps(w, _mm_loadu_ps(m + 8));
+    __m128 c3 = _mm_mul_ps(w, _mm_loadu_ps(m + 12));
+    for (int k = 1; k < inf.count; ++k) {
+      m = &palette[inf.joints[k]][0][0];
+      w = _mm_set1_ps(inf.weights[k] * WeightScale);
+      c0 = _mm_add_ps(c0, _mm_mul_ps(w, _mm_loadu_ps(m)));
+      c1 = _mm_add_ps(c1, _mm_mul_ps(w, _mm_loadu_ps(m + 4)));
+      c2 = _mm_add_ps(c2, _mm_mul_ps(w, _mm_loadu_ps(m + 8)));
+      c3 = _mm_add_ps(c3, _mm_mul_ps(w, _mm_loadu_ps(m + 12)));
+    }
+
+    const glm::vec3 &p = restPos[i];
+    __m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(p.x)),
+                                     _mm_mul_ps(c1, _mm_set1_ps(p.y))),
+                          _mm_add_ps(_mm_mul_ps(c2, _mm_set1_ps(p.z)), c3));
+    store3(outPos[i], r);
+
+    if (outNor) {
+      glm::vec3 col0, col1, col2;
+      store3(col0, c0);
+      store3(col1, c1);
+      store3(col2, c2);
+      outNor[i] = glm::normalize(transformNormal(col0, col1, col2, restNor[i]));
+    }
+  }
+}
+
+// Whether the CPU and the operating system both support AVX
+bool hasAvx() {
+#if defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 1);
+  bool osSaves = info[2] & (1 << 27), avx = info[2] & (1 << 28);
+  return osSaves && avx && (_xgetbv(0) & 6) == 6;
+#else
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx");
+#endif
+}
+
+#else
+
+void linearKernelScalar(const glm::mat4 *palette,
+                        const SkinInfluence *influences,
+                        const glm::vec3 *restPos, const glm::vec3 *restNor,
+                        size_t count, glm::vec3 *outPos, glm::vec3 *outNor) {
+  for (size_t i = 0; i < count; ++i) {
+    const SkinInfluence &inf = influences[i];
+    glm::mat4 m = inf.getWeight(0) * palette[inf.joints[0]];
+    for (int k = 1; k < inf.count; ++k) {
+      m = m + inf.getWeight(k) * palette[inf.joints[k]];
+    }
+
+    outPos[i] = glm::vec3(m * glm::vec4(restPos[i], 1));
+    if (outNor) {
+      outNor[i] = glm::normalize(transformNormal(
+          glm::vec3(m[0]), glm::vec3(m[1]), glm::vec3(m[2]), restNor[i]));
+    }
+  }
+}
+
+#endif
+
+// The fastest kernel this CPU runs, picked on first use, and its name
+LinearKernel linearKernel(const char **name = nullptr) {
+#if defined(SKINNING_X86)
+  static const bool avx = hasAvx();
+  if (name) {
+    *name = avx ? "AVX" : "SSE2";
+  }
+  return avx ? linearKernelAvx : linearKernelSse2;
+#else
+  if (name) {
+    *name = "scalar";
+  }
+  return linearKernelScalar;
+#endif
+}
+
+// Blends the influences' dual quaternions, flipping any that lie in the
+// opposite hemisphere of the heaviest so they take the shortest path
+void dualQuatKernel(const DualQuat *palette, const SkinInfluence *influences,
+                    const glm::vec3 *restPos, const glm::vec3 *restNor,
+                    size_t count, glm::vec3 *outPos, glm::vec3 *outNor) {
+  for (size_t i = 0; i < count; ++i) {
+    const SkinInfluence &inf = influences[i];
+    const glm::vec4 &pivot = palette[inf.joints[0]].real;
+
+    glm::vec4 real(0), dual(0);
+    for (int k = 0; k < inf.count; ++k) {
+      const DualQuat &q = palette[inf.joints[k]];
+      float w = inf.getWeight(k);
+      if (glm::dot(q.real, pivot) < 0) {
+        w = -w;
+      }
+      real += w * q.real;
+      dual += w * q.dual;
+    }
+
+    float invLength = 1.f / glm::length(real);
+    real *= invLength;
+    dual *= invLength;
+
+    glm::vec3 r(real), d(dual);
+    const glm::vec3 &p = restPos[i];
+    outPos[i] = p + 2.f * glm::cross(r, glm::cross(r, p) + real.w * p) +
+                2.f * (real.w * d - dual.w * r + glm::cross(r, d));
+
+    if (outNor) {
+      const glm::vec3 &n = restNor[i];
+      glm::vec3 t = glm::cross(r, n) + real.w * n;
+      outNor[i] = glm::normalize(n + 2.f * glm::cross(r, t));
+    }
+  }
+}
+
+// Rotation matrix of a unit quaternion stored as (x, y, z, w)
+glm::mat4 quatToMat(glm::vec4 q) {
+  float x = q.x, y = q.y, z = q.z, w = q.w;
+  glm::mat4 m(1);
+  m[0] = glm::vec4(1 - 2 * (y * y + z * z), 2 * (x * y + w * z),
+                   2 * (x * z - w * y), 0);
+  m[1] = glm::vec4(2 * (x * y - w * z), 1 - 2 * (x * x + z * z),
+                   2 * (y * z + w * x), 0);
+  m[2] = glm::vec4(2 * (x * z + w * y), 2 * (y * z - w * x),
+                   1 - 2 * (x * x + y * y), 0);
+  return m;
+}
+} // namespace
+
+SkinInfluence::SkinInfluence() : joints{}, weights{65535}, count(1) {}
+
+SkinInfluence::SkinInfluence(const int *jointIds, const float *jointWeights,
+                             int n)
+    : joints{}, weights{}, count(0) {
+  // merge repeated joints, then put the heaviest first
+  std::vector<std::pair<float, int>> sorted;
+  for (int i = 0; i < n; ++i) {
+    if (jointWeights[i] <= 0) {
+      continue;
+    }
+    auto same = std::find_if(sorted.begin(), sorted.end(),
+                             [&](auto &s) { return s.second == jointIds[i]; });
+    if (same != sorted.end()) {
+      same->first += jointWeights[i];
+    } else {
+      sorted.push_back({jointWeights[i], jointIds[i]});
+    }
+  }
+  std::sort(sorted.begin(), sorted.end(),
+            [](auto &a, auto &b) { return a.first > b.first; });
+  sorted.resize(std::min<size_t>(sorted.size(), MaxInfluences));
+
+  float total = 0;
+  for (auto &[w, joint] : sorted) {
+    total += w;
+  }
+  if (sorted.empty() || total <= 0) {
+    *this = SkinInfluence();
+    return;
+  }
+
+  // quantize, then give the rounding error to the heaviest influence so the
+  // weights sum to exactly one
+  int sum = 0;
+  for (auto &[w, joint] : sorted) {
+    uint16_t q = uint16_t(std::lround(w / total * 65535.f));
+    if (q == 0) {
+      break;
+    }
+    joints[count] = uint16_t(joint);
+    weights[count] = q;
+    sum += q;
+    ++count;
+  }
+  weights[0] = uint16_t(weights[0] + 65535 - sum);
+}
+
+float SkinInfluence::getWeight(int slot) const {
+  return weights[slot] * WeightScale;
+}
+
+DualQuat::DualQuat() : real(0, 0, 0, 1), dual(0) {}
+
+DualQuat::DualQuat(const glm::mat4 &rigid) {
+  // rotation part, with any scale normalized away
+  glm::vec3 c0 = glm::normalize(glm::vec3(rigid[0]));
+  glm::vec3 c1 = glm::normalize(glm::vec3(rigid[1]));
+  glm::vec3 c2 = glm::normalize(glm::vec3(rigid[2]));
+
+  // convert to a quaternion from the largest of w, x, y, z for stability
+  float trace = c0.x + c1.y + c2.z;
+  if (trace > 0) {
+    float s = 0.5f / std::sqrt(trace + 1.f);
+    real = glm::vec4((c1.z - c2.y) * s, (c2.x - c0.z) * s, (c0.y - c1.x) * s,
+                     0.25f / s);
+  } else if (c0.x > c1.y && c0.x > c2.z) {
+    float s = 2.f * std::sqrt(1.f + c0.x - c1.y - c2.z);
+    real = glm::vec4(0.25f * s, (c1.x + c0.y) / s, (c2.x + c0.z) / s,
+                     (c1.z - c2.y) / s);
+  } else if (c1.y > c2.z) {
+    float s = 2.f * std::sqrt(1.f + c1.y - c0.x - c2.z);
+    real = glm::vec4((c1.x + c0.y) / s, 0.25f * s, (c2.y + c1.z) / s,
+                     (c2.x - c0.z) / s);
+  } else {
+    float s = 2.f * std::sqrt(1.f + c2.z - c0.x - c1.y);
+    real = glm::vec4((c2.x + c0.z) / s, (c2.y + c1.z) / s, 0.25f * s,
+                     (c0.y - c1.x) / s);
+  }
+  real = glm::normalize(real);
+
+  // dual = 0.5 * (t, 0) * real
+  glm::vec3 t(rigid[3]), r(real);
+  dual = 0.5f * glm::vec4(real.w * t + glm::cross(t, r), -glm::dot(t, r));
+}
+
+namespace skinning {
+const char *simdPath() {
+  const char *name;
+  linearKernel(&name);
+  return name;
+}
+
+void toDualQuats(const glm::mat4 *palette, size_t jointCount, DualQuat *out) {
+  for (size_t i = 0; i < jointCount; ++i) {
+    out[i] = DualQuat(palette[i]);
+  }
+}
+
+void pose(SkinningMode mode, const glm::mat4 *palette, size_t jointCount,
+          const SkinInfluence *influences, const glm::vec3 *restPos,
+          const glm::vec3 *restNor, size_t count, glm::vec3 *outPos,
+          glm::vec3 *outNor) {
+  if (mode == SkinningMode::DUAL_QUATERNION) {
+    std::vector<DualQuat> dualQuats(jointCount);
+    toDualQuats(palette, jointCount, dualQuats.data());
+    skinDualQuat(dualQuats.data(), influences, restPos, restNor, count, outPos,
+                 outNor);
+  } else {
+    skinLinear(palette, influences, restPos, restNor, count, outPos, outNor);
+  }
+}
+
+void skinLinear(const glm::mat4 *palette, const SkinInfluence *influences,
+                const glm::vec3 *restPos, const glm::vec3 *restNor,
+                size_t count, glm::vec3 *outPos, glm::vec3 *outNor) {
+  LinearKernel kernel = linearKernel();
+  parallel::forBlocks(count, BlockSize, [&](size_t begin, size_t end) {
+    kernel(palette, influences + begin, restPos + begin,
+           restNor ? restNor + begin : nullptr, end - begin, outPos + begin,
+           outNor ? outNor + begin : nullptr);
+  });
+}
+
+void skinLinearSerial(const glm::mat4 *palette,
+                      const SkinInfluence *influences,
+                      const glm::vec3 *restPos, const glm::vec3 *restNor,
+                      size_t count, glm::vec3 *outPos, glm::vec3 *outNor) {
+  linearKernel()(palette, influences, restPos, restNor, count, outPos,
+                 outNor);
+}
+
+void skinDualQuat(const DualQuat *palette, const SkinInfluence *influences,
+                  const glm::vec3 *restPos, const glm::vec3 *restNor,
+                  size_t count, glm::vec3 *outPos, glm::vec3 *outNor) {
+  parallel::forBlocks(count, BlockSize, [&](size_t begin, size_t end) {
+    dualQuatKernel(palette, influences + begin, restPos + begin,
+                   restNor ? restNor + begin : nullptr, end - begin,
+                   outPos + begin, outNor ? outNor + begin : nullptr);
+  });
+}
+
+void skinDualQuatSerial(const DualQuat *palette,
+                        const SkinInfluence *influences,
+                        const glm::vec3 *restPos, const glm::vec3 *restNor,
+                        size_t count, glm::vec3 *outPos, glm::vec3 *outNor) {
+  dualQuatKernel(palette, influences, restPos, restNor, count, outPos, outNor);
+}
+
+std::vector<BenchmarkResult> benchmark(size_t vertexCount, int influenceCount,
+                                       int jointCount) {
+  std::mt19937 rng(277);
+  std::uniform_real_distribution<float> unit(-1.f, 1.f);
+
+  // random rigid joint transformations
+  std::vector<glm::mat4> matrices(jointCount);
+  std::vector<DualQuat> dualQuats(jointCount);
+  for (int j = 0; j < jointCount; ++j) {
+    glm::vec4 q = glm::normalize(
+        glm::vec4(unit(rng), unit(rng), unit(rng), unit(rng) + 2.f));
+    matrices[j] = quatToMat(q);
+    matrices[j][3] = glm::vec4(unit(rng), unit(rng), unit(rng), 1);
+  }
+  toDualQuats(matrices.data(), jointCount, dualQuats.data());
+
+  std::vector<SkinInfluence> influences(vertexCount);
+  std::vector<glm::vec3> restPos(vertexCount), restNor(vertexCount);
+  std::vector<glm::vec3> outPos(vertexCount), outNor(vertexCount);
+  std::uniform_int_distribution<int> joint(0, jointCount - 1);
+  for (size_t i = 0; i < vertexCount; ++i) {
+    int ids[SkinInfluence::MaxInfluences];
+    float weights[SkinInfluence::MaxInfluences];
+    for (int k = 0; k < influenceCount; ++k) {
+      ids[k] = joint(rng);
+      weights[k] = unit(rng) + 1.1f;
+    }
+    influences[i] = SkinInfluence(ids, weights, influenceCount);
+    restPos[i] = glm::vec3(unit(rng), unit(rng), unit(rng));
+    restNor[i] = glm::normalize(glm::vec3(unit(rng), unit(rng), 1.f));
+  }
+
+  std::vector<BenchmarkResult> results;
+  auto time = [&](SkinningMode mode, bool parallel, auto fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn(influences.data(), restPos.data(), restNor.data(), vertexCount,
+       outPos.data(), outNor.data());
+    std::chrono::duration<double> seconds =
+        std::chrono::steady_clock::now() - start;
+    results.push_back({mode, parallel, vertexCount / seconds.count()});
+  };
+
+  const glm::mat4 *m = matrices.data();
+  const DualQuat *dq = dualQuats.data();
+  time(SkinningMode::LINEAR, false, [&](auto... args) {
+    skinLinearSerial(m, args...);
+  });
+  time(SkinningMode::LINEAR, true,
+       [&](auto... args) { skinLinear(m, args...); });
+  time(SkinningMode::DUAL_QUATERNION, false, [&](auto... args) {
+    skinDualQuatSerial(dq, args...);
+  });
+  time(SkinningMode::DUAL_QUATERNION, true,
+       [&](auto... args) { skinDualQuat(dq, args...); });
+  return results;
+}
+} // namespace skinning
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * The joints influencing one vertex, as assigned by Mesh::bindSkeleton.
+ * Joint indices refer to entries of a JointPalette.
+ *
+ * Up to MaxInfluences joints are kept, sorted by decreasing weight. Weights
+ * are quantized to 16 bits and normalized so that they sum to exactly 65535,
+ * which is also the form they are uploaded to the GPU in. Slots past count
+ * have zero weight.
+ */
+struct SkinInfluence {
+  static constexpr int MaxInfluences = 8;
+
+  uint16_t joints[MaxInfluences];
+  uint16_t weights[MaxInfluences];
+  uint8_t count; // Number of slots in use
+
+  SkinInfluence(); // Fully bound to joint 0
+  // Keeps the heaviest MaxInfluences of the n given joints and normalizes
+  // their weights. Joints with no weight are dropped.
+  SkinInfluence(const int *jointIds, const float *jointWeights, int n);
+
+  float getWeight(int slot) const; // Weight of a slot in [0, 1]
+};
+
+// A rigid transformation as a unit dual quaternion. Quaternions are stored
+// as (x, y, z, w) with w the scalar part, matching the GPU layout.
+struct DualQuat {
+  glm::vec4 real; // Rotation
+  glm::vec4 dual; // Translation, as half of (0, t) * real
+
+  DualQuat();
+  explicit DualQuat(const glm::mat4 &rigid); // Ignores any scale or shear
+};
+
+// How the matrices of a vertex's influences are blended
+enum class SkinningMode {
+  LINEAR = 0,          // Weighted sum of matrices; collapses under twists
+  DUAL_QUATERNION = 1, // Blends rigid transforms; preserves volume
+};
+
+/**
+ * Skinning on the CPU, matching skeleton.vert.glsl.
+ *
+ * Used wherever a posed mesh is needed without the GPU: USD export of a bound
+ * mesh and the software skinning fallback in MyGL. Vertices are split into
+ * blocks that are skinned in parallel. Linear blending runs the widest SIMD
+ * kernel the CPU supports: AVX if it has it, else SSE2 on x86-64, and plain
+ * glm math elsewhere.
+ */
+namespace skinning {
+// Name of the SIMD extension the linear blend kernel uses on this CPU
+const char *simdPath();
+
+// Converts skinning matrices to dual quaternions
+void toDualQuats(const glm::mat4 *palette, size_t jointCount, DualQuat *out);
+
+// Poses count vertices: each output is the rest value transformed by the
+// blend of its influences' palette transformations. restNor and outNor may
+// be null to skip normals; posed normals are renormalized.
+void pose(SkinningMode mode, const glm::mat4 *palette, size_t jointCount,
+          const SkinInfluence *influences, const glm::vec3 *restPos,
+          const glm::vec3 *restNor, size_t count, glm::vec3 *outPos,
+          glm::vec3 *outNor);
+
+// The two modes with the palette already in the form they use. The serial
+// versions run entirely on the calling thread.
+void skinLinear(const glm::mat4 *palette, const SkinInfluence *influences,
+                const glm::vec3 *restPos, const glm::vec3 *restNor,
+                size_t count, glm::vec3 *outPos, glm::vec3 *outNor);
+void skinLinearSerial(const glm::mat4 *palette,
+                      const SkinInfluence *influences,
+                      const glm::vec3 *restPos, const glm::vec3 *restNor,
+                      size_t count, glm::vec3 *outPos, glm::vec3 *outNor);
+void skinDualQuat(const DualQuat *palette, const SkinInfluence *influences,
+                  const glm::vec3 *restPos, const glm::vec3 *restNor,
+                  size_t count, glm::vec3 *outPos, glm::vec3 *outNor);
+void skinDualQuatSerial(const DualQuat *palette,
+                        const SkinInfluence *influences,
+                        const glm::vec3 *restPos, const glm::vec3 *restNor,
+                        size_t count, glm::vec3 *outPos, glm::vec3 *outNor);
+
+struct BenchmarkResult {
+  SkinningMode mode;
+  bool parallel;            // Whether all cores were used
+  double verticesPerSecond; // Positions and normals
+};
+
+// Times both modes, serial and parallel, on random vertices with the given
+// number of influences each
+std::vector<BenchmarkResult> benchmark(size_t vertexCount, int influenceCount,
+                                       int jointCount);
+} // namespace skinning
@@ -0,0 +1,47 @@
+#include "startupprofile.h"
+
+#include <QElapsedTimer>
+
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+QElapsedTimer sinceStart;
+bool enabled = false;
+// Each step and the nanoseconds from start() to its end
+std::vector<std::pair<std::string, qint64>> steps;
+} // namespace
+
+namespace startupprofile {
+void start(bool enable) {
+  enabled = enable;
+  sinceStart.start();
+}
+
+bool isEnabled() { return enabled; }
+
+void mark(const char *step) {
+  if (enabled) {
+    steps.push_back({step, sinceStart.nsecsElapsed()});
+  }
+}
+
+void report() {
+  if (!enabled) {
+    return;
+  }
+  enabled = false;
+
+  printf("Startup profile:\n");
+  qint64 previous = 0;
+  for (auto &step : steps) {
+    printf("  %9.2f ms  %s\n", (step.second - previous) / 1e6,
+           step.first.c_str());
+    previous = step.second;
+  }
+  printf("  %9.2f ms  total\n", previous / 1e6);
+  fflush(stdout);
+}
+} // namespace startupprofile
@@ -0,0 +1,18 @@
+#pragma once
+
+/**
+ * A breakdown of where startup time goes, printed with --profile-startup.
+ *
+ * Steps are marked as they finish, from main() up to the first frame, and
+ * each is reported with the time since the previous one. While profiling is
+ * off, marking a step does nothing.
+ */
+namespace startupprofile {
+void start(bool enabled); // Called first thing in main()
+bool isEnabled(); // Until report()
+
+// Records that a step of startup has just finished
+void mark(const char *step);
+// Prints the steps recorded so far and stops profiling
+void report();
+} // namespace startupprofile
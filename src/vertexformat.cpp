@@ -0,0 +1,84 @@
+#include "vertexformat.h"
+
+bool VertexAttrib::operator==(const VertexAttrib &other) const {
+  return location == other.location && size == other.size &&
+         type == other.type && normalized == other.normalized &&
+         integer == other.integer && offset == other.offset;
+}
+
+VertexLayout::VertexLayout() : stride(0), attribs() {}
+
+bool VertexLayout::operator==(const VertexLayout &other) const {
+  return stride == other.stride && attribs == other.attribs;
+}
+
+bool VertexLayout::operator!=(const VertexLayout &other) const {
+  return !(*this == other);
+}
+
+VertexLayout ColorVertex::layout() {
+  VertexLayout l;
+  l.stride = sizeof(ColorVertex);
+  l.attribs = {
+      {ATTR_POS, 3, GL_FLOAT, GL_FALSE, false, offsetof(ColorVertex, pos)},
+      {ATTR_COL, 4, GL_UNSIGNED_BYTE, GL_TRUE, false,
+       offsetof(ColorVertex, col)},
+  };
+  return l;
+}
+
+VertexLayout LitVertex::layout() {
+  VertexLayout l;
+  l.stride = sizeof(LitVertex);
+  l.attribs = {
+      {ATTR_POS, 3, GL_FLOAT, GL_FALSE, false, offsetof(LitVertex, pos)},
+      {ATTR_NOR, 4, GL_BYTE, GL_TRUE, false, offsetof(LitVertex, nor)},
+      {ATTR_COL, 4, GL_UNSIGNED_BYTE, GL_TRUE, false, offsetof(LitVertex, col)},
+  };
+  return l;
+}
+
+VertexLayout SkinnedVertex::layout() {
+  VertexLayout l;
+  l.stride = sizeof(SkinnedVertex);
+  l.attribs = {
+      {ATTR_POS, 3, GL_FLOAT, GL_FALSE, false, offsetof(SkinnedVertex, pos)},
+      {ATTR_NOR, 4, GL_BYTE, GL_TRUE, false, offsetof(SkinnedVertex, nor)},
+      {ATTR_COL, 4, GL_UNSIGNED_BYTE, GL_TRUE, false,
+       offsetof(SkinnedVertex, col)},
+      {ATTR_JOINT_IDX0, 4, GL_UNSIGNED_SHORT, GL_FALSE, true,
+       offsetof(SkinnedVertex, jointIdx)},
+      {ATTR_JOINT_WGT0, 4, GL_UNSIGNED_SHORT, GL_TRUE, false,
+       offsetof(SkinnedVertex, jointWgt)},
+  };
+  return l;
+}
+
+VertexLayout SkinnedVertex8::layout() {
+  VertexLayout l;
+  l.stride = sizeof(SkinnedVertex8);
+  l.attribs = {
+      {ATTR_POS, 3, GL_FLOAT, GL_FALSE, false, offsetof(SkinnedVertex8, pos)},
+      {ATTR_NOR, 4, GL_BYTE, GL_TRUE, false, offsetof(SkinnedVertex8, nor)},
+      {ATTR_COL, 4, GL_UNSIGNED_BYTE, GL_TRUE, false,
+       offsetof(SkinnedVertex8, col)},
+      {ATTR_JOINT_IDX0, 4, GL_UNSIGNED_SHORT, GL_FALSE, true,
+       offsetof(SkinnedVertex8, jointIdx)},
+      {ATTR_JOINT_WGT0, 4, GL_UNSIGNED_SHORT, GL_TRUE, false,
+       offsetof(SkinnedVertex8, jointWgt)},
+      {ATTR_JOINT_IDX1, 4, GL_UNSIGNED_SHORT, GL_FALSE, true,
+       offsetof(SkinnedVertex8, jointIdx) + sizeof(glm::u16vec4)},
+      {ATTR_JOINT_WGT1, 4, GL_UNSIGNED_SHORT, GL_TRUE, false,
+       offsetof(SkinnedVertex8, jointWgt) + sizeof(glm::u16vec4)},
+  };
+  return l;
+}
+
+glm::i8vec4 packNormal(glm::vec3 nor) {
+  return glm::i8vec4(glm::round(glm::clamp(glm::vec4(nor, 0), -1.f, 1.f) *
+                                127.f));
+}
+
+glm::u8vec4 packColor(glm::vec4 col) {
+  return glm::u8vec4(glm::round(glm::clamp(col, 0.f, 1.f) * 255.f));
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "rendercontext.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_precision.hpp>
+
+#include <cstddef>
+#include <vector>
+
+// Attribute locations shared by every shader. ShaderProgram binds its inputs
+// to these before linking, so a Drawable's VAO works with any program.
+enum VertexAttribLocation : GLuint {
+  ATTR_POS = 0,        // vs_Pos
+  ATTR_NOR = 1,        // vs_Nor
+  ATTR_COL = 2,        // vs_Col
+  ATTR_JOINT_IDX0 = 3, // vs_JointIdx0, joints of the heaviest four influences
+  ATTR_JOINT_WGT0 = 4, // vs_JointWgt0
+  ATTR_JOINT_IDX1 = 5, // vs_JointIdx1, joints of influences five to eight
+  ATTR_JOINT_WGT1 = 6, // vs_JointWgt1
+};
+
+// One attribute inside an interleaved vertex
+struct VertexAttrib {
+  GLuint location;      // One of VertexAttribLocation
+  GLint size;           // Number of components
+  GLenum type;          // Component type as stored in the buffer
+  GLboolean normalized; // Map integer components to [0, 1] or [-1, 1]
+  bool integer;         // Read as an ivec via glVertexAttribIPointer
+  GLuint offset;        // Byte offset from the start of the vertex
+
+  bool operator==(const VertexAttrib &other) const;
+};
+
+// Describes how the attributes of one interleaved vertex are laid out
+struct VertexLayout {
+  GLsizei stride; // Size of one vertex in bytes
+  std::vector<VertexAttrib> attribs;
+
+  VertexLayout();
+  bool operator==(const VertexLayout &other) const;
+  bool operator!=(const VertexLayout &other) const;
+};
+
+// Position and color only, for wireframes, points and gizmos (16 bytes)
+struct ColorVertex {
+  glm::vec3 pos;
+  glm::u8vec4 col;
+
+  static VertexLayout layout();
+};
+
+// Lit geometry (20 bytes instead of three vec4s)
+struct LitVertex {
+  glm::vec3 pos;
+  glm::i8vec4 nor;
+  glm::u8vec4 col;
+
+  static VertexLayout layout();
+};
+
+// Lit geometry bound to a skeleton with up to four influences per vertex,
+// heaviest first (36 bytes)
+struct SkinnedVertex {
+  glm::vec3 pos;
+  glm::i8vec4 nor;
+  glm::u8vec4 col;
+  glm::u16vec4 jointIdx;
+  glm::u16vec4 jointWgt; // Normalized 16-bit weights
+
+  static VertexLayout layout();
+};
+
+// Lit geometry bound to a skeleton with up to eight influences (52 bytes)
+struct SkinnedVertex8 {
+  glm::vec3 pos;
+  glm::i8vec4 nor;
+  glm::u8vec4 col;
+  glm::u16vec4 jointIdx[2];
+  glm::u16vec4 jointWgt[2];
+
+  static VertexLayout layout();
+};
+
+// Conversions from float attributes to their packed storage types. GL 3.2 core
+// has no 10_10_10_2 vertex type, so normals use four normalized bytes, which
+// is the same size.
+glm::i8vec4 packNormal(glm::vec3 nor);
+glm::u8vec4 packColor(glm::vec4 col);